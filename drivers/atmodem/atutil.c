@@ -739,6 +739,37 @@ char *at_util_get_cgdcont_command(guint cid, enum ofono_gprs_proto proto,
 									apn);
 }
 
+/*
+ * Commands are grouped by name: the extended command name up to its
+ * arguments, or the letter of a basic command, so dialed numbers and
+ * other arguments never end up in the statistics.
+ */
+static void at_util_latency(const char *cmd, gboolean ok, guint usec,
+							gpointer user_data)
+{
+	struct ofono_modem *modem = user_data;
+	char name[16];
+	size_t len;
+
+	if (g_ascii_strncasecmp(cmd, "AT", 2) == 0)
+		cmd += 2;
+
+	if (*cmd != '\0' && strchr("+*$%^_#", *cmd) != NULL)
+		len = strcspn(cmd, "=?;\r");
+	else if (*cmd == '&')
+		len = cmd[1] != '\0' ? 2 : 1;
+	else
+		len = *cmd != '\0' && *cmd != '\r' ? 1 : 0;
+
+	if (len >= sizeof(name))
+		len = sizeof(name) - 1;
+
+	memcpy(name, cmd, len);
+	name[len] = '\0';
+
+	ofono_modem_record_latency(modem, "at", name, usec, ok);
+}
+
 GAtChat *at_util_open_device(struct ofono_modem *modem, const char *key,
 				GAtDebugFunc debug_func, char *debug_prefix,
 				char *tty_option, ...)
@@ -787,5 +818,7 @@ GAtChat *at_util_open_device(struct ofono_modem *modem, const char *key,
 	if (getenv("OFONO_AT_DEBUG"))
 		g_at_chat_set_debug(chat, debug_func, debug_prefix);
 
+	g_at_chat_set_latency(chat, at_util_latency, modem);
+
 	return chat;
 }
@@ -136,6 +136,218 @@ static bool is_fixed_size(const char *sig_start, const char *sig_end)
 	return true;
 }
 
+#define SIG_MAX_LEN 63
+#define SIG_OP_BYTES 'b'
+
+/*
+ * Signatures are compiled once per CID into a list of operations, so the
+ * message is walked without rescanning the signature string for every
+ * field.  Signatures of basic types only also get the static offset of
+ * each field, their messages are built and parsed directly.
+ */
+struct sig_op {
+	char type;		/* Basic or container type, or SIG_OP_BYTES */
+	bool fixed;		/* Container of fixed size elements */
+	uint8_t sig_start;	/* Element signature of a container */
+	uint8_t sig_end;
+	uint16_t offset;	/* Static offset, flat signatures only */
+	uint16_t len;		/* Size of SIG_OP_BYTES */
+};
+
+struct mbim_sig {
+	char signature[SIG_MAX_LEN + 1];
+	uint8_t uuid[16];
+	bool cached : 1;
+	bool flat : 1;		/* Basic types and fixed size byte arrays */
+	bool direct : 1;	/* Parsed offsets match the built ones */
+	uint16_t static_size;
+	uint8_t n_ops;
+	struct sig_op ops[];
+};
+
+/* CID to the list of signatures used with it, shared by all devices */
+static struct l_hashmap *sig_cache;
+static unsigned int sig_cache_users;
+
+static struct mbim_sig *sig_compile(const char *signature)
+{
+	struct sig_op ops[SIG_MAX_LEN];
+	struct mbim_sig *sig;
+	const char *s = signature;
+	const char *end;
+	unsigned int n_ops = 0;
+	unsigned int indent = 0;
+	size_t parse_pos = 0;
+	size_t pos = 0;
+	bool flat = true;
+	bool direct = true;
+	size_t len;
+
+	if (strlen(signature) > SIG_MAX_LEN)
+		return NULL;
+
+	while (*s) {
+		struct sig_op *op = &ops[n_ops++];
+
+		memset(op, 0, sizeof(*op));
+		op->type = *s;
+
+		switch (*s) {
+		case 'y':
+		case 'q':
+		case 'u':
+		case 't':
+		case 's':
+			len = *s == 's' ? 8 : get_basic_size(*s);
+			pos = align_len(pos, get_alignment(*s));
+			parse_pos = align_len(parse_pos, get_alignment(*s));
+			op->offset = pos;
+			pos += len;
+			parse_pos += len;
+			s += 1;
+			break;
+		case '0' ... '9':
+			end = _signature_end(s);
+			if (!end)
+				return NULL;
+
+			/* Built unaligned, but parsed from a 4 byte boundary */
+			op->type = SIG_OP_BYTES;
+			len = strtol(s, NULL, 10);
+			if (len > UINT16_MAX)
+				return NULL;
+
+			op->len = len;
+			op->offset = pos;
+			parse_pos = align_len(parse_pos, 4);
+
+			if (parse_pos != pos)
+				direct = false;
+
+			pos += op->len;
+			parse_pos += op->len;
+			s = end + 1;
+			break;
+		case '(':
+			end = _signature_end(s);
+			if (!end || ++indent > MAX_NESTING)
+				return NULL;
+
+			op->sig_start = s + 1 - signature;
+			op->sig_end = end - signature;
+			op->fixed = is_fixed_size(s + 1, end);
+			flat = false;
+			s += 1;
+			break;
+		case ')':
+			if (!indent)
+				return NULL;
+
+			indent -= 1;
+			flat = false;
+			s += 1;
+			break;
+		case 'a':
+			end = _signature_end(s + 1);
+			if (!end)
+				return NULL;
+
+			op->sig_start = s + 1 - signature;
+			op->sig_end = end + 1 - signature;
+			op->fixed = is_fixed_size(s + 1, end + 1);
+			flat = false;
+			s = end + 1;
+			break;
+		case 'v':
+		case 'd':
+			flat = false;
+			s += 1;
+			break;
+		default:
+			return NULL;
+		}
+	}
+
+	if (indent || pos > UINT16_MAX)
+		return NULL;
+
+	sig = l_malloc(sizeof(*sig) + n_ops * sizeof(struct sig_op));
+	memset(sig, 0, sizeof(*sig));
+	strcpy(sig->signature, signature);
+	sig->flat = flat;
+	sig->direct = flat && direct;
+	sig->static_size = pos;
+	sig->n_ops = n_ops;
+	memcpy(sig->ops, ops, n_ops * sizeof(struct sig_op));
+
+	return sig;
+}
+
+static void sig_list_free(void *data)
+{
+	l_queue_destroy(data, l_free);
+}
+
+void _mbim_message_sig_cache_ref(void)
+{
+	if (sig_cache_users++)
+		return;
+
+	sig_cache = l_hashmap_new();
+}
+
+void _mbim_message_sig_cache_unref(void)
+{
+	if (--sig_cache_users)
+		return;
+
+	l_hashmap_destroy(sig_cache, sig_list_free);
+	sig_cache = NULL;
+}
+
+/* Without a cache the signature is compiled for this use only */
+static struct mbim_sig *sig_get(const uint8_t *uuid, uint32_t cid,
+					const char *signature)
+{
+	const struct l_queue_entry *entry;
+	struct l_queue *sigs = NULL;
+	struct mbim_sig *sig;
+
+	if (sig_cache) {
+		sigs = l_hashmap_lookup(sig_cache, L_UINT_TO_PTR(cid));
+
+		for (entry = l_queue_get_entries(sigs); entry;
+							entry = entry->next) {
+			sig = entry->data;
+
+			if (!memcmp(sig->uuid, uuid, 16) &&
+					!strcmp(sig->signature, signature))
+				return sig;
+		}
+	}
+
+	sig = sig_compile(signature);
+	if (!sig || !sig_cache)
+		return sig;
+
+	if (!sigs) {
+		sigs = l_queue_new();
+		l_hashmap_insert(sig_cache, L_UINT_TO_PTR(cid), sigs);
+	}
+
+	memcpy(sig->uuid, uuid, 16);
+	sig->cached = true;
+	l_queue_push_tail(sigs, sig);
+
+	return sig;
+}
+
+static void sig_put(struct mbim_sig *sig)
+{
+	if (sig && !sig->cached)
+		l_free(sig);
+}
+
 static inline const void *_iter_get_data(struct mbim_message_iter *iter,
 						size_t pos)
 {
@@ -175,6 +387,16 @@ static bool _iter_copy_string(struct mbim_message_iter *iter,
 
 	tocopy = iter->iov[i].iov_len - (offset - iov_start);
 
+	/*
+	 * Strings are in UTF16-LE.  On little endian hosts a string that is
+	 * not split across fragments can be converted in place.
+	 */
+	if (tocopy >= len && L_CPU_TO_LE16(0x8000) == 0x8000) {
+		*out = l_utf8_from_utf16(iter->iov[i].iov_base +
+						offset - iov_start, len);
+		return true;
+	}
+
 	if (tocopy > remaining)
 		tocopy = remaining;
 
@@ -192,6 +414,7 @@ static bool _iter_copy_string(struct mbim_message_iter *iter,
 		memcpy(dest, iter->iov[i].iov_base, tocopy);
 		remaining -= tocopy;
 		dest += tocopy;
+		i += 1;
 	}
 
 	/* Strings are in UTF16-LE, so convert to UTF16-CPU first if needed */
@@ -316,33 +539,24 @@ static bool _iter_next_entry_basic(struct mbim_message_iter *iter,
 	return true;
 }
 
-static bool _iter_enter_array(struct mbim_message_iter *iter,
+static bool _iter_enter_array_sig(struct mbim_message_iter *iter,
+					const char *sig_start,
+					const char *sig_end, bool fixed,
 					struct mbim_message_iter *array)
 {
 	size_t pos;
 	uint32_t n_elem;
-	const char *sig_start;
-	const char *sig_end;
 	const void *data;
-	bool fixed;
 	uint32_t offset;
 
 	if (iter->container_type == CONTAINER_TYPE_ARRAY && !iter->n_elem)
 		return false;
 
-	if (iter->sig_start[iter->sig_pos] != 'a')
-		return false;
-
-	sig_start = iter->sig_start + iter->sig_pos + 1;
-	sig_end = _signature_end(sig_start) + 1;
-
 	/*
 	 * Two possibilities:
 	 * 1. Element Count, followed by OL_PAIR_LIST
 	 * 2. Offset, followed by element length or size for raw buffers
 	 */
-	fixed = is_fixed_size(sig_start, sig_end);
-
 	if (fixed) {
 		pos = align_len(iter->pos, 4);
 		if (pos + 4 > iter->len)
@@ -382,27 +596,38 @@ static bool _iter_enter_array(struct mbim_message_iter *iter,
 	return true;
 }
 
-static bool _iter_enter_struct(struct mbim_message_iter *iter,
+static bool _iter_enter_array(struct mbim_message_iter *iter,
+					struct mbim_message_iter *array)
+{
+	const char *sig_start;
+	const char *sig_end;
+
+	if (iter->sig_start[iter->sig_pos] != 'a')
+		return false;
+
+	sig_start = iter->sig_start + iter->sig_pos + 1;
+	sig_end = _signature_end(sig_start) + 1;
+
+	return _iter_enter_array_sig(iter, sig_start, sig_end,
+					is_fixed_size(sig_start, sig_end),
+					array);
+}
+
+static bool _iter_enter_struct_sig(struct mbim_message_iter *iter,
+					const char *sig_start,
+					const char *sig_end, bool fixed,
 					struct mbim_message_iter *structure)
 {
 	size_t offset;
 	size_t len;
 	size_t pos;
-	const char *sig_start;
-	const char *sig_end;
 	const void *data;
 
 	if (iter->container_type == CONTAINER_TYPE_ARRAY && !iter->n_elem)
 		return false;
 
-	if (iter->sig_start[iter->sig_pos] != '(')
-		return false;
-
-	sig_start = iter->sig_start + iter->sig_pos + 1;
-	sig_end = _signature_end(iter->sig_start + iter->sig_pos);
-
 	/* TODO: support fixed size structures */
-	if (is_fixed_size(sig_start, sig_end))
+	if (fixed)
 		return false;
 
 	pos = align_len(iter->pos, 4);
@@ -427,6 +652,50 @@ static bool _iter_enter_struct(struct mbim_message_iter *iter,
 	return true;
 }
 
+static bool _iter_enter_struct(struct mbim_message_iter *iter,
+					struct mbim_message_iter *structure)
+{
+	const char *sig_start;
+	const char *sig_end;
+
+	if (iter->sig_start[iter->sig_pos] != '(')
+		return false;
+
+	sig_start = iter->sig_start + iter->sig_pos + 1;
+	sig_end = _signature_end(iter->sig_start + iter->sig_pos);
+
+	return _iter_enter_struct_sig(iter, sig_start, sig_end,
+					is_fixed_size(sig_start, sig_end),
+					structure);
+}
+
+static bool _iter_copy_bytes(struct mbim_message_iter *iter,
+					uint32_t n_elem, uint8_t *dest)
+{
+	uint32_t i;
+	size_t pos;
+	const void *src;
+
+	if (iter->pos >= iter->len)
+		return false;
+
+	pos = align_len(iter->pos, 4);
+
+	if (pos + n_elem > iter->len)
+		return false;
+
+	for (i = 0; i + 4 < n_elem; i += 4) {
+		src = _iter_get_data(iter, pos + i);
+		memcpy(dest + i, src, 4);
+	}
+
+	src = _iter_get_data(iter, pos + i);
+	memcpy(dest + i, src, n_elem - i);
+	iter->pos = pos + n_elem;
+
+	return true;
+}
+
 static bool _iter_enter_databuf(struct mbim_message_iter *iter,
 					const char *signature,
 					struct mbim_message_iter *databuf)
@@ -468,35 +737,15 @@ static bool message_iter_next_entry_valist(struct mbim_message_iter *orig,
 
 		switch (*signature) {
 		case '0' ... '9':
-		{
-			uint32_t i;
-			uint32_t n_elem;
-			size_t pos;
-			const void *src;
-
-			if (iter->pos >= iter->len)
-				return false;
-
-			pos = align_len(iter->pos, 4);
 			end = _signature_end(signature);
-			n_elem = strtol(signature, NULL, 10);
-
-			if (pos + n_elem > iter->len)
-				return false;
-
 			arg = va_arg(args, uint8_t *);
 
-			for (i = 0; i + 4 < n_elem; i += 4) {
-				src = _iter_get_data(iter, pos + i);
-				memcpy(arg + i, src, 4);
-			}
+			if (!_iter_copy_bytes(iter, strtol(signature, NULL, 10),
+						arg))
+				return false;
 
-			src = _iter_get_data(iter, pos + i);
-			memcpy(arg + i, src, n_elem - i);
-			iter->pos = pos + n_elem;
 			signature = end + 1;
 			break;
-		}
 		case '(':
 			signature += 1;
 			indent += 1;
@@ -572,6 +821,128 @@ bool mbim_message_iter_next_entry(struct mbim_message_iter *iter, ...)
 	return result;
 }
 
+/* Flat signature within the first fragment, read at the static offsets */
+static bool sig_get_direct(struct mbim_message_iter *iter,
+				const struct mbim_sig *sig, va_list args)
+{
+	const uint8_t *base = iter->iov[0].iov_base + iter->base_offset;
+	unsigned int i;
+	void *arg;
+
+	for (i = 0; i < sig->n_ops; i++) {
+		const struct sig_op *op = &sig->ops[i];
+
+		arg = va_arg(args, void *);
+
+		switch (op->type) {
+		case 'y':
+			*(uint8_t *) arg = l_get_u8(base + op->offset);
+			break;
+		case 'q':
+			*(uint16_t *) arg = l_get_le16(base + op->offset);
+			break;
+		case 'u':
+			*(uint32_t *) arg = l_get_le32(base + op->offset);
+			break;
+		case 't':
+			*(uint64_t *) arg = l_get_le64(base + op->offset);
+			break;
+		case 's':
+			if (!_iter_copy_string(iter,
+					l_get_le32(base + op->offset),
+					l_get_le32(base + op->offset + 4),
+					arg))
+				return false;
+			break;
+		case SIG_OP_BYTES:
+			memcpy(arg, base + op->offset, op->len);
+			break;
+		}
+	}
+
+	iter->pos = sig->static_size;
+
+	return true;
+}
+
+static bool sig_get_arguments(struct mbim_message_iter *orig,
+				const struct mbim_sig *sig,
+				const char *signature, va_list args)
+{
+	struct mbim_message_iter *iter = orig;
+	struct mbim_message_iter stack[MAX_NESTING];
+	struct mbim_message_iter *sub_iter;
+	uint32_t *out_n_elem;
+	unsigned int indent = 0;
+	unsigned int i;
+
+	if (sig->direct && sig->static_size <= iter->len &&
+			iter->base_offset + sig->static_size <=
+						iter->iov[0].iov_len)
+		return sig_get_direct(iter, sig, args);
+
+	for (i = 0; i < sig->n_ops; i++) {
+		const struct sig_op *op = &sig->ops[i];
+
+		switch (op->type) {
+		case 'y':
+		case 'q':
+		case 'u':
+		case 't':
+		case 's':
+			if (!_iter_next_entry_basic(iter, op->type,
+							va_arg(args, void *)))
+				return false;
+			break;
+		case SIG_OP_BYTES:
+			if (!_iter_copy_bytes(iter, op->len,
+						va_arg(args, uint8_t *)))
+				return false;
+			break;
+		case '(':
+			if (!_iter_enter_struct_sig(iter,
+						signature + op->sig_start,
+						signature + op->sig_end,
+						op->fixed, &stack[indent]))
+				return false;
+
+			iter = &stack[indent++];
+			break;
+		case ')':
+			indent -= 1;
+			iter = indent ? &stack[indent - 1] : orig;
+			break;
+		case 'a':
+			out_n_elem = va_arg(args, uint32_t *);
+			sub_iter = va_arg(args, void *);
+
+			if (!_iter_enter_array_sig(iter,
+						signature + op->sig_start,
+						signature + op->sig_end,
+						op->fixed, sub_iter))
+				return false;
+
+			*out_n_elem = sub_iter->n_elem;
+			break;
+		case 'd':
+		{
+			const char *s = va_arg(args, const char *);
+
+			sub_iter = va_arg(args, void *);
+
+			if (!_iter_enter_databuf(iter, s, sub_iter))
+				return false;
+
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
 uint32_t _mbim_information_buffer_offset(uint32_t type)
 {
 	switch (type) {
@@ -797,6 +1168,7 @@ bool mbim_message_get_arguments(struct mbim_message *message,
 	va_list args;
 	bool result;
 	struct mbim_message_header *hdr;
+	struct mbim_sig *sig;
 	uint32_t type;
 	size_t begin;
 
@@ -815,10 +1187,19 @@ bool mbim_message_get_arguments(struct mbim_message *message,
 				message->frags, message->n_frags,
 				message->info_buf_len, begin, 0, 0);
 
+	sig = sig_get(message->uuid, message->cid, signature);
+
 	va_start(args, signature);
-	result = message_iter_next_entry_valist(&iter, args);
+
+	if (sig)
+		result = sig_get_arguments(&iter, sig, signature, args);
+	else
+		result = message_iter_next_entry_valist(&iter, args);
+
 	va_end(args);
 
+	sig_put(sig);
+
 	return result;
 }
 
@@ -954,14 +1335,22 @@ struct mbim_message_builder {
 	uint32_t index;
 };
 
+#define MIN_BUF_SIZE 64
+
 static inline size_t grow_buf(void **buf, size_t *buf_size, size_t *pos,
 				size_t len, unsigned int alignment)
 {
 	size_t size = align_len(*pos, alignment);
 
+	/* Grow geometrically, messages are built one field at a time */
 	if (size + len > *buf_size) {
-		*buf = l_realloc(*buf, size + len);
-		*buf_size = size + len;
+		size_t new_size = *buf_size ? *buf_size : MIN_BUF_SIZE;
+
+		while (new_size < size + len)
+			new_size *= 2;
+
+		*buf = l_realloc(*buf, new_size);
+		*buf_size = new_size;
 	}
 
 	if (size - *pos > 0)
@@ -1446,17 +1835,21 @@ struct mbim_message *mbim_message_builder_finalize(
 	l_put_le32(builder->message->info_buf_len,
 					root->sbuf + root->base_offset - 4);
 
-	builder->message->n_frags = 2;
-	builder->message->frags = l_new(struct iovec, 2);
+	/* Append the data to the static part, sent as a single fragment */
+	if (root->dbuf_pos) {
+		size_t start = GROW_SBUF(root, root->dbuf_pos, 1);
+
+		memcpy(root->sbuf + start, root->dbuf, root->dbuf_pos);
+	}
+
+	builder->message->n_frags = 1;
+	builder->message->frags = l_new(struct iovec, 1);
 	builder->message->frags[0].iov_base = root->sbuf;
 	builder->message->frags[0].iov_len = root->sbuf_pos;
-	builder->message->frags[1].iov_base = root->dbuf;
-	builder->message->frags[1].iov_len = root->dbuf_pos;
 
 	root->sbuf = NULL;
-	root->dbuf = NULL;
 
-	hdr->len = L_CPU_TO_LE32(HEADER_SIZE + root->dbuf_pos + root->sbuf_pos);
+	hdr->len = L_CPU_TO_LE32(HEADER_SIZE + root->sbuf_pos);
 
 	builder->message->sealed = true;
 
@@ -1695,11 +2088,184 @@ error:
 	return false;
 }
 
+/* Size of the UTF16 encoding of a UTF8 string, without the terminator */
+static bool utf16_size(const char *str, size_t *out_size)
+{
+	size_t len = strlen(str);
+	size_t size = 0;
+	size_t i;
+	wchar_t cp;
+	int n;
+
+	if (!l_utf8_validate(str, len, NULL))
+		return false;
+
+	for (i = 0; i < len; i += n) {
+		n = l_utf8_get_codepoint(str + i, len - i, &cp);
+		if (n <= 0)
+			return false;
+
+		size += cp < 0x10000 ? 2 : 4;
+	}
+
+	*out_size = size;
+	return true;
+}
+
+static void put_utf16(const char *str, uint8_t *dest)
+{
+	size_t len = strlen(str);
+	size_t i;
+	wchar_t cp;
+	int n;
+
+	for (i = 0; i < len; i += n) {
+		n = l_utf8_get_codepoint(str + i, len - i, &cp);
+
+		if (cp < 0x10000) {
+			l_put_le16(cp, dest);
+			dest += 2;
+			continue;
+		}
+
+		cp -= 0x10000;
+		l_put_le16(0xd800 | (cp >> 10), dest);
+		l_put_le16(0xdc00 | (cp & 0x3ff), dest + 2);
+		dest += 4;
+	}
+}
+
+/*
+ * Builds a flat signature straight into a single buffer.  The strings are
+ * measured first, so the buffer is allocated once at its final size.  The
+ * layout is the same as the one produced by the message builder.
+ */
+static bool sig_set_arguments(struct mbim_message *message,
+				const struct mbim_sig *sig, va_list args)
+{
+	struct mbim_message_header *hdr =
+			(struct mbim_message_header *) message->header;
+	uint32_t type = L_LE32_TO_CPU(hdr->type);
+	size_t begin = _mbim_information_buffer_offset(type);
+	uint32_t str_size[SIG_MAX_LEN];
+	size_t data_size = 0;
+	size_t data_pos;
+	va_list measure;
+	uint8_t *buf;
+	uint8_t *base;
+	const char *str;
+	size_t size;
+	unsigned int i;
+
+	va_copy(measure, args);
+
+	for (i = 0; i < sig->n_ops; i++) {
+		switch (sig->ops[i].type) {
+		case 'y':
+		case 'q':
+			va_arg(measure, int);
+			break;
+		case 'u':
+			va_arg(measure, uint32_t);
+			break;
+		case 't':
+			va_arg(measure, uint64_t);
+			break;
+		case SIG_OP_BYTES:
+			va_arg(measure, const uint8_t *);
+			break;
+		case 's':
+			str = va_arg(measure, const char *);
+			size = 0;
+
+			if (str && !utf16_size(str, &size)) {
+				va_end(measure);
+				return false;
+			}
+
+			str_size[i] = size;
+			data_size += align_len(size, 4);
+			break;
+		}
+	}
+
+	va_end(measure);
+
+	size = begin + sig->static_size + data_size;
+	buf = l_malloc(size);
+	memset(buf, 0, size);
+
+	base = buf + begin;
+	data_pos = sig->static_size;
+
+	for (i = 0; i < sig->n_ops; i++) {
+		const struct sig_op *op = &sig->ops[i];
+
+		switch (op->type) {
+		case 'y':
+			base[op->offset] = va_arg(args, int);
+			break;
+		case 'q':
+			l_put_le16(va_arg(args, int), base + op->offset);
+			break;
+		case 'u':
+			l_put_le32(va_arg(args, uint32_t), base + op->offset);
+			break;
+		case 't':
+			l_put_le64(va_arg(args, uint64_t), base + op->offset);
+			break;
+		case SIG_OP_BYTES:
+			memcpy(base + op->offset,
+				va_arg(args, const uint8_t *), op->len);
+			break;
+		case 's':
+			/* Null strings have neither offset nor length */
+			str = va_arg(args, const char *);
+			if (!str)
+				break;
+
+			put_utf16(str, base + data_pos);
+			l_put_le32(data_pos, base + op->offset);
+			l_put_le32(str_size[i], base + op->offset + 4);
+			data_pos += align_len(str_size[i], 4);
+			break;
+		}
+	}
+
+	memcpy(buf, message->uuid, 16);
+	l_put_le32(message->cid, buf + 16);
+
+	switch (type) {
+	case MBIM_COMMAND_DONE:
+		l_put_le32(message->status, buf + 20);
+		break;
+	case MBIM_COMMAND_MSG:
+		l_put_le32(message->command_type, buf + 20);
+		break;
+	default:
+		break;
+	}
+
+	message->info_buf_len = size - begin;
+	l_put_le32(message->info_buf_len, buf + begin - 4);
+
+	message->n_frags = 1;
+	message->frags = l_new(struct iovec, 1);
+	message->frags[0].iov_base = buf;
+	message->frags[0].iov_len = size;
+
+	hdr->len = L_CPU_TO_LE32(HEADER_SIZE + size);
+	message->sealed = true;
+
+	return true;
+}
+
 bool mbim_message_set_arguments(struct mbim_message *message,
 						const char *signature, ...)
 {
 	va_list args;
 	bool result;
+	struct mbim_sig *sig;
 
 	if (unlikely(!message))
 		return false;
@@ -1710,10 +2276,19 @@ bool mbim_message_set_arguments(struct mbim_message *message,
 	if (!signature)
 		return true;
 
+	sig = sig_get(message->uuid, message->cid, signature);
+
 	va_start(args, signature);
-	result = append_arguments(message, signature, args);
+
+	if (sig && sig->flat)
+		result = sig_set_arguments(message, sig, args);
+	else
+		result = append_arguments(message, signature, args);
+
 	va_end(args);
 
+	sig_put(sig);
+
 	return result;
 }
 
@@ -1731,9 +2306,9 @@ struct iovec *_mbim_message_get_body(struct mbim_message *message,
 	if (out_len)
 		*out_len = message->info_buf_len;
 
+	/* Built messages are a single fragment, headers included */
 	if (out_n_iov)
-		*out_n_iov = message->info_buf_len ? message->n_frags :
-							message->n_frags - 1;
+		*out_n_iov = message->n_frags;
 
 	return message->frags;
 }
@@ -57,3 +57,5 @@ void *_mbim_message_to_bytearray(struct mbim_message *message, size_t *out_len);
 void *_mbim_message_get_header(struct mbim_message *message, size_t *out_len);
 struct iovec *_mbim_message_get_body(struct mbim_message *message,
 					size_t *out_n_iov, size_t *out_len);
+void _mbim_message_sig_cache_ref(void);
+void _mbim_message_sig_cache_unref(void);
@@ -27,6 +27,7 @@
 #include <unistd.h>
 #include <limits.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <linux/types.h>
@@ -121,35 +122,33 @@ const uint8_t mbim_context_type_local[] = {
 	0x03, 0x3C, 0x39, 0xF6, 0x0D, 0xB9,
 };
 
+/*
+ * Fragmented messages are reassembled into a single buffer sized from the
+ * InformationBufferLength of the first fragment.  Subsequent fragments are
+ * read straight into that buffer, so the finished message is built without
+ * copying.  Transactions are indexed by TID; indications from the function
+ * use TID 0, which cannot be used as a hashmap key, and get their own slot.
+ */
 struct message_assembly_node {
 	struct mbim_message_header msg_hdr;
 	struct mbim_fragment_header frag_hdr;
-	struct iovec *iov;
-	size_t n_iov;
-	size_t cur_iov;
-} __attribute((packed))__;
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	uint32_t n_frags;
+	uint32_t cur_frag;
+};
 
 struct message_assembly {
-	struct l_queue *transactions;
+	struct l_hashmap *transactions;
+	struct message_assembly_node *indication;
 };
 
-static bool message_assembly_node_match_tid(const void *a, const void *b)
-{
-	const struct message_assembly_node *node = a;
-	uint32_t tid = L_PTR_TO_UINT(b);
-
-	return L_LE32_TO_CPU(node->msg_hdr.tid) == tid;
-}
-
 static void message_assembly_node_free(void *data)
 {
 	struct message_assembly_node *node = data;
-	size_t i;
-
-	for (i = 0; i < node->n_iov; i++)
-		l_free(node->iov[i].iov_base);
 
-	l_free(node->iov);
+	l_free(node->buf);
 	l_free(node);
 }
 
@@ -157,21 +156,89 @@ static struct message_assembly *message_assembly_new()
 {
 	struct message_assembly *assembly = l_new(struct message_assembly, 1);
 
-	assembly->transactions = l_queue_new();
+	assembly->transactions = l_hashmap_new();
 
 	return assembly;
 }
 
 static void message_assembly_free(struct message_assembly *assembly)
 {
-	l_queue_destroy(assembly->transactions, message_assembly_node_free);
+	l_hashmap_destroy(assembly->transactions, message_assembly_node_free);
+
+	if (assembly->indication)
+		message_assembly_node_free(assembly->indication);
+
 	l_free(assembly);
 }
 
+static struct message_assembly_node *message_assembly_find(
+					struct message_assembly *assembly,
+					uint32_t tid)
+{
+	if (!tid)
+		return assembly->indication;
+
+	return l_hashmap_lookup(assembly->transactions, L_UINT_TO_PTR(tid));
+}
+
+static void message_assembly_insert(struct message_assembly *assembly,
+					uint32_t tid,
+					struct message_assembly_node *node)
+{
+	if (!tid) {
+		assembly->indication = node;
+		return;
+	}
+
+	l_hashmap_insert(assembly->transactions, L_UINT_TO_PTR(tid), node);
+}
+
+static void message_assembly_remove(struct message_assembly *assembly,
+					uint32_t tid)
+{
+	if (!tid) {
+		assembly->indication = NULL;
+		return;
+	}
+
+	l_hashmap_remove(assembly->transactions, L_UINT_TO_PTR(tid));
+}
+
+/*
+ * Returns where the body of the fragment described by header should be
+ * read to, if it continues a transaction being reassembled.  Only the
+ * message header is available at this point.
+ */
+static void *message_assembly_get_buffer(struct message_assembly *assembly,
+						const void *header,
+						size_t frag_len)
+{
+	const struct mbim_message_header *msg_hdr = header;
+	struct message_assembly_node *node;
+
+	node = message_assembly_find(assembly, L_LE32_TO_CPU(msg_hdr->tid));
+	if (!node)
+		return NULL;
+
+	if (node->msg_hdr.type != msg_hdr->type)
+		return NULL;
+
+	if (node->len + frag_len > node->size)
+		return NULL;
+
+	return node->buf + node->len;
+}
+
+/*
+ * frag_used is set if the assembly took ownership of frag.  Fragments read
+ * into a reassembly buffer via message_assembly_get_buffer are never owned
+ * by the caller.
+ */
 static struct mbim_message *message_assembly_add(
 					struct message_assembly *assembly,
 					const void *header,
-					void *frag, size_t frag_len)
+					void *frag, size_t frag_len,
+					bool *frag_used)
 {
 	const struct mbim_message_header *msg_hdr = header;
 	const struct mbim_fragment_header *frag_hdr = header +
@@ -182,64 +249,98 @@ static struct mbim_message *message_assembly_add(
 	uint32_t cur_frag = L_LE32_TO_CPU(frag_hdr->cur_frag);
 	struct message_assembly_node *node;
 	struct mbim_message *message;
+	struct iovec *iov;
+	uint32_t offset;
+	size_t size;
+
+	*frag_used = false;
 
 	if (unlikely(type != MBIM_COMMAND_DONE &&
 				type != MBIM_INDICATE_STATUS_MSG))
 		return NULL;
 
-	node = l_queue_find(assembly->transactions,
-				message_assembly_node_match_tid,
-				L_UINT_TO_PTR(tid));
+	node = message_assembly_find(assembly, tid);
 
 	if (!node) {
-		if (cur_frag != 0)
+		if (cur_frag != 0 || n_frags == 0)
 			return NULL;
 
-		if (n_frags == 1) {
-			struct iovec *iov = l_new(struct iovec, 1);
+		*frag_used = true;
 
+		if (n_frags == 1) {
+			iov = l_new(struct iovec, 1);
 			iov[0].iov_base = frag;
 			iov[0].iov_len = frag_len;
 
-			return _mbim_message_build(header, iov, 1);
+			message = _mbim_message_build(header, iov, 1);
+			if (!message) {
+				l_free(frag);
+				l_free(iov);
+			}
+
+			return message;
 		}
 
+		/*
+		 * Size the buffer for the whole message.  No fragment can be
+		 * larger than the first one, which bounds the allocation.
+		 */
+		offset = _mbim_information_buffer_offset(type);
+		if (frag_len < offset)
+			goto discard;
+
+		size = offset + l_get_le32(frag + offset - 4);
+		if (size < frag_len || size > (size_t) n_frags * frag_len)
+			goto discard;
+
 		node = l_new(struct message_assembly_node, 1);
 		memcpy(&node->msg_hdr, msg_hdr, sizeof(*msg_hdr));
 		memcpy(&node->frag_hdr, frag_hdr, sizeof(*frag_hdr));
-		node->iov = l_new(struct iovec, n_frags);
-		node->n_iov = n_frags;
-		node->cur_iov = cur_frag;
-		node->iov[node->cur_iov].iov_base = frag;
-		node->iov[node->cur_iov].iov_len = frag_len;
+		node->buf = l_realloc(frag, size);
+		node->size = size;
+		node->len = frag_len;
+		node->n_frags = n_frags;
+		node->cur_frag = cur_frag;
 
-		l_queue_push_head(assembly->transactions, node);
+		message_assembly_insert(assembly, tid, node);
 
 		return NULL;
 	}
 
-	if (node->n_iov != n_frags)
+	if (node->n_frags != n_frags)
+		return NULL;
+
+	if (node->cur_frag + 1 != cur_frag)
 		return NULL;
 
-	if (node->cur_iov + 1 != cur_frag)
+	/* The fragment did not fit, or went elsewhere */
+	if (frag != node->buf + node->len)
 		return NULL;
 
-	node->cur_iov = cur_frag;
-	node->iov[node->cur_iov].iov_base = frag;
-	node->iov[node->cur_iov].iov_len = frag_len;
+	node->cur_frag = cur_frag;
+	node->len += frag_len;
 
-	if (node->cur_iov + 1 < node->n_iov)
+	if (node->cur_frag + 1 < node->n_frags)
 		return NULL;
 
-	l_queue_remove(assembly->transactions, node);
-	message = _mbim_message_build(&node->msg_hdr, node->iov, node->n_iov);
+	message_assembly_remove(assembly, tid);
 
-	if (!message)
+	iov = l_new(struct iovec, 1);
+	iov[0].iov_base = node->buf;
+	iov[0].iov_len = node->len;
+
+	message = _mbim_message_build(&node->msg_hdr, iov, 1);
+	if (!message) {
 		message_assembly_node_free(node);
-	else
+		l_free(iov);
+	} else
 		l_free(node);
 
 	return message;
+
+discard:
+	l_free(frag);
+	return NULL;
 }
 
 struct mbim_device {
@@ -252,6 +353,8 @@ struct mbim_device {
 	mbim_device_debug_func_t debug_handler;
 	void *debug_data;
 	mbim_device_destroy_func_t debug_destroy;
+	mbim_device_latency_func_t latency_handler;
+	void *latency_data;
 	mbim_device_disconnect_func_t disconnect_handler;
 	void *disconnect_data;
 	mbim_device_destroy_func_t disconnect_destroy;
@@ -262,8 +365,9 @@ struct mbim_device {
 	size_t header_offset;
 	size_t segment_bytes_remaining;
 	void *segment;
+	void *frag_buf;
 	struct l_queue *pending_commands;
-	struct l_queue *sent_commands;
+	struct l_hashmap *sent_commands;
 	struct l_queue *notifications;
 	struct message_assembly *assembly;
 	struct l_idle *close_io;
@@ -279,8 +383,18 @@ struct pending_command {
 	mbim_device_reply_func_t callback;
 	mbim_device_destroy_func_t destroy;
 	void *user_data;
+	uint64_t sent_time;
 };
 
+static uint64_t time_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
 static bool pending_command_match_tid(const void *a, const void *b)
 {
 	const struct pending_command *pending = a;
@@ -316,7 +430,8 @@ static void pending_command_free(void *pending)
 	l_free(pending);
 }
 
-static void pending_command_cancel_by_gid(void *data, void *user_data)
+static void pending_command_cancel_by_gid(const void *key, void *data,
+							void *user_data)
 {
 	struct pending_command *pending = data;
 	uint32_t gid = L_PTR_TO_UINT(user_data);
@@ -439,6 +554,70 @@ static int receive_header(struct mbim_device *device, int fd)
 	return true;
 }
 
+struct in_flight_match {
+	const uint8_t *uuid;
+	uint32_t cid;
+	bool found;
+};
+
+static void command_match_in_flight(const void *key, void *data,
+							void *user_data)
+{
+	struct pending_command *pending = data;
+	struct in_flight_match *match = user_data;
+
+	/* Cancelled commands have dropped their message */
+	if (!pending->message)
+		return;
+
+	if (mbim_message_get_cid(pending->message) != match->cid)
+		return;
+
+	if (memcmp(mbim_message_get_uuid(pending->message), match->uuid, 16))
+		return;
+
+	match->found = true;
+}
+
+static bool command_in_flight(struct mbim_device *device,
+					struct mbim_message *message)
+{
+	struct in_flight_match match = {
+		.uuid = mbim_message_get_uuid(message),
+		.cid = mbim_message_get_cid(message),
+		.found = false,
+	};
+
+	l_hashmap_foreach(device->sent_commands, command_match_in_flight,
+								&match);
+
+	return match.found;
+}
+
+/*
+ * Up to max_outstanding commands are sent without waiting for replies.
+ * Commands for the same CID are still sent in order, one at a time, so
+ * that e.g. a set followed by a query is not reordered by the function.
+ */
+static struct pending_command *next_pending_command(
+						struct mbim_device *device)
+{
+	const struct l_queue_entry *entry;
+
+	for (entry = l_queue_get_entries(device->pending_commands);
+						entry; entry = entry->next) {
+		struct pending_command *pending = entry->data;
+
+		if (command_in_flight(device, pending->message))
+			continue;
+
+		l_queue_remove(device->pending_commands, pending);
+		return pending;
+	}
+
+	return NULL;
+}
+
 static bool command_write_handler(struct l_io *io, void *user_data)
 {
 	struct mbim_device *device = user_data;
@@ -456,7 +635,10 @@ static bool command_write_handler(struct l_io *io, void *user_data)
 	 * For now assume we write out the entire command in one go without
 	 * hitting an EAGAIN
 	 */
-	pending = l_queue_pop_head(device->pending_commands);
+	if (l_hashmap_size(device->sent_commands) >= device->max_outstanding)
+		return false;
+
+	pending = next_pending_command(device);
 	if (!pending)
 		return false;
 
@@ -500,12 +682,14 @@ static bool command_write_handler(struct l_io *io, void *user_data)
 				"fragment me");
 	}
 
-	l_queue_push_tail(device->sent_commands, pending);
+	pending->sent_time = time_now_us();
+	l_hashmap_insert(device->sent_commands, L_UINT_TO_PTR(pending->tid),
+								pending);
 
 	if (l_queue_isempty(device->pending_commands))
 		return false;
 
-	if (l_queue_length(device->sent_commands) >= device->max_outstanding)
+	if (l_hashmap_size(device->sent_commands) >= device->max_outstanding)
 		return false;
 
 	/* Only continue sending messages if the connection is ready */
@@ -519,12 +703,23 @@ static void dispatch_command_done(struct mbim_device *device,
 			_mbim_message_get_header(message, NULL);
 	struct pending_command *pending;
 
-	pending = l_queue_remove_if(device->sent_commands,
-					pending_command_match_tid,
+	pending = l_hashmap_remove(device->sent_commands,
 					L_UINT_TO_PTR(L_LE32_TO_CPU(hdr->tid)));
 	if (!pending)
 		goto done;
 
+	l_util_debug(device->debug_handler, device->debug_data,
+			"tid %u cid %u completed in %llu us, %u in flight",
+			pending->tid, mbim_message_get_cid(message),
+			(unsigned long long) (time_now_us() -
+							pending->sent_time),
+			l_hashmap_size(device->sent_commands));
+
+	if (device->latency_handler)
+		device->latency_handler(message,
+					time_now_us() - pending->sent_time,
+					device->latency_data);
+
 	if (pending->callback)
 		pending->callback(message, pending->user_data);
 
@@ -612,6 +807,7 @@ static bool command_read_handler(struct l_io *io, void *user_data)
 	uint32_t n_iov = 0;
 	uint32_t header_size;
 	struct mbim_message *message;
+	bool frag_used;
 	uint32_t i;
 
 	fd = l_io_get_fd(io);
@@ -627,16 +823,28 @@ static bool command_read_handler(struct l_io *io, void *user_data)
 	hdr = (struct mbim_message_header *) device->header;
 	type = L_LE32_TO_CPU(hdr->type);
 
-	if (device->segment_bytes_remaining == 0)
-		device->segment_bytes_remaining =
-					L_LE32_TO_CPU(hdr->len) -
-					sizeof(struct mbim_message_header);
-
 	if (type == MBIM_COMMAND_DONE || type == MBIM_INDICATE_STATUS_MSG)
 		header_size = HEADER_SIZE;
 	else
 		header_size = sizeof(struct mbim_message_header);
 
+	if (device->segment_bytes_remaining == 0) {
+		device->segment_bytes_remaining =
+					L_LE32_TO_CPU(hdr->len) -
+					sizeof(struct mbim_message_header);
+
+		/* Continuations are read straight into the reassembly */
+		device->frag_buf = NULL;
+
+		if (header_size == HEADER_SIZE)
+			device->frag_buf = message_assembly_get_buffer(
+					device->assembly, hdr,
+					L_LE32_TO_CPU(hdr->len) - header_size);
+
+		if (!device->frag_buf)
+			device->frag_buf = device->segment;
+	}
+
 	/* Put the rest of the header into the first chunk */
 	if (device->header_offset < header_size) {
 		iov[n_iov].iov_base = device->header + device->header_offset;
@@ -649,7 +857,7 @@ static bool command_read_handler(struct l_io *io, void *user_data)
 	l_info("header_offset: %zu", device->header_offset);
 	l_info("segment_bytes_remaining: %zu", device->segment_bytes_remaining);
 
-	iov[n_iov].iov_base = device->segment + L_LE32_TO_CPU(hdr->len) -
+	iov[n_iov].iov_base = device->frag_buf + L_LE32_TO_CPU(hdr->len) -
 				device->header_offset -
 				device->segment_bytes_remaining;
 	iov[n_iov].iov_len = device->segment_bytes_remaining -
@@ -691,9 +899,13 @@ static bool command_read_handler(struct l_io *io, void *user_data)
 
 	device->header_offset = 0;
 	message = message_assembly_add(device->assembly, device->header,
-					device->segment,
-					L_LE32_TO_CPU(hdr->len) - header_size);
-	device->segment = l_malloc(device->max_segment_size - HEADER_SIZE);
+					device->frag_buf,
+					L_LE32_TO_CPU(hdr->len) - header_size,
+					&frag_used);
+
+	if (device->frag_buf == device->segment && frag_used)
+		device->segment = l_malloc(device->max_segment_size -
+								HEADER_SIZE);
 
 	if (!message)
 		return true;
@@ -917,10 +1129,12 @@ struct mbim_device *mbim_device_new(int fd, uint32_t max_segment_size)
 	l_io_set_write_handler(device->io, open_write_handler, device, NULL);
 
 	device->pending_commands = l_queue_new();
-	device->sent_commands = l_queue_new();
+	device->sent_commands = l_hashmap_new();
 	device->notifications = l_queue_new();
 	device->assembly = message_assembly_new();
 
+	_mbim_message_sig_cache_ref();
+
 	return mbim_device_ref(device);
 }
 
@@ -958,10 +1172,12 @@ void mbim_device_unref(struct mbim_device *device)
 		device->disconnect_destroy(device->disconnect_data);
 
 	l_queue_destroy(device->pending_commands, pending_command_free);
-	l_queue_destroy(device->sent_commands, pending_command_free);
+	l_hashmap_destroy(device->sent_commands, pending_command_free);
 	l_queue_destroy(device->notifications, notification_free);
 	message_assembly_free(device->assembly);
 	l_free(device);
+
+	_mbim_message_sig_cache_unref();
 }
 
 bool mbim_device_shutdown(struct mbim_device *device)
@@ -981,7 +1197,8 @@ bool mbim_device_set_max_outstanding(struct mbim_device *device, uint32_t max)
 	if (unlikely(!device))
 		return false;
 
-	device->max_outstanding = max;
+	/* Some functions report 0, treat it as no pipelining */
+	device->max_outstanding = max ? max : 1;
 	return true;
 }
 
@@ -1020,6 +1237,19 @@ bool mbim_device_set_debug(struct mbim_device *device,
 	return true;
 }
 
+bool mbim_device_set_latency(struct mbim_device *device,
+				mbim_device_latency_func_t func,
+				void *user_data)
+{
+	if (unlikely(!device))
+		return false;
+
+	device->latency_handler = func;
+	device->latency_data = user_data;
+
+	return true;
+}
+
 bool mbim_device_set_close_on_unref(struct mbim_device *device, bool do_close)
 {
 	if (unlikely(!device))
@@ -1075,7 +1305,7 @@ uint32_t mbim_device_send(struct mbim_device *device, uint32_t gid,
 	if (!device->is_ready)
 		goto done;
 
-	if (l_queue_length(device->sent_commands) >= device->max_outstanding)
+	if (l_hashmap_size(device->sent_commands) >= device->max_outstanding)
 		goto done;
 
 	l_io_set_write_handler(device->io, command_write_handler,
@@ -1099,9 +1329,7 @@ bool mbim_device_cancel(struct mbim_device *device, uint32_t tid)
 		return true;
 	}
 
-	pending = l_queue_find(device->sent_commands,
-					pending_command_match_tid,
-					L_UINT_TO_PTR(tid));
+	pending = l_hashmap_lookup(device->sent_commands, L_UINT_TO_PTR(tid));
 
 	if (!pending)
 		return false;
@@ -1119,7 +1347,7 @@ bool mbim_device_cancel_group(struct mbim_device *device, uint32_t gid)
 					pending_command_free_by_gid,
 					L_UINT_TO_PTR(gid));
 
-	l_queue_foreach(device->sent_commands,
+	l_hashmap_foreach(device->sent_commands,
 					pending_command_cancel_by_gid,
 					L_UINT_TO_PTR(gid));
 
@@ -91,6 +91,9 @@ typedef void (*mbim_device_debug_func_t) (const char *str, void *user_data);
 typedef void (*mbim_device_disconnect_func_t) (void *user_data);
 typedef void (*mbim_device_destroy_func_t) (void *user_data);
 typedef void (*mbim_device_ready_func_t) (void *user_data);
+typedef void (*mbim_device_latency_func_t) (struct mbim_message *message,
+						uint32_t usec,
+						void *user_data);
 typedef void (*mbim_device_reply_func_t) (struct mbim_message *message,
 							void *user_data);
 
@@ -123,6 +126,9 @@ bool mbim_device_set_max_outstanding(struct mbim_device *device, uint32_t max);
 bool mbim_device_set_debug(struct mbim_device *device,
 				mbim_device_debug_func_t func, void *user_data,
 				mbim_device_destroy_func_t destroy);
+bool mbim_device_set_latency(struct mbim_device *device,
+				mbim_device_latency_func_t func,
+				void *user_data);
 bool mbim_device_set_disconnect_handler(struct mbim_device *device,
 					mbim_device_disconnect_func_t function,
 					void *user_data,
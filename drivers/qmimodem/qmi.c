@@ -38,6 +38,7 @@
 #include <ofono/log.h>
 
 #include "qmi.h"
+#include "qmux.h"
 #include "ctl.h"
 
 typedef void (*qmi_message_func_t)(uint16_t message, uint16_t length,
@@ -62,13 +63,16 @@ struct qmi_device {
 	guint read_watch;
 	guint write_watch;
 	GQueue *req_queue;
-	GQueue *control_queue;
-	GQueue *service_queue;
+	GHashTable *control_pending;
+	GHashTable *service_pending;
 	GQueue *discovery_queue;
+	struct qmux_reader reader;
 	uint8_t next_control_tid;
 	uint16_t next_service_tid;
 	qmi_debug_func_t debug_func;
 	void *debug_data;
+	qmi_latency_func_t latency_func;
+	void *latency_data;
 	uint16_t control_major;
 	uint16_t control_minor;
 	char *version_str;
@@ -95,9 +99,13 @@ struct qmi_service {
 	GList *notify_list;
 };
 
+#define QMI_PARAM_INLINE_SIZE 16
+
 struct qmi_param {
 	void *data;
 	uint16_t length;
+	size_t size;
+	uint8_t buf[QMI_PARAM_INLINE_SIZE];	/* Avoids allocating small params */
 };
 
 struct qmi_result {
@@ -106,6 +114,8 @@ struct qmi_result {
 	uint16_t error;
 	const void *data;
 	uint16_t length;
+	bool indexed;
+	uint16_t tlv_offset[256];	/* Offset + 1 of each TLV, 0 if absent */
 };
 
 struct qmi_request {
@@ -115,6 +125,7 @@ struct qmi_request {
 	size_t len;
 	qmi_message_func_t callback;
 	void *user_data;
+	int64_t start;
 };
 
 struct qmi_notify {
@@ -125,15 +136,6 @@ struct qmi_notify {
 	qmi_destroy_func_t destroy;
 };
 
-struct qmi_mux_hdr {
-	uint8_t  frame;		/* Always 0x01 */
-	uint16_t length;	/* Packet size without frame byte */
-	uint8_t  flags;		/* Either 0x00 or 0x80 */
-	uint8_t  service;	/* Service type (0x00 for control) */
-	uint8_t  client;	/* Client identifier (0x00 for control) */
-} __attribute__ ((packed));
-#define QMI_MUX_HDR_SIZE 6
-
 struct qmi_control_hdr {
 	uint8_t  type;		/* Bit 1 = response, Bit 2 = indication */
 	uint8_t  transaction;	/* Transaction identifier */
@@ -220,6 +222,23 @@ static void __request_free(gpointer data, gpointer user_data)
 	g_free(req);
 }
 
+static void __request_destroy(gpointer data)
+{
+	__request_free(data, NULL);
+}
+
+static struct qmi_request *__request_steal(GHashTable *pending,
+							uint16_t tid)
+{
+	struct qmi_request *req;
+
+	req = g_hash_table_lookup(pending, GUINT_TO_POINTER(tid));
+	if (req)
+		g_hash_table_steal(pending, GUINT_TO_POINTER(tid));
+
+	return req;
+}
+
 static gint __request_compare(gconstpointer a, gconstpointer b)
 {
 	const struct qmi_request *req = a;
@@ -658,6 +677,8 @@ static gboolean can_write_data(GIOChannel *channel, GIOCondition cond,
 	if (bytes_written < 0)
 		return FALSE;
 
+	req->start = g_get_monotonic_time();
+
 	__hexdump('>', req->buf, bytes_written,
 				device->debug_func, device->debug_data);
 
@@ -667,9 +688,11 @@ static gboolean can_write_data(GIOChannel *channel, GIOCondition cond,
 	hdr = req->buf;
 
 	if (hdr->service == QMI_SERVICE_CONTROL)
-		g_queue_push_tail(device->control_queue, req);
+		g_hash_table_replace(device->control_pending,
+					GUINT_TO_POINTER(req->tid), req);
 	else
-		g_queue_push_tail(device->service_queue, req);
+		g_hash_table_replace(device->service_pending,
+					GUINT_TO_POINTER(req->tid), req);
 
 	g_free(req->buf);
 	req->buf = NULL;
@@ -730,6 +753,11 @@ static uint16_t __request_submit(struct qmi_device *device,
 	return req->tid;
 }
 
+struct indication {
+	uint8_t service_type;
+	struct qmi_result result;
+};
+
 static void service_notify(gpointer key, gpointer value, gpointer user_data)
 {
 	struct qmi_service *service = value;
@@ -745,6 +773,19 @@ static void service_notify(gpointer key, gpointer value, gpointer user_data)
 	}
 }
 
+static void service_broadcast(gpointer key, gpointer value,
+							gpointer user_data)
+{
+	struct qmi_service *service = value;
+	struct indication *ind = user_data;
+
+	/* Broadcasts only concern clients of the same service type */
+	if (service->type != ind->service_type)
+		return;
+
+	service_notify(key, value, &ind->result);
+}
+
 static void handle_indication(struct qmi_device *device,
 			uint8_t service_type, uint8_t client_id,
 			uint16_t message, uint16_t length, const void *data)
@@ -761,10 +802,16 @@ static void handle_indication(struct qmi_device *device,
 	result.message = message;
 	result.data = data;
 	result.length = length;
+	result.indexed = false;
 
 	if (client_id == 0xff) {
+		struct indication ind = {
+			.service_type = service_type,
+			.result = result,
+		};
+
 		g_hash_table_foreach(device->service_list,
-						service_notify, &result);
+						service_broadcast, &ind);
 		return;
 	}
 
@@ -778,28 +825,76 @@ static void handle_indication(struct qmi_device *device,
 	service_notify(NULL, service, &result);
 }
 
+static const void *tlv_get(const void *data, uint16_t size,
+					uint8_t type, uint16_t *length)
+{
+	const void *ptr = data;
+	uint16_t len = size;
+
+	while (len > QMI_TLV_HDR_SIZE) {
+		const struct qmi_tlv_hdr *tlv = ptr;
+		uint16_t tlv_length = GUINT16_FROM_LE(tlv->length);
+
+		if (QMI_TLV_HDR_SIZE + tlv_length > len)
+			break;
+
+		if (tlv->type == type) {
+			if (length)
+				*length = tlv_length;
+
+			return ptr + QMI_TLV_HDR_SIZE;
+		}
+
+		ptr += QMI_TLV_HDR_SIZE + tlv_length;
+		len -= QMI_TLV_HDR_SIZE + tlv_length;
+	}
+
+	return NULL;
+}
+
+/* Responses without a result code TLV count as successful */
+static bool result_code_ok(const void *data, uint16_t length)
+{
+	const struct qmi_result_code *result_code;
+	uint16_t len;
+
+	result_code = tlv_get(data, length, 0x02, &len);
+	if (!result_code || len != QMI_RESULT_CODE_SIZE)
+		return true;
+
+	return GUINT16_FROM_LE(result_code->result) == 0x0000;
+}
+
 static void handle_packet(struct qmi_device *device,
-				const struct qmi_mux_hdr *hdr, const void *buf)
+				const struct qmi_mux_hdr *hdr, size_t len)
 {
+	const void *buf = (const void *) hdr + QMI_MUX_HDR_SIZE;
 	struct qmi_request *req;
 	uint16_t message, length;
 	const void *data;
 
+	len -= QMI_MUX_HDR_SIZE;
+
 	if (hdr->service == QMI_SERVICE_CONTROL) {
 		const struct qmi_control_hdr *control = buf;
 		const struct qmi_message_hdr *msg;
 		unsigned int tid;
-		GList *list;
 
 		/* Ignore control messages with client identifier */
 		if (hdr->client != 0x00)
 			return;
 
+		if (len < QMI_CONTROL_HDR_SIZE + QMI_MESSAGE_HDR_SIZE)
+			return;
+
 		msg = buf + QMI_CONTROL_HDR_SIZE;
 
 		message = GUINT16_FROM_LE(msg->message);
 		length = GUINT16_FROM_LE(msg->length);
 
+		if (length > len - QMI_CONTROL_HDR_SIZE - QMI_MESSAGE_HDR_SIZE)
+			return;
+
 		data = buf + QMI_CONTROL_HDR_SIZE + QMI_MESSAGE_HDR_SIZE;
 
 		tid = control->transaction;
@@ -810,25 +905,25 @@ static void handle_packet(struct qmi_device *device,
 			return;
 		}
 
-		list = g_queue_find_custom(device->control_queue,
-				GUINT_TO_POINTER(tid), __request_compare);
-		if (!list)
+		req = __request_steal(device->control_pending, tid);
+		if (!req)
 			return;
-
-		req = list->data;
-
-		g_queue_delete_link(device->control_queue, list);
 	} else {
 		const struct qmi_service_hdr *service = buf;
 		const struct qmi_message_hdr *msg;
 		unsigned int tid;
-		GList *list;
+
+		if (len < QMI_SERVICE_HDR_SIZE + QMI_MESSAGE_HDR_SIZE)
+			return;
 
 		msg = buf + QMI_SERVICE_HDR_SIZE;
 
 		message = GUINT16_FROM_LE(msg->message);
 		length = GUINT16_FROM_LE(msg->length);
 
+		if (length > len - QMI_SERVICE_HDR_SIZE - QMI_MESSAGE_HDR_SIZE)
+			return;
+
 		data = buf + QMI_SERVICE_HDR_SIZE + QMI_MESSAGE_HDR_SIZE;
 
 		tid = GUINT16_FROM_LE(service->transaction);
@@ -839,70 +934,63 @@ static void handle_packet(struct qmi_device *device,
 			return;
 		}
 
-		list = g_queue_find_custom(device->service_queue,
-				GUINT_TO_POINTER(tid), __request_compare);
-		if (!list)
+		req = __request_steal(device->service_pending, tid);
+		if (!req)
 			return;
-
-		req = list->data;
-
-		g_queue_delete_link(device->service_queue, list);
 	}
 
+	if (device->latency_func)
+		device->latency_func(__service_type_to_string(hdr->service),
+					message,
+					g_get_monotonic_time() - req->start,
+					result_code_ok(data, length),
+					device->latency_data);
+
 	if (req->callback)
 		req->callback(message, length, data, req->user_data);
 
 	__request_free(req, NULL);
 }
 
+/* Amount of data requested from the device per read */
+#define QMI_READ_SIZE 4096
+
 static gboolean received_data(GIOChannel *channel, GIOCondition cond,
 							gpointer user_data)
 {
 	struct qmi_device *device = user_data;
-	struct qmi_mux_hdr *hdr;
-	unsigned char buf[2048];
+	const struct qmi_mux_hdr *hdr;
+	uint8_t *buf;
 	ssize_t bytes_read;
-	uint16_t offset;
+	size_t len;
 
 	if (cond & G_IO_NVAL)
 		return FALSE;
 
-	bytes_read = read(device->fd, buf, sizeof(buf));
-	if (bytes_read < 0)
+	buf = qmux_reader_reserve(&device->reader, QMI_READ_SIZE);
+	if (!buf)
 		return TRUE;
 
-	__hexdump('<', buf, bytes_read,
-				device->debug_func, device->debug_data);
-
-	offset = 0;
-
-	while (offset < bytes_read) {
-		uint16_t len;
-
-		/* Check if QMI mux header fits into packet */
-		if (bytes_read - offset < QMI_MUX_HDR_SIZE)
-			break;
-
-		hdr = (void *) (buf + offset);
-
-		/* Check for fixed frame and flags value */
-		if (hdr->frame != 0x01 || hdr->flags != 0x80)
-			break;
+	bytes_read = read(device->fd, buf, QMI_READ_SIZE);
+	if (bytes_read < 0)
+		return TRUE;
 
-		len = GUINT16_FROM_LE(hdr->length) + 1;
+	__hexdump('<', buf, bytes_read, device->debug_func, device->debug_data);
 
-		/* Check that packet size matches frame size */
-		if (bytes_read - offset < len)
-			break;
+	qmux_reader_commit(&device->reader, bytes_read);
 
-		__debug_msg(' ', buf + offset, len,
-				device->debug_func, device->debug_data);
+	/* Callbacks are allowed to drop the last device reference */
+	qmi_device_ref(device);
 
-		handle_packet(device, hdr, buf + offset + QMI_MUX_HDR_SIZE);
+	while ((hdr = qmux_reader_next(&device->reader, &len))) {
+		__debug_msg(' ', hdr, len, device->debug_func,
+						device->debug_data);
 
-		offset += len;
+		handle_packet(device, hdr, len);
 	}
 
+	qmi_device_unref(device);
+
 	return TRUE;
 }
 
@@ -979,8 +1067,10 @@ struct qmi_device *qmi_device_new(int fd)
 	g_io_channel_unref(device->io);
 
 	device->req_queue = g_queue_new();
-	device->control_queue = g_queue_new();
-	device->service_queue = g_queue_new();
+	device->control_pending = g_hash_table_new_full(g_direct_hash,
+					g_direct_equal, NULL, __request_destroy);
+	device->service_pending = g_hash_table_new_full(g_direct_hash,
+					g_direct_equal, NULL, __request_destroy);
 	device->discovery_queue = g_queue_new();
 
 	device->service_list = g_hash_table_new_full(g_direct_hash,
@@ -1012,11 +1102,8 @@ void qmi_device_unref(struct qmi_device *device)
 
 	__debug_device(device, "device %p free", device);
 
-	g_queue_foreach(device->control_queue, __request_free, NULL);
-	g_queue_free(device->control_queue);
-
-	g_queue_foreach(device->service_queue, __request_free, NULL);
-	g_queue_free(device->service_queue);
+	g_hash_table_destroy(device->control_pending);
+	g_hash_table_destroy(device->service_pending);
 
 	g_queue_foreach(device->req_queue, __request_free, NULL);
 	g_queue_free(device->req_queue);
@@ -1040,6 +1127,7 @@ void qmi_device_unref(struct qmi_device *device)
 
 	g_free(device->version_str);
 	g_free(device->version_list);
+	qmux_reader_clear(&device->reader);
 
 	if (device->shutting_down)
 		device->destroyed = true;
@@ -1057,6 +1145,16 @@ void qmi_device_set_debug(struct qmi_device *device,
 	device->debug_data = user_data;
 }
 
+void qmi_device_set_latency(struct qmi_device *device,
+				qmi_latency_func_t func, void *user_data)
+{
+	if (device == NULL)
+		return;
+
+	device->latency_func = func;
+	device->latency_data = user_data;
+}
+
 void qmi_device_set_close_on_unref(struct qmi_device *device, bool do_close)
 {
 	if (!device)
@@ -1082,28 +1180,51 @@ void qmi_result_print_tlvs(struct qmi_result *result)
 }
 
 
-static const void *tlv_get(const void *data, uint16_t size,
-					uint8_t type, uint16_t *length)
+/*
+ * Drivers usually read several TLVs of a result, index all of them in
+ * one pass on first access so that each lookup is a table read.
+ */
+static void result_index_tlvs(struct qmi_result *result)
 {
-	const void *ptr = data;
-	uint16_t len = size;
+	uint16_t offset = 0;
 
-	while (len > QMI_TLV_HDR_SIZE) {
-		const struct qmi_tlv_hdr *tlv = ptr;
+	memset(result->tlv_offset, 0, sizeof(result->tlv_offset));
+	result->indexed = true;
+
+	while (result->length - offset > QMI_TLV_HDR_SIZE) {
+		const struct qmi_tlv_hdr *tlv = result->data + offset;
 		uint16_t tlv_length = GUINT16_FROM_LE(tlv->length);
 
-		if (tlv->type == type) {
-			if (length)
-				*length = tlv_length;
+		if (tlv_length > result->length - offset - QMI_TLV_HDR_SIZE)
+			break;
 
-			return ptr + QMI_TLV_HDR_SIZE;
-		}
+		/* Like tlv_get(), the first occurrence of a type wins */
+		if (!result->tlv_offset[tlv->type])
+			result->tlv_offset[tlv->type] = offset + 1;
 
-		ptr += QMI_TLV_HDR_SIZE + tlv_length;
-		len -= QMI_TLV_HDR_SIZE + tlv_length;
+		offset += QMI_TLV_HDR_SIZE + tlv_length;
 	}
+}
 
-	return NULL;
+static const void *result_tlv_get(struct qmi_result *result, uint8_t type,
+							uint16_t *length)
+{
+	const struct qmi_tlv_hdr *tlv;
+	uint16_t offset;
+
+	if (!result->indexed)
+		result_index_tlvs(result);
+
+	offset = result->tlv_offset[type];
+	if (!offset)
+		return NULL;
+
+	tlv = result->data + offset - 1;
+
+	if (length)
+		*length = GUINT16_FROM_LE(tlv->length);
+
+	return tlv->value;
 }
 
 bool qmi_device_get_service_version(struct qmi_device *device, uint8_t type,
@@ -1263,16 +1384,8 @@ static gboolean discover_reply(gpointer user_data)
 		if (list) {
 			req = list->data;
 			g_queue_delete_link(device->req_queue, list);
-		} else {
-			list = g_queue_find_custom(device->control_queue,
-				GUINT_TO_POINTER(tid), __request_compare);
-
-			if (list) {
-				req = list->data;
-				g_queue_delete_link(device->control_queue,
-								list);
-			}
-		}
+		} else
+			req = __request_steal(device->control_pending, tid);
 	}
 
 	if (data->func)
@@ -1643,7 +1756,7 @@ done:
 	return res;
 }
 
-struct qmi_param *qmi_param_new(void)
+struct qmi_param *qmi_param_new_sized(uint16_t size)
 {
 	struct qmi_param *param;
 
@@ -1651,22 +1764,46 @@ struct qmi_param *qmi_param_new(void)
 	if (!param)
 		return NULL;
 
+	if (size <= sizeof(param->buf)) {
+		param->data = param->buf;
+		param->size = sizeof(param->buf);
+		return param;
+	}
+
+	param->data = g_try_malloc(size);
+	if (!param->data) {
+		g_free(param);
+		return NULL;
+	}
+
+	param->size = size;
+
 	return param;
 }
 
+struct qmi_param *qmi_param_new(void)
+{
+	return qmi_param_new_sized(0);
+}
+
 void qmi_param_free(struct qmi_param *param)
 {
 	if (!param)
 		return;
 
-	g_free(param->data);
+	if (param->data != param->buf)
+		g_free(param->data);
+
 	g_free(param);
 }
 
+#define QMI_PARAM_MIN_SIZE 32
+
 bool qmi_param_append(struct qmi_param *param, uint8_t type,
 					uint16_t length, const void *data)
 {
 	struct qmi_tlv_hdr *tlv;
+	size_t needed;
 	void *ptr;
 
 	if (!param || !type)
@@ -1678,23 +1815,37 @@ bool qmi_param_append(struct qmi_param *param, uint8_t type,
 	if (!data)
 		return false;
 
-	if (param->data)
-		ptr = g_try_realloc(param->data,
-				param->length + QMI_TLV_HDR_SIZE + length);
-	else
-		ptr = g_try_malloc(QMI_TLV_HDR_SIZE + length);
-
-	if (!ptr)
+	needed = param->length + QMI_TLV_HDR_SIZE + length;
+	if (needed > UINT16_MAX)
 		return false;
 
-	tlv = ptr + param->length;
+	/* Grow geometrically, requests commonly carry several TLVs */
+	if (needed > param->size) {
+		size_t size = MAX(needed, param->size * 2);
+
+		size = MAX(size, QMI_PARAM_MIN_SIZE);
+
+		if (param->data == param->buf) {
+			ptr = g_try_malloc(size);
+			if (ptr)
+				memcpy(ptr, param->buf, param->length);
+		} else
+			ptr = g_try_realloc(param->data, size);
+
+		if (!ptr)
+			return false;
+
+		param->data = ptr;
+		param->size = size;
+	}
+
+	tlv = param->data + param->length;
 
 	tlv->type = type;
 	tlv->length = GUINT16_TO_LE(length);
 	memcpy(tlv->value, data, length);
 
-	param->data = ptr;
-	param->length += QMI_TLV_HDR_SIZE + length;
+	param->length = needed;
 
 	return true;
 }
@@ -1729,7 +1880,7 @@ struct qmi_param *qmi_param_new_uint8(uint8_t type, uint8_t value)
 {
 	struct qmi_param *param;
 
-	param = qmi_param_new();
+	param = qmi_param_new_sized(QMI_TLV_HDR_SIZE + 1);
 	if (!param)
 		return NULL;
 
@@ -1745,7 +1896,7 @@ struct qmi_param *qmi_param_new_uint16(uint8_t type, uint16_t value)
 {
 	struct qmi_param *param;
 
-	param = qmi_param_new();
+	param = qmi_param_new_sized(QMI_TLV_HDR_SIZE + 2);
 	if (!param)
 		return NULL;
 
@@ -1761,7 +1912,7 @@ struct qmi_param *qmi_param_new_uint32(uint8_t type, uint32_t value)
 {
 	struct qmi_param *param;
 
-	param = qmi_param_new();
+	param = qmi_param_new_sized(QMI_TLV_HDR_SIZE + 4);
 	if (!param)
 		return NULL;
 
@@ -1807,7 +1958,7 @@ const void *qmi_result_get(struct qmi_result *result, uint8_t type,
 	if (!result || !type)
 		return NULL;
 
-	return tlv_get(result->data, result->length, type, length);
+	return result_tlv_get(result, type, length);
 }
 
 char *qmi_result_get_string(struct qmi_result *result, uint8_t type)
@@ -1818,7 +1969,7 @@ char *qmi_result_get_string(struct qmi_result *result, uint8_t type)
 	if (!result || !type)
 		return NULL;
 
-	ptr = tlv_get(result->data, result->length, type, &len);
+	ptr = result_tlv_get(result, type, &len);
 	if (!ptr)
 		return NULL;
 
@@ -1834,7 +1985,7 @@ bool qmi_result_get_uint8(struct qmi_result *result, uint8_t type,
 	if (!result || !type)
 		return false;
 
-	ptr = tlv_get(result->data, result->length, type, &len);
+	ptr = result_tlv_get(result, type, &len);
 	if (!ptr)
 		return false;
 
@@ -1853,7 +2004,7 @@ bool qmi_result_get_int16(struct qmi_result *result, uint8_t type,
 	if (!result || !type)
 		return false;
 
-	ptr = tlv_get(result->data, result->length, type, &len);
+	ptr = result_tlv_get(result, type, &len);
 	if (!ptr)
 		return false;
 
@@ -1874,7 +2025,7 @@ bool qmi_result_get_uint16(struct qmi_result *result, uint8_t type,
 	if (!result || !type)
 		return false;
 
-	ptr = tlv_get(result->data, result->length, type, &len);
+	ptr = result_tlv_get(result, type, &len);
 	if (!ptr)
 		return false;
 
@@ -1896,7 +2047,7 @@ bool qmi_result_get_uint32(struct qmi_result *result, uint8_t type,
 	if (!result || !type)
 		return false;
 
-	ptr = tlv_get(result->data, result->length, type, &len);
+	ptr = result_tlv_get(result, type, &len);
 	if (!ptr)
 		return false;
 
@@ -1918,7 +2069,7 @@ bool qmi_result_get_uint64(struct qmi_result *result, uint8_t type,
 	if (!result || !type)
 		return false;
 
-	ptr = tlv_get(result->data, result->length, type, &len);
+	ptr = result_tlv_get(result, type, &len);
 	if (!ptr)
 		return false;
 
@@ -2255,6 +2406,7 @@ static void service_send_callback(uint16_t message, uint16_t length,
 	result.message = message;
 	result.data = buffer;
 	result.length = length;
+	result.indexed = false;
 
 	result_code = tlv_get(buffer, length, 0x02, &len);
 	if (!result_code)
@@ -2338,14 +2490,9 @@ bool qmi_service_cancel(struct qmi_service *service, uint16_t id)
 
 		g_queue_delete_link(device->req_queue, list);
 	} else {
-		list = g_queue_find_custom(device->service_queue,
-				GUINT_TO_POINTER(tid), __request_compare);
-		if (!list)
+		req = __request_steal(device->service_pending, tid);
+		if (!req)
 			return false;
-
-		req = list->data;
-
-		g_queue_delete_link(device->service_queue, list);
 	}
 
 	service_send_free(req->user_data);
@@ -2386,6 +2533,20 @@ static GQueue *remove_client(GQueue *queue, uint8_t client)
 	return new_queue;
 }
 
+static gboolean remove_pending_client(gpointer key, gpointer value,
+							gpointer user_data)
+{
+	struct qmi_request *req = value;
+	uint8_t client = GPOINTER_TO_UINT(user_data);
+
+	if (!req->client || req->client != client)
+		return FALSE;
+
+	service_send_free(req->user_data);
+
+	return TRUE;
+}
+
 bool qmi_service_cancel_all(struct qmi_service *service)
 {
 	struct qmi_device *device;
@@ -2403,8 +2564,9 @@ bool qmi_service_cancel_all(struct qmi_service *service)
 	device->req_queue = remove_client(device->req_queue,
 						service->client_id);
 
-	device->service_queue = remove_client(device->service_queue,
-							service->client_id);
+	g_hash_table_foreach_remove(device->service_pending,
+					remove_pending_client,
+					GUINT_TO_POINTER(service->client_id));
 
 	return true;
 }
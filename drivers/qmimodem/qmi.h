@@ -69,6 +69,9 @@ typedef void (*qmi_destroy_func_t)(void *user_data);
 struct qmi_device;
 
 typedef void (*qmi_debug_func_t)(const char *str, void *user_data);
+typedef void (*qmi_latency_func_t)(const char *service, uint16_t message,
+					unsigned int usec, bool ok,
+					void *user_data);
 typedef void (*qmi_sync_func_t)(void *user_data);
 typedef void (*qmi_shutdown_func_t)(void *user_data);
 typedef void (*qmi_discover_func_t)(void *user_data);
@@ -80,6 +83,8 @@ void qmi_device_unref(struct qmi_device *device);
 
 void qmi_device_set_debug(struct qmi_device *device,
 				qmi_debug_func_t func, void *user_data);
+void qmi_device_set_latency(struct qmi_device *device,
+				qmi_latency_func_t func, void *user_data);
 
 void qmi_device_set_close_on_unref(struct qmi_device *device, bool do_close);
 
@@ -104,6 +109,7 @@ bool qmi_device_set_expected_data_format(struct qmi_device *device,
 struct qmi_param;
 
 struct qmi_param *qmi_param_new(void);
+struct qmi_param *qmi_param_new_sized(uint16_t size);
 void qmi_param_free(struct qmi_param *param);
 
 bool qmi_param_append(struct qmi_param *param, uint8_t type,
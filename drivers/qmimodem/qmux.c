@@ -0,0 +1,129 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "qmux.h"
+
+#define QMUX_READER_MIN_SIZE 4096
+
+void qmux_reader_init(struct qmux_reader *reader)
+{
+	memset(reader, 0, sizeof(*reader));
+}
+
+void qmux_reader_clear(struct qmux_reader *reader)
+{
+	free(reader->buf);
+	qmux_reader_init(reader);
+}
+
+/* Returns where to put at least @needed more bytes, NULL on failure */
+uint8_t *qmux_reader_reserve(struct qmux_reader *reader, size_t needed)
+{
+	size_t size = reader->size ? reader->size : QMUX_READER_MIN_SIZE;
+	uint8_t *buf;
+
+	if (reader->size - reader->len >= needed)
+		return reader->buf + reader->len;
+
+	while (size - reader->len < needed)
+		size *= 2;
+
+	buf = realloc(reader->buf, size);
+	if (!buf)
+		return NULL;
+
+	reader->buf = buf;
+	reader->size = size;
+
+	return reader->buf + reader->len;
+}
+
+void qmux_reader_commit(struct qmux_reader *reader, size_t len)
+{
+	reader->len += len;
+}
+
+/* Drops the consumed frames, keeping a partial one for the next read */
+static void qmux_reader_compact(struct qmux_reader *reader)
+{
+	reader->len -= reader->offset;
+
+	if (reader->len > 0 && reader->offset > 0)
+		memmove(reader->buf, reader->buf + reader->offset,
+							reader->len);
+
+	reader->offset = 0;
+}
+
+/*
+ * Returns the next complete frame and its length including the frame
+ * byte, or NULL once no complete frame is left.  The frame stays valid
+ * until the next call.  Anything that does not start with a valid QMUX
+ * header is dropped, together with the rest of the buffered data.
+ */
+const struct qmi_mux_hdr *qmux_reader_next(struct qmux_reader *reader,
+						size_t *out_len)
+{
+	const uint8_t *p = reader->buf + reader->offset;
+	size_t avail = reader->len - reader->offset;
+	size_t len;
+
+	/* Wait for the rest of the QMI mux header */
+	if (avail < QMI_MUX_HDR_SIZE)
+		goto done;
+
+	/* Check for fixed frame and flags value, resync otherwise */
+	if (p[0] != 0x01 || p[3] != 0x80)
+		goto resync;
+
+	len = (p[1] | (p[2] << 8)) + 1;
+
+	/* The length has to cover at least the mux header */
+	if (len < QMI_MUX_HDR_SIZE)
+		goto resync;
+
+	/* Wait for the rest of the frame */
+	if (avail < len) {
+		if (!qmux_reader_reserve(reader, len - avail))
+			goto resync;
+
+		goto done;
+	}
+
+	reader->offset += len;
+
+	if (out_len)
+		*out_len = len;
+
+	return (const struct qmi_mux_hdr *) p;
+
+resync:
+	reader->offset = reader->len;
+done:
+	qmux_reader_compact(reader);
+
+	return NULL;
+}
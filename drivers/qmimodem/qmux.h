@@ -0,0 +1,52 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct qmi_mux_hdr {
+	uint8_t  frame;		/* Always 0x01 */
+	uint16_t length;	/* Packet size without frame byte */
+	uint8_t  flags;		/* Either 0x00 or 0x80 */
+	uint8_t  service;	/* Service type (0x00 for control) */
+	uint8_t  client;	/* Client identifier (0x00 for control) */
+} __attribute__ ((packed));
+#define QMI_MUX_HDR_SIZE 6
+
+/*
+ * Reassembles QMUX frames from the byte stream read off the device.
+ * Several frames may arrive in one read, and a single frame may span
+ * several reads, in which case the partial frame is kept until the
+ * remainder arrives.
+ */
+struct qmux_reader {
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	size_t offset;
+};
+
+void qmux_reader_init(struct qmux_reader *reader);
+void qmux_reader_clear(struct qmux_reader *reader);
+
+uint8_t *qmux_reader_reserve(struct qmux_reader *reader, size_t needed);
+void qmux_reader_commit(struct qmux_reader *reader, size_t len);
+
+const struct qmi_mux_hdr *qmux_reader_next(struct qmux_reader *reader,
+						size_t *out_len);
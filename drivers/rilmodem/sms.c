@@ -364,6 +364,7 @@ static void ril_cmgs(struct ofono_sms *sms, const unsigned char *pdu,
 	 *  parcel_w_string() encodes utf8 -> utf16
 	 */
 	encode_hex_own_buf(pdu + smsc_len, tpdu_len, 0, hexbuf);
+	parcel_reserve(&rilp, parcel_string_size(hexbuf));
 	parcel_w_string(&rilp, hexbuf);
 
 	g_ril_append_print_buf(sd->ril, "(%s)", hexbuf);
@@ -409,15 +410,16 @@ static void ril_sms_notify(struct ril_msg *message, gpointer user_data)
 	unsigned int smsc_len;
 	long ril_buf_len;
 	struct parcel rilp;
-	char *ril_pdu;
+	const char *ril_pdu;
 	size_t ril_pdu_len;
 	unsigned char pdu[176];
+	char hexbuf[sizeof(pdu) * 2 + 1];
 
 	DBG("req: %d; data_len: %d", message->req, (int) message->buf_len);
 
 	g_ril_init_parcel(message, &rilp);
 
-	ril_pdu = parcel_r_string(&rilp);
+	ril_pdu = parcel_r_string_buf(&rilp, hexbuf, sizeof(hexbuf));
 	if (ril_pdu == NULL)
 		return;
 
@@ -427,11 +429,11 @@ static void ril_sms_notify(struct ril_msg *message, gpointer user_data)
 	ril_pdu_len = strlen(ril_pdu);
 
 	if (ril_pdu_len > sizeof(pdu) * 2)
-		goto fail;
+		return;
 
 	if (decode_hex_own_buf(ril_pdu, ril_pdu_len,
 					&ril_buf_len, -1, pdu) == NULL)
-		goto fail;
+		return;
 
 	/*
 	 * The first octect in the pdu contains the SMSC address length
@@ -452,9 +454,6 @@ static void ril_sms_notify(struct ril_msg *message, gpointer user_data)
 
 	/* ACK the incoming NEW_SMS */
 	ril_ack_delivery(sms);
-
-fail:
-	g_free(ril_pdu);
 }
 
 static gboolean ril_delayed_register(gpointer user_data)
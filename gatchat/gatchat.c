@@ -56,6 +56,7 @@ struct at_command {
 	GAtNotifyFunc listing;
 	gpointer user_data;
 	GDestroyNotify notify;
+	gint64 start;				/* When writing began */
 };
 
 struct at_notify_node {
@@ -90,6 +91,8 @@ struct at_chat {
 	gboolean suspended;			/* Are we suspended? */
 	GAtDebugFunc debugf;			/* debugging output function */
 	gpointer debug_data;			/* Data to pass to debug func */
+	GAtLatencyFunc latencyf;		/* command latency function */
+	gpointer latency_data;			/* Data to pass to latency func */
 	char *pdu_notify;			/* Unsolicited Resp w/ PDU */
 	GSList *response_lines;			/* char * lines of the response */
 	char *wakeup;				/* command sent to wakeup modem */
@@ -448,6 +451,10 @@ static void at_chat_finish_command(struct at_chat *p, gboolean ok, char *final)
 	response_lines = p->response_lines;
 	p->response_lines = NULL;
 
+	if (p->latencyf && cmd->start)
+		p->latencyf(cmd->cmd, ok, g_get_monotonic_time() - cmd->start,
+							p->latency_data);
+
 	if (cmd->callback) {
 		GAtResult result;
 
@@ -904,6 +911,9 @@ static gboolean can_write_data(gpointer data)
 	if (bytes_written == 0)
 		return FALSE;
 
+	if (chat->cmd_bytes_written == 0)
+		cmd->start = g_get_monotonic_time();
+
 	chat->cmd_bytes_written += bytes_written;
 
 	if (bytes_written < towrite)
@@ -1468,6 +1478,18 @@ gboolean g_at_chat_set_debug(GAtChat *chat,
 	return at_chat_set_debug(chat->parent, func, user_data);
 }
 
+gboolean g_at_chat_set_latency(GAtChat *chat,
+				GAtLatencyFunc func, gpointer user_data)
+{
+	if (chat == NULL || chat->group != 0)
+		return FALSE;
+
+	chat->parent->latencyf = func;
+	chat->parent->latency_data = user_data;
+
+	return TRUE;
+}
+
 void g_at_chat_add_terminator(GAtChat *chat, char *terminator,
 					int len, gboolean success)
 {
@@ -38,6 +38,8 @@ typedef struct _GAtChat GAtChat;
 typedef void (*GAtResultFunc)(gboolean success, GAtResult *result,
 				gpointer user_data);
 typedef void (*GAtNotifyFunc)(GAtResult *result, gpointer user_data);
+typedef void (*GAtLatencyFunc)(const char *cmd, gboolean ok, guint usec,
+							gpointer user_data);
 
 enum _GAtChatTerminator {
 	G_AT_CHAT_TERMINATOR_OK,
@@ -82,6 +84,13 @@ gboolean g_at_chat_set_disconnect_function(GAtChat *chat,
 gboolean g_at_chat_set_debug(GAtChat *chat,
 				GAtDebugFunc func, gpointer user_data);
 
+/*!
+ * If the function is not NULL, then it is called for every completed
+ * command with the time from the first byte written to the final response
+ */
+gboolean g_at_chat_set_latency(GAtChat *chat,
+				GAtLatencyFunc func, gpointer user_data);
+
 /*!
  * Queue an AT command for execution.  The command contents are given
  * in cmd.  Once the command executes, the callback function given by
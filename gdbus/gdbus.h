@@ -45,6 +45,9 @@ typedef struct GDBusSecurityTable GDBusSecurityTable;
 typedef void (* GDBusWatchFunction) (DBusConnection *connection,
 							void *user_data);
 
+typedef void (* GDBusFlushFunction) (DBusConnection *connection,
+					const char *path, const char *interface);
+
 typedef void (* GDBusMessageFunction) (DBusConnection *connection,
 					 DBusMessage *message, void *user_data);
 
@@ -218,6 +221,8 @@ struct GDBusSecurityTable {
 void g_dbus_set_flags(int flags);
 int g_dbus_get_flags(void);
 
+void g_dbus_set_flush_function(GDBusFlushFunction function);
+
 gboolean g_dbus_register_interface(DBusConnection *connection,
 					const char *path, const char *name,
 					const GDBusMethodTable *methods,
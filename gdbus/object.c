@@ -85,6 +85,7 @@ struct property_data {
 };
 
 static int global_flags = 0;
+static GDBusFlushFunction flush_function = NULL;
 static struct generic_data *root;
 static GSList *pending = NULL;
 
@@ -1379,6 +1380,10 @@ gboolean g_dbus_unregister_interface(DBusConnection *connection,
 	if (data == NULL)
 		return FALSE;
 
+	/* Nothing held back may be sent after the interface is gone */
+	if (flush_function != NULL)
+		flush_function(connection, path, name);
+
 	if (remove_interface(data, name) == FALSE)
 		return FALSE;
 
@@ -1466,10 +1471,14 @@ DBusMessage *g_dbus_create_reply(DBusMessage *message, int type, ...)
 	return reply;
 }
 
-static void g_dbus_flush(DBusConnection *connection)
+static void g_dbus_flush(DBusConnection *connection, const char *path)
 {
 	GSList *l;
 
+	/* Let the user send whatever it holds back for the path first */
+	if (flush_function != NULL)
+		flush_function(connection, path, NULL);
+
 	for (l = pending; l;) {
 		struct generic_data *data = l->data;
 
@@ -1483,22 +1492,24 @@ static void g_dbus_flush(DBusConnection *connection)
 
 gboolean g_dbus_send_message(DBusConnection *connection, DBusMessage *message)
 {
+	const char *path = NULL;
 	dbus_bool_t result = FALSE;
 
 	if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL)
 		dbus_message_set_no_reply(message, TRUE);
 	else if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_SIGNAL) {
-		const char *path = dbus_message_get_path(message);
 		const char *interface = dbus_message_get_interface(message);
 		const char *name = dbus_message_get_member(message);
 		const GDBusArgInfo *args;
 
+		path = dbus_message_get_path(message);
+
 		if (!check_signal(connection, path, interface, name, &args))
 			goto out;
 	}
 
 	/* Flush pending signal to guarantee message order */
-	g_dbus_flush(connection);
+	g_dbus_flush(connection, path);
 
 	result = dbus_connection_send(connection, message, NULL);
 
@@ -1515,7 +1526,7 @@ gboolean g_dbus_send_message_with_reply(DBusConnection *connection,
 	dbus_bool_t ret;
 
 	/* Flush pending signal to guarantee message order */
-	g_dbus_flush(connection);
+	g_dbus_flush(connection, NULL);
 
 	ret = dbus_connection_send_with_reply(connection, message, call,
 								timeout);
@@ -1821,3 +1832,8 @@ int g_dbus_get_flags(void)
 {
 	return global_flags;
 }
+
+void g_dbus_set_flush_function(GDBusFlushFunction function)
+{
+	flush_function = function;
+}
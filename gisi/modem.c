@@ -23,6 +23,7 @@
 #include <config.h>
 #endif
 
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
@@ -40,6 +41,9 @@
 #include "modem.h"
 #include "socket.h"
 
+/* Upper bound on requests handed to a single sendmmsg() call */
+#define TX_BATCH_MAX	16
+
 #define ISIDBG(m, fmt, ...)				\
 	if ((m) != NULL && (m)->debug != NULL)		\
 		m->debug("gisi: "fmt, ##__VA_ARGS__);
@@ -47,6 +51,7 @@
 struct _GIsiServiceMux {
 	GIsiModem *modem;
 	GSList *pending;
+	GIsiPending *resp[256];		/* Outstanding RESPs indexed by UTID */
 	GIsiVersion version;
 	uint8_t resource;
 	uint8_t last_utid;
@@ -71,6 +76,17 @@ struct _GIsiModem {
 	GIsiNotifyFunc trace;
 	void *opaque;
 	unsigned long flags;
+	GQueue tx_queue;
+	guint tx_source;
+	gboolean *tx_destroyed;		/* Set while failures are reported */
+};
+
+struct isi_tx {
+	GIsiPending *op;
+	struct sockaddr_pn dst;
+	int err;
+	size_t len;
+	uint8_t data[];
 };
 
 struct _GIsiPending {
@@ -81,6 +97,7 @@ struct _GIsiPending {
 	GIsiNotifyFunc notify;
 	GDestroyNotify destroy;
 	void *data;
+	struct isi_tx *tx;
 	uint8_t utid;
 	uint8_t msgid;
 };
@@ -110,12 +127,53 @@ static GIsiServiceMux *service_get(GIsiModem *modem, uint8_t resource)
 	return mux;
 }
 
-static gint utid_equal(gconstpointer a, gconstpointer b)
+static gboolean service_utid_busy(GIsiServiceMux *mux, uint8_t utid)
 {
-	const GIsiPending *pa = a;
-	const GIsiPending *pb = b;
+	GSList *l;
+
+	if (mux->resp[utid] != NULL)
+		return TRUE;
+
+	/*
+	 * Besides RESPs, only version queries carry a UTID, and those
+	 * are only on the pending list while a query is outstanding.
+	 */
+	if (!mux->version_pending)
+		return FALSE;
+
+	for (l = mux->pending; l != NULL; l = l->next) {
+		GIsiPending *pend = l->data;
+
+		if (pend->type == GISI_MESSAGE_TYPE_COMMON &&
+				pend->utid == utid)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void pending_unlink(GIsiPending *op)
+{
+	GIsiServiceMux *mux = op->service;
+
+	if (op->type != GISI_MESSAGE_TYPE_RESP) {
+		mux->pending = g_slist_remove(mux->pending, op);
+		return;
+	}
+
+	if (mux->resp[op->utid] == op)
+		mux->resp[op->utid] = NULL;
+
+	if (op->tx == NULL)
+		return;
 
-	return pa->utid - pb->utid;
+	/* Never hand a cancelled request to the modem */
+	if (g_queue_remove(&mux->modem->tx_queue, op->tx))
+		g_free(op->tx);
+	else
+		op->tx->op = NULL;	/* Failed, not yet reported */
+
+	op->tx = NULL;
 }
 
 static const char *pend_type_to_str(enum GIsiMessageType type)
@@ -156,7 +214,7 @@ static void pending_remove_and_dispatch(GIsiPending *op, GIsiMessage *msg)
 {
 	GIsiModem *modem;
 
-	op->service->pending = g_slist_remove(op->service->pending, op);
+	pending_unlink(op);
 
 	if (op->notify == NULL || msg == NULL)
 		goto destroy;
@@ -186,8 +244,25 @@ static void service_dispatch(GIsiServiceMux *mux, GIsiMessage *msg,
 {
 	uint8_t msgid = g_isi_msg_id(msg);
 	uint8_t utid = g_isi_msg_utid(msg);
+	gboolean resp_done = FALSE;
+	GSList *l;
 
-	GSList *l = mux->pending;
+	/*
+	 * RESPs are dispatched on unique transaction ID, explicitly
+	 * ignoring the msgid.  A RESP also completes a transaction,
+	 * so it needs to be removed after being notified of.  Only
+	 * version queries may still be interested in the message.
+	 */
+	if (!is_indication && mux->resp[utid] != NULL) {
+		pending_remove_and_dispatch(mux->resp[utid], msg);
+
+		if (msgid != COMMON_MESSAGE)
+			return;
+
+		resp_done = TRUE;
+	}
+
+	l = mux->pending;
 
 	while (l != NULL) {
 		GSList *next = l->next;
@@ -199,26 +274,16 @@ static void service_dispatch(GIsiServiceMux *mux, GIsiMessage *msg,
 		 * typically mirror the UTID of the request that set up the
 		 * session, and REQs can naturally have any transaction ID.
 		 *
-		 * RESPs are dispatched on unique transaction ID, explicitly
-		 * ignoring the msgid.  A RESP also completes a transaction,
-		 * so it needs to be removed after being notified of.
-		 *
 		 * Version query responses are dispatched in a similar fashion
 		 * as RESPs, but based on the pending type and the message ID.
 		 * Some of these may be synthesized, but nevertheless need to
 		 * be removed.
 		 */
-		if (pend->type < GISI_MESSAGE_TYPE_RESP
+		if (pend->type < GISI_MESSAGE_TYPE_RESP && !resp_done
 				&& pend->msgid == msgid) {
 
 			pending_dispatch(pend, msg);
 
-		} else if (pend->type == GISI_MESSAGE_TYPE_RESP &&
-				!is_indication && pend->utid == utid) {
-
-			pending_remove_and_dispatch(pend, msg);
-			break;
-
 		} else if (pend->type == GISI_MESSAGE_TYPE_COMMON &&
 				msgid == COMMON_MESSAGE &&
 				pend->msgid == COMM_ISI_VERSION_GET_REQ) {
@@ -460,6 +525,7 @@ static void service_finalize(gpointer value)
 {
 	GIsiServiceMux *mux = value;
 	GIsiModem *modem = mux->modem;
+	unsigned i;
 
 	if (mux->subscriptions > 0)
 		modem_subs_update_when_idle(modem);
@@ -469,6 +535,17 @@ static void service_finalize(gpointer value)
 
 	g_slist_foreach(mux->pending, pending_destroy, NULL);
 	g_slist_free(mux->pending);
+
+	for (i = 0; i < G_N_ELEMENTS(mux->resp); i++) {
+		GIsiPending *op = mux->resp[i];
+
+		if (op == NULL)
+			continue;
+
+		pending_unlink(op);
+		pending_destroy(op, NULL);
+	}
+
 	g_free(mux);
 }
 
@@ -512,6 +589,7 @@ GIsiModem *g_isi_modem_create(unsigned index)
 	modem->index = index;
 	modem->services = g_hash_table_new_full(g_direct_hash, NULL,
 						NULL, service_finalize);
+	g_queue_init(&modem->tx_queue);
 
 	return modem;
 }
@@ -643,6 +721,13 @@ void g_isi_modem_destroy(GIsiModem *modem)
 
 	g_hash_table_unref(modem->services);
 
+	/* Queued requests went away with their pending operations */
+	if (modem->tx_source > 0)
+		g_source_remove(modem->tx_source);
+
+	if (modem->tx_destroyed != NULL)
+		*modem->tx_destroyed = TRUE;
+
 	if (modem->ind_watch > 0)
 		g_source_remove(modem->ind_watch);
 
@@ -737,6 +822,134 @@ static gboolean resp_timeout(gpointer data)
 	return FALSE;
 }
 
+static void tx_fail(GIsiModem *modem, struct isi_tx *tx)
+{
+	GIsiPending *op = tx->op;
+	GIsiMessage msg = {
+		.error = tx->err,
+	};
+
+	/* Cancelled after the send failed */
+	if (op == NULL)
+		return;
+
+	op->tx = NULL;
+
+	ISIDBG(modem, "Batched send failed: %s [res=0x%02X, utid=0x%02X]",
+		strerror(tx->err), tx->dst.spn_resource, op->utid);
+
+	pending_remove_and_dispatch(op, &msg);
+}
+
+static gboolean modem_tx_flush(gpointer data)
+{
+	GIsiModem *modem = data;
+	struct mmsghdr mmsg[TX_BATCH_MAX];
+	struct iovec iov[TX_BATCH_MAX];
+	struct isi_tx *tx[TX_BATCH_MAX];
+	GQueue failed = G_QUEUE_INIT;
+	gboolean destroyed = FALSE;
+	struct isi_tx *f;
+	GList *l;
+	int i, n, ret;
+
+	modem->tx_source = 0;
+
+	while (!g_queue_is_empty(&modem->tx_queue)) {
+		memset(mmsg, 0, sizeof(mmsg));
+
+		for (l = modem->tx_queue.head, n = 0;
+				l != NULL && n < TX_BATCH_MAX;
+				l = l->next, n++) {
+			tx[n] = l->data;
+
+			iov[n].iov_base = tx[n]->data;
+			iov[n].iov_len = tx[n]->len;
+
+			mmsg[n].msg_hdr.msg_name = &tx[n]->dst;
+			mmsg[n].msg_hdr.msg_namelen = sizeof(tx[n]->dst);
+			mmsg[n].msg_hdr.msg_iov = &iov[n];
+			mmsg[n].msg_hdr.msg_iovlen = 1;
+		}
+
+		ret = sendmmsg(modem->req_fd, mmsg, n, MSG_NOSIGNAL);
+		if (ret <= 0) {
+			/* The first datagram failed, report it and go on */
+			ret = ret < 0 ? errno : EIO;
+			n = 1;
+		} else {
+			n = ret;
+			ret = 0;
+		}
+
+		for (i = 0; i < n; i++) {
+			g_queue_pop_head(&modem->tx_queue);
+
+			tx[i]->err = ret;
+
+			if (ret == 0 && mmsg[i].msg_len != tx[i]->len)
+				tx[i]->err = EMSGSIZE;
+
+			if (tx[i]->err == 0) {
+				tx[i]->op->tx = NULL;
+				g_free(tx[i]);
+				continue;
+			}
+
+			g_queue_push_tail(&failed, tx[i]);
+		}
+	}
+
+	/*
+	 * Only report failures once the queue is drained, the callbacks
+	 * are free to cancel or send requests, or to destroy the modem.
+	 */
+	modem->tx_destroyed = &destroyed;
+
+	while ((f = g_queue_pop_head(&failed)) != NULL) {
+		if (!destroyed)
+			tx_fail(modem, f);
+
+		g_free(f);
+	}
+
+	if (!destroyed)
+		modem->tx_destroyed = NULL;
+
+	return FALSE;
+}
+
+static int modem_tx_queue(GIsiModem *modem, struct sockaddr_pn *dst,
+				const struct iovec *iov, size_t iovlen,
+				size_t len, GIsiPending *op)
+{
+	struct isi_tx *tx;
+	uint8_t *ptr;
+	size_t i;
+
+	tx = g_try_malloc(sizeof(*tx) + len);
+	if (tx == NULL)
+		return -ENOMEM;
+
+	tx->op = op;
+	tx->dst = *dst;
+	tx->err = 0;
+	tx->len = len;
+
+	for (i = 0, ptr = tx->data; i < iovlen; i++) {
+		memcpy(ptr, iov[i].iov_base, iov[i].iov_len);
+		ptr += iov[i].iov_len;
+	}
+
+	op->tx = tx;
+	g_queue_push_tail(&modem->tx_queue, tx);
+
+	if (modem->tx_source == 0)
+		modem->tx_source = g_idle_add(modem_tx_flush, modem);
+
+	return 0;
+}
+
 GIsiPending *g_isi_request_vsendto(GIsiModem *modem, struct sockaddr_pn *dst,
 					const struct iovec *__restrict iov,
 					size_t iovlen, unsigned timeout,
@@ -783,7 +996,7 @@ GIsiPending *g_isi_request_vsendto(GIsiModem *modem, struct sockaddr_pn *dst,
 	resp->destroy = destroy;
 	resp->data = data;
 
-	if (g_slist_find_custom(mux->pending, resp, utid_equal)) {
+	if (service_utid_busy(mux, resp->utid)) {
 		/*
 		 * FIXME: perhaps retry with randomized access after
 		 * initial miss. Although if the rate at which
@@ -807,6 +1020,16 @@ GIsiPending *g_isi_request_vsendto(GIsiModem *modem, struct sockaddr_pn *dst,
 	if (modem->trace != NULL)
 		vtrace(dst, _iov, 1 + iovlen, len, modem->trace);
 
+	if (modem->flags & GISI_MODEM_FLAG_BATCH_SEND) {
+		if (modem_tx_queue(modem, dst, _iov, 1 + iovlen, len,
+					resp) < 0) {
+			errno = ENOMEM;
+			goto error;
+		}
+
+		goto done;
+	}
+
 	ret = sendmsg(modem->req_fd, &msg, MSG_NOSIGNAL);
 	if (ret == -1)
 		goto error;
@@ -816,7 +1039,8 @@ GIsiPending *g_isi_request_vsendto(GIsiModem *modem, struct sockaddr_pn *dst,
 		goto error;
 	}
 
-	mux->pending = g_slist_prepend(mux->pending, resp);
+done:
+	mux->resp[resp->utid] = resp;
 
 	if (timeout > 0)
 		resp->timeout = g_timeout_add_seconds(timeout, resp_timeout,
@@ -855,7 +1079,7 @@ void g_isi_pending_remove(GIsiPending *op)
 		return;
 	}
 
-	op->service->pending = g_slist_remove(op->service->pending, op);
+	pending_unlink(op);
 
 	pending_destroy(op, NULL);
 }
@@ -895,11 +1119,22 @@ void g_isi_remove_pending_by_owner(GIsiModem *modem, uint8_t resource,
 	GSList *next;
 	GIsiPending *op;
 	GSList *owned = NULL;
+	unsigned i;
 
 	mux = service_get(modem, resource);
 	if (mux == NULL)
 		return;
 
+	for (i = 0; i < G_N_ELEMENTS(mux->resp); i++) {
+		op = mux->resp[i];
+
+		if (op == NULL || op->owner != owner)
+			continue;
+
+		pending_unlink(op);
+		owned = g_slist_prepend(owned, op);
+	}
+
 	for (l = mux->pending; l != NULL; l = next) {
 		next = l->next;
 		op = l->data;
@@ -1166,7 +1401,7 @@ static int version_get_send(GIsiModem *modem, GIsiPending *ping)
 	};
 	ssize_t ret;
 
-	if (g_slist_find_custom(mux->pending, ping, utid_equal))
+	if (service_utid_busy(mux, ping->utid))
 		return -EBUSY;
 
 	ret = sendto(modem->req_fd, msg, sizeof(msg), MSG_NOSIGNAL,
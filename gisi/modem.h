@@ -33,6 +33,8 @@ extern "C" {
 
 enum GIsiModemFlags {
 	GISI_MODEM_FLAG_USE_LEGACY_SUBSCRIBE = 1,
+	/* Defer requests to the main loop and send them with sendmmsg */
+	GISI_MODEM_FLAG_BATCH_SEND = 2,
 };
 
 struct _GIsiModem;
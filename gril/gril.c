@@ -42,6 +42,7 @@
 #include "ringbuffer.h"
 #include "gril.h"
 #include "grilutil.h"
+#include "griltrace.h"
 
 #define RIL_TRACE(ril, fmt, arg...) do {	\
 	if (ril->trace == TRUE)			\
@@ -57,6 +58,7 @@ struct ril_request {
 	GRilResponseFunc callback;
 	gpointer user_data;
 	GDestroyNotify notify;
+	gint64 start;
 };
 
 struct ril_notify_node {
@@ -74,6 +76,18 @@ struct ril_notify {
 	GSList *nodes;
 };
 
+/*
+ * Binary trace of the raw messages exchanged with rild.  Records are kept
+ * back to back in a byte ring, the oldest ones are dropped to make room.
+ */
+struct ril_trace_ring {
+	guint8 *buf;
+	gsize size;
+	gsize start;				/* Offset of oldest record */
+	gsize used;
+	char *path;				/* Where to dump the ring */
+};
+
 struct ril_s {
 	gint ref_count;				/* Ref count */
 	gint next_cmd_id;			/* Next command id */
@@ -81,6 +95,7 @@ struct ril_s {
 	guint next_gid;				/* Next group id */
 	GRilIO *io;				/* GRil IO */
 	GQueue *command_queue;			/* Command queue */
+	GHashTable *pending;			/* Requests by serial number */
 	GQueue *out_queue;			/* Commands sent/been sent */
 	guint req_bytes_written;		/* bytes written from req */
 	GHashTable *notify_list;		/* List of notification reg */
@@ -98,6 +113,9 @@ struct ril_s {
 	int slot;
 	GRilMsgIdToStrFunc req_to_string;
 	GRilMsgIdToStrFunc unsol_to_string;
+	struct ril_trace_ring *trace_ring;
+	GRilLatencyFunc latencyf;
+	gpointer latency_data;
 };
 
 struct _GRil {
@@ -118,6 +136,119 @@ char print_buf[RIL_PRINT_BUF_SIZE] __attribute__((used));
 
 static void ril_wakeup_writer(struct ril_s *ril);
 
+static void trace_ring_copy_in(struct ril_trace_ring *ring, gsize pos,
+				const void *data, gsize len)
+{
+	gsize chunk;
+
+	pos %= ring->size;
+	chunk = MIN(len, ring->size - pos);
+
+	memcpy(ring->buf + pos, data, chunk);
+	memcpy(ring->buf, (const guint8 *) data + chunk, len - chunk);
+}
+
+static void trace_ring_copy_out(struct ril_trace_ring *ring, gsize pos,
+				void *data, gsize len)
+{
+	gsize chunk;
+
+	pos %= ring->size;
+	chunk = MIN(len, ring->size - pos);
+
+	memcpy(data, ring->buf + pos, chunk);
+	memcpy((guint8 *) data + chunk, ring->buf, len - chunk);
+}
+
+static void ril_trace_record(struct ril_s *ril, enum ril_trace_dir dir,
+				const void *data, gsize len)
+{
+	struct ril_trace_ring *ring = ril->trace_ring;
+	struct ril_trace_rec_hdr hdr;
+	gsize need;
+
+	if (ring == NULL)
+		return;
+
+	hdr.timestamp = g_get_real_time();
+	hdr.len = len;
+	hdr.caplen = MIN(len, RIL_TRACE_MAX_CAPLEN);
+	hdr.dir = dir;
+	hdr.reserved = 0;
+
+	need = sizeof(hdr) + hdr.caplen;
+	if (need > ring->size)
+		return;
+
+	while (ring->size - ring->used < need) {
+		struct ril_trace_rec_hdr old;
+		gsize old_len;
+
+		trace_ring_copy_out(ring, ring->start, &old, sizeof(old));
+		old_len = sizeof(old) + old.caplen;
+
+		ring->start = (ring->start + old_len) % ring->size;
+		ring->used -= old_len;
+	}
+
+	trace_ring_copy_in(ring, ring->start + ring->used, &hdr, sizeof(hdr));
+	trace_ring_copy_in(ring, ring->start + ring->used + sizeof(hdr),
+				data, hdr.caplen);
+	ring->used += need;
+}
+
+static gboolean ril_trace_dump(struct ril_s *ril)
+{
+	struct ril_trace_ring *ring = ril->trace_ring;
+	struct ril_trace_file_hdr hdr;
+	gsize chunk;
+	FILE *fp;
+	gboolean ok;
+
+	if (ring == NULL || ring->path == NULL)
+		return FALSE;
+
+	fp = fopen(ring->path, "w");
+	if (fp == NULL) {
+		ofono_error("Can't open RIL trace dump %s: %s (%d)",
+				ring->path, strerror(errno), errno);
+		return FALSE;
+	}
+
+	hdr.magic = RIL_TRACE_MAGIC;
+	hdr.version = RIL_TRACE_VERSION;
+	hdr.slot = ril->slot;
+
+	chunk = MIN(ring->used, ring->size - ring->start);
+
+	ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+		fwrite(ring->buf + ring->start, 1, chunk, fp) == chunk &&
+		fwrite(ring->buf, 1, ring->used - chunk, fp) ==
+							ring->used - chunk;
+
+	if (fclose(fp) != 0)
+		ok = FALSE;
+
+	if (!ok)
+		ofono_error("Failed to write RIL trace dump %s", ring->path);
+
+	return ok;
+}
+
+static void ril_trace_free(struct ril_s *ril)
+{
+	struct ril_trace_ring *ring = ril->trace_ring;
+
+	if (ring == NULL)
+		return;
+
+	ril->trace_ring = NULL;
+
+	g_free(ring->path);
+	g_free(ring->buf);
+	g_free(ring);
+}
+
 static const char *request_id_to_string(struct ril_s *ril, int req)
 {
 	const char *str = NULL;
@@ -311,6 +442,11 @@ static void ril_cleanup(struct ril_s *p)
 		p->command_queue = NULL;
 	}
 
+	if (p->pending) {
+		g_hash_table_destroy(p->pending);
+		p->pending = NULL;
+	}
+
 	if (p->out_queue) {
 		g_queue_free(p->out_queue);
 		p->out_queue = NULL;
@@ -326,6 +462,8 @@ static void ril_cleanup(struct ril_s *p)
 		g_source_remove(p->timeout_source);
 		p->timeout_source = 0;
 	}
+
+	parcel_pool_flush();
 }
 
 void g_ril_set_disconnect_function(GRil *ril, GRilDisconnectFunc disconnect,
@@ -341,6 +479,7 @@ static void io_disconnect(gpointer user_data)
 
 	ofono_error("%s: disconnected from rild", __func__);
 
+	ril_trace_dump(ril);
 	ril_cleanup(ril);
 	g_ril_io_unref(ril->io);
 	ril->io = NULL;
@@ -351,60 +490,48 @@ static void io_disconnect(gpointer user_data)
 
 static void handle_response(struct ril_s *p, struct ril_msg *message)
 {
-	guint count = g_queue_get_length(p->command_queue);
 	struct ril_request *req;
-	gboolean found = FALSE;
-	guint i, len;
-	gint id;
 
-	for (i = 0; i < count; i++) {
-		req = g_queue_peek_nth(p->command_queue, i);
-
-		if (req->id == message->serial_no) {
-			found = TRUE;
-			message->req = req->req;
-
-			if (message->error != RIL_E_SUCCESS)
-				RIL_TRACE(p, "[%d,%04d]< %s failed %s",
-					p->slot, message->serial_no,
-					request_id_to_string(p, message->req),
-					ril_error_to_string(message->error));
-
-			req = g_queue_pop_nth(p->command_queue, i);
-			if (req->callback)
-				req->callback(message, req->user_data);
+	req = g_hash_table_lookup(p->pending,
+					GINT_TO_POINTER(message->serial_no));
+	if (req == NULL) {
+		ofono_error("No matching request for reply: %s serial_no: %d!",
+			request_id_to_string(p, message->req),
+			message->serial_no);
+		return;
+	}
 
-			/* gril may have been destroyed in the request callback */
-			if (p->destroyed) {
-				ril_request_destroy(req);
-				return;
-			}
+	message->req = req->req;
 
-			len = g_queue_get_length(p->out_queue);
+	if (message->error != RIL_E_SUCCESS)
+		RIL_TRACE(p, "[%d,%04d]< %s failed %s",
+			p->slot, message->serial_no,
+			request_id_to_string(p, message->req),
+			ril_error_to_string(message->error));
 
-			for (i = 0; i < len; i++) {
-				id = GPOINTER_TO_INT(g_queue_peek_nth(
-							p->out_queue, i));
-				if (id == req->id) {
-					g_queue_pop_nth(p->out_queue, i);
-					break;
-				}
-			}
+	g_hash_table_remove(p->pending, GINT_TO_POINTER(req->id));
+	g_queue_remove(p->command_queue, req);
 
-			ril_request_destroy(req);
+	if (p->latencyf && req->start)
+		p->latencyf(req->req, message->error,
+				g_get_monotonic_time() - req->start,
+				p->latency_data);
 
-			if (g_queue_peek_head(p->command_queue))
-				ril_wakeup_writer(p);
+	if (req->callback)
+		req->callback(message, req->user_data);
 
-			break;
-		}
+	/* gril may have been destroyed in the request callback */
+	if (p->destroyed) {
+		ril_request_destroy(req);
+		return;
 	}
 
-	if (found == FALSE)
-		ofono_error("No matching request for reply: %s serial_no: %d!",
-			request_id_to_string(p, message->req),
-			message->serial_no);
+	g_queue_remove(p->out_queue, GINT_TO_POINTER(req->id));
 
+	ril_request_destroy(req);
+
+	if (g_queue_peek_head(p->command_queue))
+		ril_wakeup_writer(p);
 }
 
 static gboolean node_check_destroyed(struct ril_notify_node *node,
@@ -454,11 +581,14 @@ static void handle_unsol_req(struct ril_s *p, struct ril_msg *message)
 					GUINT_TO_POINTER(TRUE));
 }
 
+/*
+ * Parses the RIL record header in place, message->buf is left pointing
+ * at the event or response data within the record.
+ */
 static void dispatch(struct ril_s *p, struct ril_msg *message)
 {
 	int32_t *unsolicited_field, *id_num_field;
 	gchar *bufp = message->buf;
-	gchar *datap;
 	gsize data_len;
 
 	/* This could be done with a struct/union... */
@@ -498,27 +628,10 @@ static void dispatch(struct ril_s *p, struct ril_msg *message)
 	/* advance to start of data.. */
 	bufp += 4;
 
-	/*
-	 * Now, use buffer for event data if present
-	 */
 	if (data_len) {
-		datap = g_try_malloc(data_len);
-		if (datap == NULL)
-			goto error;
-
-		/* Copy event bytes from message->buf into new buffer */
-		memcpy(datap, bufp, data_len);
-
-		/* Free buffer that includes header */
-		g_free(message->buf);
-
-		/* ...and replace with new buffer */
-		message->buf = datap;
+		message->buf = bufp;
 		message->buf_len = data_len;
 	} else {
-		/* Free buffer that includes header */
-		g_free(message->buf);
-
 		/* To know if there was no data when parsing */
 		message->buf = NULL;
 		message->buf_len = 0;
@@ -528,16 +641,16 @@ static void dispatch(struct ril_s *p, struct ril_msg *message)
 		handle_unsol_req(p, message);
 	else
 		handle_response(p, message);
-
-error:
-	g_free(message->buf);
-	g_free(message);
 }
 
-static struct ril_msg *read_fixed_record(struct ril_s *p,
-						const guchar *bytes, gsize *len)
+/*
+ * Records are only extracted once they are contiguous in the ring
+ * buffer, so they are parsed directly from there without copying.  The
+ * bytes are drained only after the record has been dispatched.
+ */
+static gboolean read_fixed_record(struct ril_s *p, guchar *bytes,
+					gsize *len, struct ril_msg *message)
 {
-	struct ril_msg *message;
 	unsigned message_len, plen;
 
 	/* First four bytes are length in TCP byte order (Big Endian) */
@@ -562,30 +675,25 @@ static struct ril_msg *read_fixed_record(struct ril_s *p,
 
 	/*
 	 * If we don't have the whole fixed record in the ringbuffer
-	 * then return NULL & leave ringbuffer as is.
+	 * then return FALSE & leave ringbuffer as is.
 	 */
 
 	message_len = *len - 4;
 	if (message_len < plen)
-		return NULL;
-
-	message = g_malloc(sizeof(struct ril_msg));
+		return FALSE;
 
-	/* allocate ril_msg->buffer */
+	memset(message, 0, sizeof(*message));
 	message->buf_len = plen;
-	message->buf = g_malloc(plen);
-
-	/* Copy bytes into message buffer */
-	memmove(message->buf, (const void *) bytes, plen);
+	message->buf = (gchar *) bytes;
 
 	/* Indicate to caller size of record we extracted */
 	*len = plen + 4;
-	return message;
+	return TRUE;
 }
 
 static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
 {
-	struct ril_msg *message;
+	struct ril_msg message;
 	struct ril_s *p = user_data;
 	unsigned int len = ring_buffer_len(rbuf);
 	unsigned int wrap = ring_buffer_len_no_wrap(rbuf);
@@ -604,15 +712,17 @@ static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
 		/*
 		 * This function attempts to read the next full length
 		 * fixed message from the stream.  if not all bytes are
-		 * available, it returns NULL.  otherwise it allocates
-		 * and returns a ril_message with the copied bytes, and
-		 * drains those bytes from the ring_buffer
+		 * available, it returns FALSE.  otherwise it fills in
+		 * message pointing at the record within the ring_buffer
 		 */
-		message = read_fixed_record(p, buf, &rbytes);
+		if (!read_fixed_record(p, buf, &rbytes, &message))
+			break; /* wait for the rest of the record... */
 
-		/* wait for the rest of the record... */
-		if (message == NULL)
-			break;
+		ril_trace_record(p, RIL_TRACE_DIR_IN,
+					message.buf, message.buf_len);
+
+		/* Dispatch before buf moves on, message points into it */
+		dispatch(p, &message);
 
 		buf += rbytes;
 		p->read_so_far += rbytes;
@@ -623,8 +733,6 @@ static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
 			wrap = len;
 		}
 
-		dispatch(p, message);
-
 		ring_buffer_drain(rbuf, p->read_so_far);
 
 		len -= p->read_so_far;
@@ -727,12 +835,19 @@ out:
 	if (bytes_written == 0)
 		return FALSE;
 
+	if (ril->req_bytes_written == 0)
+		req->start = g_get_monotonic_time();
+
 	ril->req_bytes_written += bytes_written;
 	if (bytes_written < towrite)
 		return TRUE;
 	else
 		ril->req_bytes_written = 0;
 
+	/* Skip the length field, it is implied by the trace record */
+	ril_trace_record(ril, RIL_TRACE_DIR_OUT, req->data + 4,
+				req->data_len - 4);
+
 	return FALSE;
 }
 
@@ -777,6 +892,9 @@ static void ril_unref(struct ril_s *ril)
 		ril_cleanup(ril);
 	}
 
+	ril_trace_dump(ril);
+	ril_trace_free(ril);
+
 	if (ril->in_read_handler)
 		ril->destroyed = TRUE;
 	else
@@ -888,6 +1006,8 @@ static struct ril_s *create_ril(const char *sock_path, unsigned int uid,
 		goto error;
 	}
 
+	ril->pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+
 	ril->notify_list = g_hash_table_new_full(g_int_hash, g_int_equal,
 							g_free,
 							ril_notify_destroy);
@@ -956,6 +1076,7 @@ static void ril_cancel_group(struct ril_s *ril, guint group)
 		if (sent)
 			continue;
 
+		g_hash_table_remove(ril->pending, GINT_TO_POINTER(req->id));
 		g_queue_remove(ril->command_queue, req);
 		ril_request_destroy(req);
 	}
@@ -1151,6 +1272,7 @@ gint g_ril_send(GRil *ril, const gint reqid, struct parcel *rilp,
 	p->next_cmd_id++;
 
 	g_queue_push_tail(p->command_queue, r);
+	g_hash_table_replace(p->pending, GINT_TO_POINTER(r->id), r);
 
 	ril_wakeup_writer(p);
 
@@ -1199,6 +1321,43 @@ gboolean g_ril_set_trace(GRil *ril, gboolean trace)
 	return ril->parent->trace = trace;
 }
 
+gboolean g_ril_set_trace_ring(GRil *ril, gsize size, const char *path)
+{
+	struct ril_trace_ring *ring;
+
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	ril_trace_free(ril->parent);
+
+	if (size == 0)
+		return TRUE;
+
+	ring = g_try_new0(struct ril_trace_ring, 1);
+	if (ring == NULL)
+		return FALSE;
+
+	ring->buf = g_try_malloc(size);
+	if (ring->buf == NULL) {
+		g_free(ring);
+		return FALSE;
+	}
+
+	ring->size = size;
+	ring->path = g_strdup(path);
+	ril->parent->trace_ring = ring;
+
+	return TRUE;
+}
+
+gboolean g_ril_dump_trace_ring(GRil *ril)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	return ril_trace_dump(ril->parent);
+}
+
 gboolean g_ril_set_slot(GRil *ril, int slot)
 {
 	if (ril == NULL || ril->parent == NULL)
@@ -1226,6 +1385,18 @@ gboolean g_ril_set_debugf(GRil *ril,
 	return ril_set_debug(ril->parent, func, user_data);
 }
 
+gboolean g_ril_set_latency(GRil *ril, GRilLatencyFunc func,
+					gpointer user_data)
+{
+	if (ril == NULL || ril->group != 0)
+		return FALSE;
+
+	ril->parent->latencyf = func;
+	ril->parent->latency_data = user_data;
+
+	return TRUE;
+}
+
 gboolean g_ril_set_vendor_print_msg_id_funcs(GRil *ril,
 					GRilMsgIdToStrFunc req_to_string,
 					GRilMsgIdToStrFunc unsol_to_string)
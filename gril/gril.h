@@ -57,6 +57,9 @@ typedef void (*GRilNotifyFunc)(struct ril_msg *message, gpointer user_data);
 
 typedef const char *(*GRilMsgIdToStrFunc)(int msg_id);
 
+typedef void (*GRilLatencyFunc)(int req, int error, guint usec,
+							gpointer user_data);
+
 /**
  * TRACE:
  * @fmt: format string
@@ -128,6 +131,14 @@ void g_ril_set_disconnect_function(GRil *ril, GRilDisconnectFunc disconnect,
 gboolean g_ril_get_trace(GRil *ril);
 gboolean g_ril_set_trace(GRil *ril, gboolean trace);
 
+/*!
+ * Keep a binary trace of the last size bytes of raw RIL messages.  The
+ * trace is written to path when rild disconnects, when the channel is
+ * destroyed or on g_ril_dump_trace_ring.  A size of 0 disables tracing.
+ */
+gboolean g_ril_set_trace_ring(GRil *ril, gsize size, const char *path);
+gboolean g_ril_dump_trace_ring(GRil *ril);
+
 int g_ril_get_slot(GRil *ril);
 gboolean g_ril_set_slot(GRil *ril, int slot);
 
@@ -138,6 +149,13 @@ gboolean g_ril_set_slot(GRil *ril, int slot);
  */
 gboolean g_ril_set_debugf(GRil *ril, GRilDebugFunc func, gpointer user_data);
 
+/*!
+ * If the function is not NULL, then it is called for every reply with the
+ * time from the request being written to the reply being received
+ */
+gboolean g_ril_set_latency(GRil *ril, GRilLatencyFunc func,
+					gpointer user_data);
+
 gboolean g_ril_set_vendor_print_msg_id_funcs(GRil *ril,
 					GRilMsgIdToStrFunc req_to_string,
 					GRilMsgIdToStrFunc unsol_to_string);
@@ -0,0 +1,68 @@
+/*
+ *
+ *  RIL library with GLib integration
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __GRILTRACE_H
+#define __GRILTRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Binary trace dump format, all fields in host byte order:
+ *
+ * struct ril_trace_file_hdr
+ * { struct ril_trace_rec_hdr, caplen bytes of record }*
+ *
+ * The record is the RIL message as found on the socket minus the leading
+ * length field: reqid, serial and parcel for requests; type, serial/id,
+ * error and parcel for replies and unsolicited messages.
+ */
+#define RIL_TRACE_MAGIC		0x544c4952	/* "RILT" */
+#define RIL_TRACE_VERSION	1
+
+/* Records are cut to this size so a single message cannot flush the ring */
+#define RIL_TRACE_MAX_CAPLEN	512
+
+enum ril_trace_dir {
+	RIL_TRACE_DIR_OUT =	0,
+	RIL_TRACE_DIR_IN =	1,
+};
+
+struct ril_trace_file_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t slot;
+} __attribute__((packed));
+
+struct ril_trace_rec_hdr {
+	uint64_t timestamp;	/* Microseconds since the epoch */
+	uint32_t len;		/* Length of the message on the wire */
+	uint16_t caplen;	/* Length captured in the trace */
+	uint8_t dir;
+	uint8_t reserved;
+} __attribute__((packed));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GRILTRACE_H */
@@ -46,30 +46,111 @@
 
 typedef uint16_t char16_t;
 
+/*
+ * Parcels are built and thrown away for every request sent, so keep a few
+ * of the released buffers around instead of handing them back to malloc.
+ * Only reasonably sized buffers are recycled.
+ */
+#define PARCEL_MIN_SIZE 64
+#define PARCEL_POOL_SIZE 8
+#define PARCEL_POOL_MAX_CAPACITY 4096
+
+struct parcel_buf {
+	char *data;
+	size_t capacity;
+};
+
+static struct parcel_buf parcel_pool[PARCEL_POOL_SIZE];
+static unsigned int parcel_pool_len;
+
 void parcel_init(struct parcel *p)
 {
-	p->data = g_malloc0(sizeof(int32_t));
+	if (parcel_pool_len > 0) {
+		parcel_pool_len -= 1;
+		p->data = parcel_pool[parcel_pool_len].data;
+		p->capacity = parcel_pool[parcel_pool_len].capacity;
+	} else {
+		p->data = g_malloc0(PARCEL_MIN_SIZE);
+		p->capacity = PARCEL_MIN_SIZE;
+	}
+
 	p->size = 0;
-	p->capacity = sizeof(int32_t);
 	p->offset = 0;
 	p->malformed = 0;
 }
 
 void parcel_grow(struct parcel *p, size_t size)
 {
-	char *new = g_realloc(p->data, p->capacity + size);
-	p->data = new;
-	p->capacity += size;
+	size_t capacity = p->capacity ? p->capacity : PARCEL_MIN_SIZE;
+
+	/* Grow geometrically so that building a parcel stays linear */
+	while (capacity < p->capacity + size)
+		capacity *= 2;
+
+	p->data = g_realloc(p->data, capacity);
+	p->capacity = capacity;
+}
+
+void parcel_reserve(struct parcel *p, size_t size)
+{
+	/* Writers require the capacity to strictly exceed the data */
+	if (p->offset + size < p->capacity)
+		return;
+
+	parcel_grow(p, p->offset + size + 1 - p->capacity);
 }
 
 void parcel_free(struct parcel *p)
 {
-	g_free(p->data);
+	if (p->data != NULL && p->capacity <= PARCEL_POOL_MAX_CAPACITY &&
+			parcel_pool_len < PARCEL_POOL_SIZE) {
+		parcel_pool[parcel_pool_len].data = p->data;
+		parcel_pool[parcel_pool_len].capacity = p->capacity;
+		parcel_pool_len += 1;
+	} else
+		g_free(p->data);
+
+	p->data = NULL;
 	p->size = 0;
 	p->capacity = 0;
 	p->offset = 0;
 }
 
+void parcel_pool_flush(void)
+{
+	while (parcel_pool_len > 0) {
+		parcel_pool_len -= 1;
+		g_free(parcel_pool[parcel_pool_len].data);
+		parcel_pool[parcel_pool_len].data = NULL;
+	}
+}
+
+/* Number of UTF-16 code units needed to encode a valid UTF-8 string */
+static size_t utf8_utf16_len(const char *str)
+{
+	const unsigned char *s;
+	size_t len = 0;
+
+	for (s = (const unsigned char *) str; *s; s++) {
+		if ((*s & 0xc0) == 0x80)
+			continue;
+
+		/* Four byte sequences become surrogate pairs */
+		len += *s >= 0xf0 ? 2 : 1;
+	}
+
+	return len;
+}
+
+size_t parcel_string_size(const char *str)
+{
+	if (str == NULL)
+		return sizeof(int32_t);
+
+	return sizeof(int32_t) +
+		PAD_SIZE((utf8_utf16_len(str) + 1) * sizeof(char16_t));
+}
+
 int32_t parcel_r_int32(struct parcel *p)
 {
 	int32_t ret;
@@ -108,61 +189,54 @@ int parcel_w_int32(struct parcel *p, int32_t val)
 
 int parcel_w_string(struct parcel *p, const char *str)
 {
-	gunichar2 *gs16;
-	glong gs16_len;
+	char16_t *dst;
+	const char *s;
+	size_t len16;
 	size_t len;
-	size_t gs16_size;
+	size_t padded;
 
 	if (str == NULL) {
 		parcel_w_int32(p, -1);
 		return 0;
 	}
 
-	gs16 = g_utf8_to_utf16(str, -1, NULL, &gs16_len, NULL);
+	if (!g_utf8_validate(str, -1, NULL)) {
+		ofono_error("%s: wrong UTF8 coding", __func__);
+		parcel_w_int32(p, -1);
+		return -1;
+	}
+
+	len16 = utf8_utf16_len(str);
 
-	if (parcel_w_int32(p, gs16_len) == -1)
+	if (parcel_w_int32(p, len16) == -1)
 		return -1;
 
-	gs16_size = gs16_len * sizeof(char16_t);
-	len = gs16_size + sizeof(char16_t);
-	for (;;) {
-		size_t padded = PAD_SIZE(len);
+	len = (len16 + 1) * sizeof(char16_t);
+	padded = PAD_SIZE(len);
+	parcel_reserve(p, padded);
 
-		if (p->offset + len < p->capacity) {
-			/* There's enough space */
-			memcpy(p->data + p->offset, gs16, gs16_size);
-			*((char16_t *) (void *)
-				(p->data + p->offset + gs16_size)) = 0;
-			p->offset += padded;
-			p->size += padded;
-			if (padded != len) {
-
-#if BYTE_ORDER == BIG_ENDIAN
-				static const uint32_t mask[4] = {
-					0x00000000, 0xffffff00,
-					0xffff0000, 0xff000000
-				};
-#endif
-#if BYTE_ORDER == LITTLE_ENDIAN
-				static const uint32_t mask[4] = {
-					0x00000000, 0x00ffffff,
-					0x0000ffff, 0x000000ff
-				};
-#endif
+	/* Encode straight into the parcel, no intermediate UTF-16 copy */
+	dst = (char16_t *) (void *) (p->data + p->offset);
 
-				*((uint32_t *) (void *)
-					(p->data + p->offset - 4)) &=
-							mask[padded - len];
-			}
-			break;
+	for (s = str; *s; s = g_utf8_next_char(s)) {
+		gunichar c = g_utf8_get_char(s);
 
-		} else {
-			/* Grow data and retry */
-			parcel_grow(p, padded);
-		}
+		if (c >= 0x10000) {
+			c -= 0x10000;
+			*dst++ = 0xd800 + (c >> 10);
+			*dst++ = 0xdc00 + (c & 0x3ff);
+		} else
+			*dst++ = c;
 	}
 
-	g_free(gs16);
+	*dst++ = 0;
+
+	if (padded != len)
+		memset(dst, 0, padded - len);
+
+	p->offset += padded;
+	p->size += padded;
+
 	return 0;
 }
 
@@ -199,6 +273,66 @@ char *parcel_r_string(struct parcel *p)
 	return ret;
 }
 
+const char *parcel_r_string_buf(struct parcel *p, char *buf, size_t size)
+{
+	const char16_t *src;
+	int len16 = parcel_r_int32(p);
+	int strbytes;
+	size_t n = 0;
+	int i;
+
+	if (p->malformed)
+		return NULL;
+
+	/* This is how a null string is sent */
+	if (len16 < 0)
+		return NULL;
+
+	strbytes = PAD_SIZE((len16 + 1) * sizeof(char16_t));
+	if (p->offset + strbytes > p->size) {
+		ofono_error("%s: parcel is too small", __func__);
+		p->malformed = 1;
+		return NULL;
+	}
+
+	src = (const char16_t *) (void *) (p->data + p->offset);
+	p->offset += strbytes;
+
+	for (i = 0; i < len16 && src[i] != 0; i++) {
+		gunichar c = src[i];
+		int clen;
+
+		if (c >= 0xd800 && c < 0xdc00) {
+			if (i + 1 >= len16 || src[i + 1] < 0xdc00 ||
+					src[i + 1] >= 0xe000)
+				goto bad_coding;
+
+			c = 0x10000 + ((c - 0xd800) << 10) +
+						(src[i + 1] - 0xdc00);
+			i += 1;
+		} else if (c >= 0xdc00 && c < 0xe000)
+			goto bad_coding;
+
+		clen = g_unichar_to_utf8(c, NULL);
+		if (n + clen >= size) {
+			ofono_error("%s: buffer too small (%zu bytes)",
+							__func__, size);
+			return NULL;
+		}
+
+		n += g_unichar_to_utf8(c, buf + n);
+	}
+
+	buf[n] = '\0';
+
+	return buf;
+
+bad_coding:
+	ofono_error("%s: wrong UTF16 coding", __func__);
+	p->malformed = 1;
+	return NULL;
+}
+
 void parcel_skip_string(struct parcel *p)
 {
 	int len16 = parcel_r_int32(p);
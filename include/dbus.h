@@ -31,6 +31,8 @@ extern "C" {
 #define OFONO_SERVICE	"org.ofono"
 #define OFONO_MANAGER_INTERFACE "org.ofono.Manager"
 #define OFONO_MANAGER_PATH "/"
+#define OFONO_DEBUG_INTERFACE OFONO_SERVICE ".Debug"
+#define OFONO_STATISTICS_INTERFACE OFONO_SERVICE ".Statistics"
 #define OFONO_MODEM_INTERFACE "org.ofono.Modem"
 #define OFONO_CALL_BARRING_INTERFACE "org.ofono.CallBarring"
 #define OFONO_CALL_FORWARDING_INTERFACE "org.ofono.CallForwarding"
@@ -46,16 +46,22 @@ struct ofono_debug_desc {
 	const char *file;
 #define OFONO_DEBUG_FLAG_DEFAULT (0)
 #define OFONO_DEBUG_FLAG_PRINT   (1 << 0)
+#define OFONO_DEBUG_FLAG_TRACE   (1 << 1)
 	unsigned int flags;
 } __attribute__((aligned(8)));
 
+extern void ofono_debug_trace(const struct ofono_debug_desc *desc,
+				const char *func, const char *format, ...)
+				__attribute__((format(printf, 3, 4)));
+
 /**
  * DBG:
  * @fmt: format string
  * @arg...: list of arguments
  *
  * Simple macro around ofono_debug() which also include the function
- * name it is called in.
+ * name it is called in.  Sites not printed but enabled for tracing are
+ * recorded unformatted into the trace ring instead.
  */
 #define DBG(fmt, arg...) do { \
 	static struct ofono_debug_desc __ofono_debug_desc \
@@ -65,6 +71,9 @@ struct ofono_debug_desc {
 	if (__ofono_debug_desc.flags & OFONO_DEBUG_FLAG_PRINT) \
 		ofono_debug("%s:%s() " fmt, \
 					__FILE__, __FUNCTION__ , ## arg); \
+	else if (__ofono_debug_desc.flags & OFONO_DEBUG_FLAG_TRACE) \
+		ofono_debug_trace(&__ofono_debug_desc, \
+					__FUNCTION__, fmt , ## arg); \
 } while (0)
 
 #ifdef __cplusplus
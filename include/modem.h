@@ -98,6 +98,10 @@ void ofono_modem_remove(struct ofono_modem *modem);
 
 void ofono_modem_reset(struct ofono_modem *modem);
 
+void ofono_modem_record_latency(struct ofono_modem *modem, const char *group,
+				const char *name, unsigned int usec,
+				ofono_bool_t ok);
+
 void ofono_modem_set_powered(struct ofono_modem *modem, ofono_bool_t powered);
 ofono_bool_t ofono_modem_get_powered(struct ofono_modem *modem);
 
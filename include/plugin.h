@@ -38,6 +38,8 @@ understanding that oFono hasn't reached a stable API."
 #define OFONO_PLUGIN_PRIORITY_DEFAULT     0
 #define OFONO_PLUGIN_PRIORITY_HIGH      100
 
+#define OFONO_PLUGIN_FLAG_DRIVER	(1 << 0)
+
 /**
  * SECTION:plugin
  * @title: Plugin premitives
@@ -53,6 +55,7 @@ struct ofono_plugin_desc {
 	void (*exit) (void);
 	void *debug_start;
 	void *debug_stop;
+	unsigned int flags;
 };
 
 /**
@@ -65,13 +68,38 @@ struct ofono_plugin_desc {
  *
  * Macro for defining a plugin descriptor
  */
-#ifdef OFONO_PLUGIN_BUILTIN
 #define OFONO_PLUGIN_DEFINE(name, description, version, priority, init, exit) \
+		OFONO_PLUGIN_DEFINE_FLAGS(name, description, version, \
+						priority, init, exit, 0)
+
+/**
+ * OFONO_MODEM_DRIVER_PLUGIN_DEFINE:
+ * @name: plugin name, which must match the modem driver name
+ * @description: plugin description
+ * @version: plugin version string
+ * @init: init function registering the modem driver @name
+ * @exit: exit function called on plugin removal
+ *
+ * Macro for defining a plugin that only provides a modem driver.  The
+ * init function is deferred until a modem using driver @name is first
+ * registered, so it must not do anything but register that driver.
+ */
+#define OFONO_MODEM_DRIVER_PLUGIN_DEFINE(name, description, version, \
+						priority, init, exit) \
+		OFONO_PLUGIN_DEFINE_FLAGS(name, description, version, \
+						priority, init, exit, \
+						OFONO_PLUGIN_FLAG_DRIVER)
+
+#ifdef OFONO_PLUGIN_BUILTIN
+#define OFONO_PLUGIN_DEFINE_FLAGS(name, description, version, priority, \
+						init, exit, flags) \
 		struct ofono_plugin_desc __ofono_builtin_ ## name = { \
-			#name, description, version, priority, init, exit \
+			#name, description, version, priority, init, exit, \
+			NULL, NULL, flags \
 		};
 #else
-#define OFONO_PLUGIN_DEFINE(name, description, version, priority, init, exit) \
+#define OFONO_PLUGIN_DEFINE_FLAGS(name, description, version, priority, \
+						init, exit, flags) \
 		extern struct ofono_debug_desc __start___debug[] \
 				__attribute__ ((weak, visibility("hidden"))); \
 		extern struct ofono_debug_desc __stop___debug[] \
@@ -80,7 +108,7 @@ struct ofono_plugin_desc {
 				__attribute__ ((visibility("default"))); \
 		struct ofono_plugin_desc ofono_plugin_desc = { \
 			#name, description, version, priority, init, exit, \
-			__start___debug, __stop___debug \
+			__start___debug, __stop___debug, flags \
 		};
 #endif
 
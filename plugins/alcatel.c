@@ -249,5 +249,5 @@ static void alcatel_exit(void)
 	ofono_modem_driver_unregister(&alcatel_driver);
 }
 
-OFONO_PLUGIN_DEFINE(alcatel, "Alcatel modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(alcatel, "Alcatel modem driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, alcatel_init, alcatel_exit)
@@ -246,5 +246,5 @@ static void cinterion_exit(void)
 	ofono_modem_driver_unregister(&cinterion_driver);
 }
 
-OFONO_PLUGIN_DEFINE(cinterion, "Cinterion driver plugin", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(cinterion, "Cinterion driver plugin", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, cinterion_init, cinterion_exit)
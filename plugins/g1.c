@@ -211,5 +211,5 @@ static void g1_exit(void)
 	ofono_modem_driver_unregister(&g1_driver);
 }
 
-OFONO_PLUGIN_DEFINE(g1, "HTC G1 modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(g1, "HTC G1 modem driver", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT, g1_init, g1_exit)
@@ -645,5 +645,5 @@ static void gemalto_exit(void)
 	ofono_modem_driver_unregister(&gemalto_driver);
 }
 
-OFONO_PLUGIN_DEFINE(gemalto, "Gemalto modem plugin", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(gemalto, "Gemalto modem plugin", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, gemalto_init, gemalto_exit)
@@ -23,6 +23,7 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -80,6 +81,20 @@ static void gobi_debug(const char *str, void *user_data)
 	ofono_info("%s%s", prefix, str);
 }
 
+static void gobi_latency(const char *service, uint16_t message,
+				unsigned int usec, bool ok, void *user_data)
+{
+	struct ofono_modem *modem = user_data;
+	char name[24];
+
+	if (service)
+		snprintf(name, sizeof(name), "%s/0x%04x", service, message);
+	else
+		snprintf(name, sizeof(name), "0x%04x", message);
+
+	ofono_modem_record_latency(modem, "qmi", name, usec, ok);
+}
+
 static int gobi_probe(struct ofono_modem *modem)
 {
 	struct gobi_data *data;
@@ -338,6 +353,8 @@ static int gobi_enable(struct ofono_modem *modem)
 	if (getenv("OFONO_QMI_DEBUG"))
 		qmi_device_set_debug(data->device, gobi_debug, "QMI: ");
 
+	qmi_device_set_latency(data->device, gobi_latency, modem);
+
 	qmi_device_set_close_on_unref(data->device, true);
 
 	qmi_device_discover(data->device, discover_cb, modem, NULL);
@@ -539,5 +556,5 @@ static void gobi_exit(void)
 	ofono_modem_driver_unregister(&gobi_driver);
 }
 
-OFONO_PLUGIN_DEFINE(gobi, "Qualcomm Gobi modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(gobi, "Qualcomm Gobi modem driver", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT, gobi_init, gobi_exit)
@@ -476,5 +476,5 @@ static void hso_exit(void)
 	ofono_modem_driver_unregister(&hso_driver);
 }
 
-OFONO_PLUGIN_DEFINE(hso, "Option HSO modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(hso, "Option HSO modem driver", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT, hso_init, hso_exit)
@@ -921,5 +921,5 @@ static void huawei_exit(void)
 	ofono_modem_driver_unregister(&huawei_driver);
 }
 
-OFONO_PLUGIN_DEFINE(huawei, "HUAWEI Mobile modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(huawei, "HUAWEI Mobile modem driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, huawei_init, huawei_exit)
@@ -73,5 +73,5 @@ static void inf_exit(void)
 	ofono_modem_driver_unregister(&infineon_driver);
 }
 
-OFONO_PLUGIN_DEFINE(infineon, "Infineon modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(infineon, "Infineon modem driver", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT, inf_init, inf_exit)
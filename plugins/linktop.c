@@ -275,5 +275,6 @@ static void linktop_exit(void)
 	ofono_modem_driver_unregister(&linktop_driver);
 }
 
-OFONO_PLUGIN_DEFINE(linktop, "Linktop Datacard modem driver", VERSION,
-		OFONO_PLUGIN_PRIORITY_DEFAULT, linktop_init, linktop_exit)
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(linktop, "Linktop Datacard modem driver",
+		VERSION, OFONO_PLUGIN_PRIORITY_DEFAULT,
+		linktop_init, linktop_exit)
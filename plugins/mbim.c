@@ -23,6 +23,8 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/types.h>
@@ -55,6 +57,8 @@ struct mbim_data {
 	uint16_t max_segment;
 	uint8_t max_outstanding;
 	uint8_t max_sessions;
+	unsigned int init_pending;
+	bool init_failed;
 };
 
 static void mbim_debug(const char *str, void *user_data)
@@ -64,6 +68,44 @@ static void mbim_debug(const char *str, void *user_data)
 	ofono_info("%s%s", prefix, str);
 }
 
+static const char *mbim_service_name(const uint8_t *uuid)
+{
+	static const struct {
+		const uint8_t *uuid;
+		const char *name;
+	} services[] = {
+		{ mbim_uuid_basic_connect,	"BASIC"		},
+		{ mbim_uuid_sms,		"SMS"		},
+		{ mbim_uuid_ussd,		"USSD"		},
+		{ mbim_uuid_phonebook,		"PHONEBOOK"	},
+		{ mbim_uuid_stk,		"STK"		},
+		{ mbim_uuid_auth,		"AUTH"		},
+		{ mbim_uuid_dss,		"DSS"		},
+	};
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(services); i++) {
+		if (!memcmp(services[i].uuid, uuid, 16))
+			return services[i].name;
+	}
+
+	return "VENDOR";
+}
+
+static void mbim_latency(struct mbim_message *message, uint32_t usec,
+							void *user_data)
+{
+	struct ofono_modem *modem = user_data;
+	char name[24];
+
+	snprintf(name, sizeof(name), "%s/%u",
+			mbim_service_name(mbim_message_get_uuid(message)),
+			mbim_message_get_cid(message));
+
+	ofono_modem_record_latency(modem, "mbim", name, usec,
+					mbim_message_get_error(message) == 0);
+}
+
 static int mbim_parse_descriptors(struct mbim_data *md, const char *file)
 {
 	void *data;
@@ -157,14 +199,29 @@ error:
 	mbim_device_shutdown(md->device);
 }
 
-static void mbim_device_subscribe_list_set_cb(struct mbim_message *message,
-						void *user)
+static void mbim_init_failed(struct ofono_modem *modem)
 {
-	struct ofono_modem *modem = user;
 	struct mbim_data *md = ofono_modem_get_data(modem);
 
-	if (mbim_message_get_error(message) != 0)
-		goto error;
+	if (md->init_failed)
+		return;
+
+	md->init_failed = true;
+	mbim_device_shutdown(md->device);
+}
+
+/*
+ * The capabilities query and the subscription list are independent and
+ * are sent together; the radio is only touched once both have completed
+ * so that no state change indications are missed.
+ */
+static void mbim_init_step_done(struct ofono_modem *modem)
+{
+	struct mbim_data *md = ofono_modem_get_data(modem);
+	struct mbim_message *message;
+
+	if (--md->init_pending > 0 || md->init_failed)
+		return;
 
 	message = mbim_message_new(mbim_uuid_basic_connect,
 					MBIM_CID_RADIO_STATE,
@@ -175,8 +232,20 @@ static void mbim_device_subscribe_list_set_cb(struct mbim_message *message,
 				mbim_radio_state_init_cb, modem, NULL))
 		return;
 
-error:
-	mbim_device_shutdown(md->device);
+	mbim_init_failed(modem);
+}
+
+static void mbim_device_subscribe_list_set_cb(struct mbim_message *message,
+						void *user)
+{
+	struct ofono_modem *modem = user;
+
+	if (mbim_message_get_error(message) != 0) {
+		mbim_init_failed(modem);
+		return;
+	}
+
+	mbim_init_step_done(modem);
 }
 
 static void mbim_device_caps_info_cb(struct mbim_message *message, void *user)
@@ -223,31 +292,11 @@ static void mbim_device_caps_info_cb(struct mbim_message *message, void *user)
 	l_free(firmware_info);
 	l_free(hardware_info);
 
-	message = mbim_message_new(mbim_uuid_basic_connect,
-					MBIM_CID_DEVICE_SERVICE_SUBSCRIBE_LIST,
-					MBIM_COMMAND_TYPE_SET);
-
-	mbim_message_set_arguments(message, "av", 2,
-					"16yuuuuuuu",
-					mbim_uuid_basic_connect, 6,
-					MBIM_CID_SUBSCRIBER_READY_STATUS,
-					MBIM_CID_RADIO_STATE,
-					MBIM_CID_REGISTER_STATE,
-					MBIM_CID_PACKET_SERVICE,
-					MBIM_CID_SIGNAL_STATE,
-					MBIM_CID_CONNECT,
-					"16yuuuu", mbim_uuid_sms, 3,
-					MBIM_CID_SMS_CONFIGURATION,
-					MBIM_CID_SMS_READ,
-					MBIM_CID_SMS_MESSAGE_STORE_STATUS);
-
-	if (mbim_device_send(md->device, 0, message,
-				mbim_device_subscribe_list_set_cb,
-				modem, NULL))
-		return;
+	mbim_init_step_done(modem);
+	return;
 
 error:
-	mbim_device_shutdown(md->device);
+	mbim_init_failed(modem);
 }
 
 static void mbim_device_closed(void *user_data)
@@ -265,13 +314,43 @@ static void mbim_device_ready(void *user_data)
 {
 	struct ofono_modem *modem = user_data;
 	struct mbim_data *md = ofono_modem_get_data(modem);
-	struct mbim_message *message =
-		mbim_message_new(mbim_uuid_basic_connect,
-					1, MBIM_COMMAND_TYPE_QUERY);
+	struct mbim_message *message;
+
+	md->init_pending = 2;
+	md->init_failed = false;
 
+	message = mbim_message_new(mbim_uuid_basic_connect,
+					1, MBIM_COMMAND_TYPE_QUERY);
 	mbim_message_set_arguments(message, "");
-	mbim_device_send(md->device, 0, message,
-				mbim_device_caps_info_cb, modem, NULL);
+
+	if (!mbim_device_send(md->device, 0, message,
+				mbim_device_caps_info_cb, modem, NULL)) {
+		mbim_init_failed(modem);
+		return;
+	}
+
+	message = mbim_message_new(mbim_uuid_basic_connect,
+					MBIM_CID_DEVICE_SERVICE_SUBSCRIBE_LIST,
+					MBIM_COMMAND_TYPE_SET);
+
+	mbim_message_set_arguments(message, "av", 2,
+					"16yuuuuuuu",
+					mbim_uuid_basic_connect, 6,
+					MBIM_CID_SUBSCRIBER_READY_STATUS,
+					MBIM_CID_RADIO_STATE,
+					MBIM_CID_REGISTER_STATE,
+					MBIM_CID_PACKET_SERVICE,
+					MBIM_CID_SIGNAL_STATE,
+					MBIM_CID_CONNECT,
+					"16yuuuu", mbim_uuid_sms, 3,
+					MBIM_CID_SMS_CONFIGURATION,
+					MBIM_CID_SMS_READ,
+					MBIM_CID_SMS_MESSAGE_STORE_STATUS);
+
+	if (!mbim_device_send(md->device, 0, message,
+				mbim_device_subscribe_list_set_cb,
+				modem, NULL))
+		mbim_init_failed(modem);
 }
 
 static int mbim_enable(struct ofono_modem *modem)
@@ -300,6 +379,7 @@ static int mbim_enable(struct ofono_modem *modem)
 	mbim_device_set_disconnect_handler(md->device,
 					mbim_device_closed, modem, NULL);
 	mbim_device_set_debug(md->device, mbim_debug, "MBIM:", NULL);
+	mbim_device_set_latency(md->device, mbim_latency, modem);
 
 	return -EINPROGRESS;
 }
@@ -429,5 +509,5 @@ static void mbim_exit(void)
 	ofono_modem_driver_unregister(&mbim_driver);
 }
 
-OFONO_PLUGIN_DEFINE(mbim, "MBIM modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(mbim, "MBIM modem driver", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT, mbim_init, mbim_exit)
@@ -23,6 +23,7 @@
 #include <config.h>
 #endif
 
+#include <stdint.h>
 #include <string.h>
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -42,10 +43,79 @@
 							"serviceproviders.xml"
 #endif
 
+#ifndef MBPI_INDEX
+#define MBPI_INDEX	STORAGEDIR "/serviceproviders.idx"
+#endif
+
 #include "mbpi.h"
 
 #define _(x) case x: return (#x)
 
+/*
+ * Binary index of the database, built with one pass over the XML and
+ * cached in MBPI_INDEX.  All fields are in host byte order.  The header
+ * is followed by the GSM entries sorted by MCC and MNC, the APN
+ * references of the GSM entries, the APN records, the CDMA entries
+ * sorted by SID and finally the NUL terminated strings.  Strings are
+ * referenced by their offset, MBPI_INDEX_NONE meaning no string.
+ */
+#define MBPI_INDEX_MAGIC	0x4950424d	/* "MBPI" */
+#define MBPI_INDEX_VERSION	1
+#define MBPI_INDEX_NONE		0xffffffff
+
+struct mbpi_index_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint64_t db_mtime;
+	uint64_t db_size;
+	uint32_t n_gsm;
+	uint32_t n_refs;
+	uint32_t n_apns;
+	uint32_t n_cdma;
+	uint32_t strings_len;
+	uint32_t padding;
+} __attribute__((packed));
+
+struct mbpi_index_gsm {
+	char mcc[4];
+	char mnc[4];
+	uint32_t first_ref;
+	uint32_t n_refs;
+} __attribute__((packed));
+
+struct mbpi_index_apn {
+	uint32_t name;
+	uint32_t apn;
+	uint32_t username;
+	uint32_t password;
+	uint32_t message_center;
+	uint32_t message_proxy;
+	uint8_t type;
+	uint8_t auth_method;
+	uint16_t reserved;
+} __attribute__((packed));
+
+struct mbpi_index_cdma {
+	uint32_t sid;
+	uint32_t name;
+} __attribute__((packed));
+
+struct mbpi_index {
+	void *data;
+	size_t size;
+	gboolean mapped;
+	const struct mbpi_index_hdr *hdr;
+	const struct mbpi_index_gsm *gsm;
+	const uint32_t *refs;
+	const struct mbpi_index_apn *apns;
+	const struct mbpi_index_cdma *cdma;
+	const char *strings;
+};
+
+static struct mbpi_index *index_cache;
+static struct stat index_failed_st;
+
 enum MBPI_ERROR {
 	MBPI_ERROR_DUPLICATE,
 };
@@ -613,8 +683,703 @@ static gboolean mbpi_parse(const GMarkupParser *parser, gpointer userdata,
 	return ret;
 }
 
-GSList *mbpi_lookup_apn(const char *mcc, const char *mnc,
-			gboolean allow_duplicates, GError **error)
+struct index_apn {
+	struct ofono_gprs_provision_data *ap;
+	unsigned int n_network_ids;
+};
+
+struct index_builder {
+	GPtrArray *stack;
+	GPtrArray *apns;
+	GHashTable *gsm;
+	GPtrArray *network_ids;
+	struct index_apn current;
+	GHashTable *cdma;
+	GPtrArray *sids;
+	char *provider_name;
+};
+
+static const char *builder_parent(struct index_builder *b, unsigned int up)
+{
+	if (b->stack->len <= up)
+		return "";
+
+	return g_ptr_array_index(b->stack, b->stack->len - 1 - up);
+}
+
+static const char *find_attribute(const gchar **names, const gchar **values,
+					const char *name)
+{
+	int i;
+
+	for (i = 0; names[i]; i++)
+		if (g_str_equal(names[i], name))
+			return values[i];
+
+	return NULL;
+}
+
+static void builder_network_id(GMarkupParseContext *context,
+				struct index_builder *b,
+				const gchar **attribute_names,
+				const gchar **attribute_values,
+				GError **error)
+{
+	const char *mcc, *mnc;
+
+	mcc = find_attribute(attribute_names, attribute_values, "mcc");
+	mnc = find_attribute(attribute_names, attribute_values, "mnc");
+
+	if (mcc == NULL || mnc == NULL) {
+		mbpi_g_set_error(context, error, G_MARKUP_ERROR,
+					G_MARKUP_ERROR_MISSING_ATTRIBUTE,
+					"Missing attribute: %s",
+					mcc == NULL ? "mcc" : "mnc");
+		return;
+	}
+
+	if (strlen(mcc) > 3 || strlen(mnc) > 3) {
+		mbpi_g_set_error(context, error, G_MARKUP_ERROR,
+					G_MARKUP_ERROR_INVALID_CONTENT,
+					"Invalid network-id %s/%s", mcc, mnc);
+		return;
+	}
+
+	g_ptr_array_add(b->network_ids, g_strconcat(mcc, " ", mnc, NULL));
+}
+
+static void builder_start(GMarkupParseContext *context,
+				const gchar *element_name,
+				const gchar **attribute_names,
+				const gchar **attribute_values,
+				gpointer userdata, GError **error)
+{
+	struct index_builder *b = userdata;
+	const char *parent = builder_parent(b, 0);
+	struct ofono_gprs_provision_data *ap = b->current.ap;
+	const char *value;
+
+	g_ptr_array_add(b->stack, g_strdup(element_name));
+
+	if (g_str_equal(element_name, "provider")) {
+		g_free(b->provider_name);
+		b->provider_name = NULL;
+		g_ptr_array_set_size(b->sids, 0);
+	} else if (g_str_equal(element_name, "gsm")) {
+		g_ptr_array_set_size(b->network_ids, 0);
+	} else if (g_str_equal(parent, "gsm") &&
+			g_str_equal(element_name, "network-id")) {
+		builder_network_id(context, b, attribute_names,
+					attribute_values, error);
+	} else if (g_str_equal(parent, "gsm") &&
+			g_str_equal(element_name, "apn")) {
+		value = find_attribute(attribute_names, attribute_values,
+					"value");
+		if (value == NULL) {
+			mbpi_g_set_error(context, error, G_MARKUP_ERROR,
+					G_MARKUP_ERROR_MISSING_ATTRIBUTE,
+					"APN attribute missing");
+			return;
+		}
+
+		ap = g_new0(struct ofono_gprs_provision_data, 1);
+		ap->apn = g_strdup(value);
+		ap->type = OFONO_GPRS_CONTEXT_TYPE_INTERNET;
+		ap->proto = OFONO_GPRS_PROTO_IP;
+		ap->auth_method = OFONO_GPRS_AUTH_METHOD_CHAP;
+
+		/* Only network-ids seen so far refer to this APN */
+		b->current.ap = ap;
+		b->current.n_network_ids = b->network_ids->len;
+	} else if (ap && g_str_equal(parent, "apn") &&
+			g_str_equal(element_name, "authentication")) {
+		authentication_start(context, attribute_names,
+				attribute_values, &ap->auth_method, error);
+	} else if (ap && g_str_equal(parent, "apn") &&
+			g_str_equal(element_name, "usage")) {
+		usage_start(context, attribute_names, attribute_values,
+				&ap->type, error);
+	} else if (g_str_equal(parent, "cdma") &&
+			g_str_equal(element_name, "sid")) {
+		value = find_attribute(attribute_names, attribute_values,
+					"value");
+		if (value == NULL) {
+			mbpi_g_set_error(context, error, G_MARKUP_ERROR,
+					G_MARKUP_ERROR_MISSING_ATTRIBUTE,
+					"Missing attribute: sid");
+			return;
+		}
+
+		g_ptr_array_add(b->sids, g_strdup(value));
+	}
+}
+
+static void builder_end(GMarkupParseContext *context,
+				const gchar *element_name,
+				gpointer userdata, GError **error)
+{
+	struct index_builder *b = userdata;
+	struct ofono_gprs_provision_data *ap = b->current.ap;
+	unsigned int i;
+
+	g_ptr_array_remove_index(b->stack, b->stack->len - 1);
+
+	if (ap && g_str_equal(element_name, "apn") &&
+			g_str_equal(builder_parent(b, 0), "gsm")) {
+		guint32 idx = b->apns->len;
+
+		if (!ap->username || !ap->password)
+			ap->auth_method = OFONO_GPRS_AUTH_METHOD_NONE;
+
+		g_ptr_array_add(b->apns, ap);
+		b->current.ap = NULL;
+
+		for (i = 0; i < b->current.n_network_ids; i++) {
+			const char *key = g_ptr_array_index(b->network_ids, i);
+			GArray *refs = g_hash_table_lookup(b->gsm, key);
+
+			if (refs == NULL) {
+				refs = g_array_new(FALSE, FALSE,
+							sizeof(guint32));
+				g_hash_table_insert(b->gsm, g_strdup(key),
+							refs);
+			}
+
+			/* A provider may list the same network-id twice */
+			if (refs->len > 0 && g_array_index(refs, guint32,
+						refs->len - 1) == idx)
+				continue;
+
+			g_array_append_val(refs, idx);
+		}
+	} else if (g_str_equal(element_name, "provider")) {
+		/* The first provider claiming a SID wins */
+		for (i = 0; i < b->sids->len; i++) {
+			const char *sid = g_ptr_array_index(b->sids, i);
+
+			if (g_hash_table_contains(b->cdma, sid))
+				continue;
+
+			g_hash_table_insert(b->cdma, g_strdup(sid),
+						g_strdup(b->provider_name));
+		}
+	}
+}
+
+static void builder_text(GMarkupParseContext *context,
+				const gchar *text, gsize text_len,
+				gpointer userdata, GError **error)
+{
+	struct index_builder *b = userdata;
+	struct ofono_gprs_provision_data *ap = b->current.ap;
+	const char *element = builder_parent(b, 0);
+	const char *parent = builder_parent(b, 1);
+	char **string = NULL;
+
+	if (g_str_equal(parent, "provider") && g_str_equal(element, "name"))
+		string = &b->provider_name;
+	else if (ap == NULL || !g_str_equal(parent, "apn"))
+		return;
+	else if (g_str_equal(element, "name"))
+		string = &ap->name;
+	else if (g_str_equal(element, "username"))
+		string = &ap->username;
+	else if (g_str_equal(element, "password"))
+		string = &ap->password;
+	else if (g_str_equal(element, "mmsc"))
+		string = &ap->message_center;
+	else if (g_str_equal(element, "mmsproxy"))
+		string = &ap->message_proxy;
+	else
+		return;
+
+	g_free(*string);
+	*string = g_strndup(text, text_len);
+}
+
+static const GMarkupParser builder_parser = {
+	builder_start,
+	builder_end,
+	builder_text,
+	NULL,
+	NULL,
+};
+
+static guint32 add_string(GByteArray *strings, GHashTable *offsets,
+				const char *str)
+{
+	gpointer value;
+	guint32 offset;
+
+	if (str == NULL)
+		return MBPI_INDEX_NONE;
+
+	if (g_hash_table_lookup_extended(offsets, str, NULL, &value))
+		return GPOINTER_TO_UINT(value);
+
+	offset = strings->len;
+	g_byte_array_append(strings, (const guint8 *) str, strlen(str) + 1);
+	g_hash_table_insert(offsets, (gpointer) str, GUINT_TO_POINTER(offset));
+
+	return offset;
+}
+
+static gint compare_keys(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const char **) a, *(const char **) b);
+}
+
+/* Orders "mcc mnc" keys by MCC, then MNC, the same way lookups do */
+static gint compare_gsm_keys(gconstpointer a, gconstpointer b)
+{
+	const char *ka = *(const char **) a;
+	const char *kb = *(const char **) b;
+	size_t la = strchr(ka, ' ') - ka;
+	size_t lb = strchr(kb, ' ') - kb;
+	int r = strncmp(ka, kb, MIN(la, lb));
+
+	if (r != 0)
+		return r;
+
+	if (la != lb)
+		return la < lb ? -1 : 1;
+
+	return strcmp(ka + la + 1, kb + lb + 1);
+}
+
+static GByteArray *builder_serialize(struct index_builder *b,
+					const struct stat *st)
+{
+	struct mbpi_index_hdr hdr;
+	GByteArray *out;
+	GByteArray *strings;
+	GHashTable *offsets;
+	GArray *refs;
+	GPtrArray *keys;
+	GHashTableIter iter;
+	gpointer key;
+	guint32 n_refs = 0;
+	unsigned int i;
+
+	out = g_byte_array_new();
+	strings = g_byte_array_new();
+	offsets = g_hash_table_new(g_str_hash, g_str_equal);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = MBPI_INDEX_MAGIC;
+	hdr.version = MBPI_INDEX_VERSION;
+	hdr.db_mtime = st->st_mtime;
+	hdr.db_size = st->st_size;
+	hdr.n_gsm = g_hash_table_size(b->gsm);
+	hdr.n_apns = b->apns->len;
+	hdr.n_cdma = g_hash_table_size(b->cdma);
+
+	g_byte_array_append(out, (const guint8 *) &hdr, sizeof(hdr));
+
+	keys = g_ptr_array_new();
+
+	g_hash_table_iter_init(&iter, b->gsm);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		g_ptr_array_add(keys, key);
+
+	g_ptr_array_sort(keys, compare_gsm_keys);
+
+	for (i = 0; i < keys->len; i++) {
+		const char *k = g_ptr_array_index(keys, i);
+		const char *sep = strchr(k, ' ');
+		struct mbpi_index_gsm gsm;
+
+		memset(&gsm, 0, sizeof(gsm));
+		memcpy(gsm.mcc, k, sep - k);
+		strcpy(gsm.mnc, sep + 1);
+
+		refs = g_hash_table_lookup(b->gsm, k);
+		gsm.first_ref = n_refs;
+		gsm.n_refs = refs->len;
+		n_refs += refs->len;
+
+		g_byte_array_append(out, (const guint8 *) &gsm, sizeof(gsm));
+	}
+
+	for (i = 0; i < keys->len; i++) {
+		refs = g_hash_table_lookup(b->gsm, g_ptr_array_index(keys, i));
+		g_byte_array_append(out, (const guint8 *) refs->data,
+					refs->len * sizeof(guint32));
+	}
+
+	for (i = 0; i < b->apns->len; i++) {
+		struct ofono_gprs_provision_data *ap =
+					g_ptr_array_index(b->apns, i);
+		struct mbpi_index_apn apn;
+
+		memset(&apn, 0, sizeof(apn));
+		apn.name = add_string(strings, offsets, ap->name);
+		apn.apn = add_string(strings, offsets, ap->apn);
+		apn.username = add_string(strings, offsets, ap->username);
+		apn.password = add_string(strings, offsets, ap->password);
+		apn.message_center = add_string(strings, offsets,
+							ap->message_center);
+		apn.message_proxy = add_string(strings, offsets,
+							ap->message_proxy);
+		apn.type = ap->type;
+		apn.auth_method = ap->auth_method;
+
+		g_byte_array_append(out, (const guint8 *) &apn, sizeof(apn));
+	}
+
+	g_ptr_array_set_size(keys, 0);
+
+	g_hash_table_iter_init(&iter, b->cdma);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		g_ptr_array_add(keys, key);
+
+	g_ptr_array_sort(keys, compare_keys);
+
+	for (i = 0; i < keys->len; i++) {
+		const char *sid = g_ptr_array_index(keys, i);
+		struct mbpi_index_cdma cdma;
+
+		cdma.sid = add_string(strings, offsets, sid);
+		cdma.name = add_string(strings, offsets,
+					g_hash_table_lookup(b->cdma, sid));
+
+		g_byte_array_append(out, (const guint8 *) &cdma, sizeof(cdma));
+	}
+
+	g_ptr_array_free(keys, TRUE);
+
+	g_byte_array_append(out, strings->data, strings->len);
+
+	hdr.n_refs = n_refs;
+	hdr.strings_len = strings->len;
+	memcpy(out->data, &hdr, sizeof(hdr));
+
+	g_hash_table_destroy(offsets);
+	g_byte_array_free(strings, TRUE);
+
+	return out;
+}
+
+static void free_ap(gpointer data)
+{
+	mbpi_ap_free(data);
+}
+
+static GByteArray *mbpi_index_build(const struct stat *st, GError **error)
+{
+	struct index_builder b;
+	GByteArray *out = NULL;
+
+	memset(&b, 0, sizeof(b));
+	b.stack = g_ptr_array_new_with_free_func(g_free);
+	b.apns = g_ptr_array_new_with_free_func(free_ap);
+	b.gsm = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					(GDestroyNotify) g_array_unref);
+	b.network_ids = g_ptr_array_new_with_free_func(g_free);
+	b.cdma = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					g_free);
+	b.sids = g_ptr_array_new_with_free_func(g_free);
+
+	if (mbpi_parse(&builder_parser, &b, error) == TRUE)
+		out = builder_serialize(&b, st);
+
+	if (b.current.ap)
+		mbpi_ap_free(b.current.ap);
+
+	g_free(b.provider_name);
+	g_ptr_array_free(b.sids, TRUE);
+	g_hash_table_destroy(b.cdma);
+	g_ptr_array_free(b.network_ids, TRUE);
+	g_hash_table_destroy(b.gsm);
+	g_ptr_array_free(b.apns, TRUE);
+	g_ptr_array_free(b.stack, TRUE);
+
+	return out;
+}
+
+static void mbpi_index_free(struct mbpi_index *index)
+{
+	if (index->mapped)
+		munmap(index->data, index->size);
+	else
+		g_free(index->data);
+
+	g_free(index);
+}
+
+/* Takes count entries off the bytes left, without overflowing */
+static gboolean index_section(size_t *left, uint32_t count, size_t size)
+{
+	if (count > *left / size)
+		return FALSE;
+
+	*left -= count * size;
+
+	return TRUE;
+}
+
+static struct mbpi_index *mbpi_index_new(void *data, size_t size,
+						gboolean mapped,
+						const struct stat *st)
+{
+	const struct mbpi_index_hdr *hdr = data;
+	struct mbpi_index *index;
+	size_t left;
+	const uint8_t *p;
+
+	if (size < sizeof(*hdr) || hdr->magic != MBPI_INDEX_MAGIC ||
+			hdr->version != MBPI_INDEX_VERSION ||
+			hdr->db_mtime != (uint64_t) st->st_mtime ||
+			hdr->db_size != (uint64_t) st->st_size)
+		goto fail;
+
+	left = size - sizeof(*hdr);
+
+	if (!index_section(&left, hdr->n_gsm,
+				sizeof(struct mbpi_index_gsm)) ||
+			!index_section(&left, hdr->n_refs, sizeof(uint32_t)) ||
+			!index_section(&left, hdr->n_apns,
+				sizeof(struct mbpi_index_apn)) ||
+			!index_section(&left, hdr->n_cdma,
+				sizeof(struct mbpi_index_cdma)) ||
+			left != hdr->strings_len)
+		goto fail;
+
+	index = g_new0(struct mbpi_index, 1);
+	index->data = data;
+	index->size = size;
+	index->mapped = mapped;
+	index->hdr = hdr;
+
+	p = (const uint8_t *) (hdr + 1);
+	index->gsm = (const struct mbpi_index_gsm *) p;
+	p += hdr->n_gsm * sizeof(struct mbpi_index_gsm);
+	index->refs = (const uint32_t *) p;
+	p += hdr->n_refs * sizeof(uint32_t);
+	index->apns = (const struct mbpi_index_apn *) p;
+	p += hdr->n_apns * sizeof(struct mbpi_index_apn);
+	index->cdma = (const struct mbpi_index_cdma *) p;
+	p += hdr->n_cdma * sizeof(struct mbpi_index_cdma);
+	index->strings = (const char *) p;
+
+	/* Keep string lookups from running off the end */
+	if (hdr->strings_len > 0 && index->strings[hdr->strings_len - 1]) {
+		index->data = NULL;
+		g_free(index);
+		goto fail;
+	}
+
+	return index;
+
+fail:
+	if (mapped)
+		munmap(data, size);
+	else
+		g_free(data);
+
+	return NULL;
+}
+
+static struct mbpi_index *mbpi_index_map(const struct stat *st)
+{
+	struct stat ist;
+	void *data;
+	int fd;
+
+	fd = open(MBPI_INDEX, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &ist) < 0 || ist.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, ist.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	return mbpi_index_new(data, ist.st_size, TRUE, st);
+}
+
+/*
+ * Returns the index for the current database, building and caching it
+ * if needed, or NULL if lookups have to fall back to parsing the XML.
+ */
+static struct mbpi_index *mbpi_index_get(void)
+{
+	struct stat st;
+	GByteArray *built;
+	size_t size;
+	char *dir;
+
+	if (stat(MBPI_DATABASE, &st) < 0)
+		return NULL;
+
+	if (index_cache) {
+		if (index_cache->hdr->db_mtime == (uint64_t) st.st_mtime &&
+				index_cache->hdr->db_size ==
+						(uint64_t) st.st_size)
+			return index_cache;
+
+		mbpi_index_free(index_cache);
+		index_cache = NULL;
+	}
+
+	/* Don't retry building from a database that failed to parse */
+	if (index_failed_st.st_mtime == st.st_mtime &&
+			index_failed_st.st_size == st.st_size)
+		return NULL;
+
+	index_cache = mbpi_index_map(&st);
+	if (index_cache)
+		return index_cache;
+
+	built = mbpi_index_build(&st, NULL);
+	if (built == NULL) {
+		index_failed_st = st;
+		return NULL;
+	}
+
+	/* Not being able to cache it only costs the next process a parse */
+	dir = g_path_get_dirname(MBPI_INDEX);
+
+	if (g_mkdir_with_parents(dir, 0700) == 0)
+		g_file_set_contents(MBPI_INDEX, (const char *) built->data,
+					built->len, NULL);
+
+	g_free(dir);
+
+	size = built->len;
+	index_cache = mbpi_index_new(g_byte_array_free(built, FALSE), size,
+					FALSE, &st);
+
+	return index_cache;
+}
+
+static const char *index_string(const struct mbpi_index *index,
+				uint32_t offset)
+{
+	if (offset == MBPI_INDEX_NONE || offset >= index->hdr->strings_len)
+		return NULL;
+
+	return index->strings + offset;
+}
+
+static int compare_gsm(const char *mcc, const char *mnc,
+			const struct mbpi_index_gsm *gsm)
+{
+	int r = strncmp(mcc, gsm->mcc, sizeof(gsm->mcc));
+
+	if (r != 0)
+		return r;
+
+	return strncmp(mnc, gsm->mnc, sizeof(gsm->mnc));
+}
+
+static GSList *index_lookup_apn(const struct mbpi_index *index,
+				const char *mcc, const char *mnc,
+				gboolean allow_duplicates, GError **error)
+{
+	const struct mbpi_index_gsm *gsm = NULL;
+	uint32_t lo = 0, hi = index->hdr->n_gsm;
+	GSList *apns = NULL;
+	GSList *l;
+	uint32_t i;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int r = compare_gsm(mcc, mnc, &index->gsm[mid]);
+
+		if (r == 0) {
+			gsm = &index->gsm[mid];
+			break;
+		}
+
+		if (r < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	if (gsm == NULL || gsm->first_ref + (uint64_t) gsm->n_refs >
+						index->hdr->n_refs)
+		return NULL;
+
+	for (i = 0; i < gsm->n_refs; i++) {
+		uint32_t ref = index->refs[gsm->first_ref + i];
+		const struct mbpi_index_apn *apn;
+		struct ofono_gprs_provision_data *ap;
+
+		if (ref >= index->hdr->n_apns)
+			continue;
+
+		apn = &index->apns[ref];
+
+		if (allow_duplicates == FALSE) {
+			for (l = apns; l; l = l->next) {
+				struct ofono_gprs_provision_data *pd = l->data;
+
+				if (pd->type == apn->type)
+					break;
+			}
+
+			if (l != NULL) {
+				g_set_error(error, mbpi_error_quark(),
+						MBPI_ERROR_DUPLICATE,
+						"%s: Duplicate context detected",
+						MBPI_DATABASE);
+				g_slist_free_full(apns, free_ap);
+				return NULL;
+			}
+		}
+
+		ap = g_new0(struct ofono_gprs_provision_data, 1);
+		ap->name = g_strdup(index_string(index, apn->name));
+		ap->apn = g_strdup(index_string(index, apn->apn));
+		ap->username = g_strdup(index_string(index, apn->username));
+		ap->password = g_strdup(index_string(index, apn->password));
+		ap->message_center = g_strdup(index_string(index,
+							apn->message_center));
+		ap->message_proxy = g_strdup(index_string(index,
+							apn->message_proxy));
+		ap->type = apn->type;
+		ap->proto = OFONO_GPRS_PROTO_IP;
+		ap->auth_method = apn->auth_method;
+
+		apns = g_slist_prepend(apns, ap);
+	}
+
+	return g_slist_reverse(apns);
+}
+
+static char *index_lookup_cdma_provider_name(const struct mbpi_index *index,
+						const char *sid)
+{
+	uint32_t lo = 0, hi = index->hdr->n_cdma;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		const char *s = index_string(index, index->cdma[mid].sid);
+		int r = strcmp(sid, s ? s : "");
+
+		if (r == 0)
+			return g_strdup(index_string(index,
+						index->cdma[mid].name));
+
+		if (r < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+static GSList *parse_lookup_apn(const char *mcc, const char *mnc,
+				gboolean allow_duplicates, GError **error)
 {
 	struct gsm_data gsm;
 	GSList *l;
@@ -635,7 +1400,7 @@ GSList *mbpi_lookup_apn(const char *mcc, const char *mnc,
 	return gsm.apns;
 }
 
-char *mbpi_lookup_cdma_provider_name(const char *sid, GError **error)
+static char *parse_lookup_cdma_provider_name(const char *sid, GError **error)
 {
 	struct cdma_data cdma;
 
@@ -649,3 +1414,27 @@ char *mbpi_lookup_cdma_provider_name(const char *sid, GError **error)
 
 	return cdma.provider_name;
 }
+
+GSList *mbpi_lookup_apn(const char *mcc, const char *mnc,
+			gboolean allow_duplicates, GError **error)
+{
+	struct mbpi_index *index;
+
+	index = mbpi_index_get();
+	if (index)
+		return index_lookup_apn(index, mcc, mnc, allow_duplicates,
+					error);
+
+	return parse_lookup_apn(mcc, mnc, allow_duplicates, error);
+}
+
+char *mbpi_lookup_cdma_provider_name(const char *sid, GError **error)
+{
+	struct mbpi_index *index;
+
+	index = mbpi_index_get();
+	if (index)
+		return index_lookup_cdma_provider_name(index, sid);
+
+	return parse_lookup_cdma_provider_name(sid, error);
+}
@@ -559,5 +559,5 @@ static void n900_exit(void)
 	ofono_modem_driver_unregister(&n900_driver);
 }
 
-OFONO_PLUGIN_DEFINE(n900, "Nokia N900 modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(n900, "Nokia N900 modem driver", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT, n900_init, n900_exit)
@@ -256,5 +256,5 @@ static void nokia_exit(void)
 	ofono_modem_driver_unregister(&nokia_driver);
 }
 
-OFONO_PLUGIN_DEFINE(nokia, "Nokia Datacard modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(nokia, "Nokia Datacard modem driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, nokia_init, nokia_exit)
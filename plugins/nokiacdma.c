@@ -182,6 +182,6 @@ static void nokiacdma_exit(void)
 	ofono_modem_driver_unregister(&nokiacdma_driver);
 }
 
-OFONO_PLUGIN_DEFINE(nokiacdma, "Nokia CDMA AT Modem", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(nokiacdma, "Nokia CDMA AT Modem", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT,
 			nokiacdma_init, nokiacdma_exit)
@@ -349,5 +349,6 @@ static void novatel_exit(void)
 	ofono_modem_driver_unregister(&novatel_driver);
 }
 
-OFONO_PLUGIN_DEFINE(novatel, "Novatel Wireless modem driver", VERSION,
-		OFONO_PLUGIN_PRIORITY_DEFAULT, novatel_init, novatel_exit)
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(novatel, "Novatel Wireless modem driver",
+		VERSION, OFONO_PLUGIN_PRIORITY_DEFAULT,
+		novatel_init, novatel_exit)
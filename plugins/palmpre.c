@@ -230,5 +230,5 @@ static void palmpre_exit(void)
 	ofono_modem_driver_unregister(&palmpre_driver);
 }
 
-OFONO_PLUGIN_DEFINE(palmpre, "Palm Pre driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(palmpre, "Palm Pre driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, palmpre_init, palmpre_exit)
@@ -1059,5 +1059,5 @@ static void quectel_exit(void)
 	ofono_modem_driver_unregister(&quectel_driver);
 }
 
-OFONO_PLUGIN_DEFINE(quectel, "Quectel driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(quectel, "Quectel driver", VERSION,
     OFONO_PLUGIN_PRIORITY_DEFAULT, quectel_init, quectel_exit)
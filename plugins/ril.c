@@ -57,6 +57,7 @@
 #include <ofono/types.h>
 
 #include <gril/gril.h>
+#include <gril/grilutil.h>
 
 #include "ofono.h"
 
@@ -73,6 +74,9 @@
 #define RILD_MAX_CONNECT_RETRIES 5
 #define RILD_CONNECT_RETRY_TIME_S 5
 
+/* Size of the binary RIL trace kept when OFONO_RIL_TRACE_RING is set */
+#define RIL_TRACE_RING_SIZE (256 * 1024)
+
 char *RILD_CMD_SOCKET[] = {"/dev/socket/rild", "/dev/socket/rild1"};
 char *GRIL_HEX_PREFIX[] = {"Device 0: ", "Device 1: "};
 
@@ -95,6 +99,14 @@ static void ril_debug(const char *str, void *user_data)
 	ofono_info("%s%s", prefix, str);
 }
 
+static void ril_latency(int req, int error, guint usec, gpointer user_data)
+{
+	struct ofono_modem *modem = user_data;
+
+	ofono_modem_record_latency(modem, "ril", ril_request_id_to_string(req),
+					usec, error == RIL_E_SUCCESS);
+}
+
 static void ril_radio_state_changed(struct ril_msg *message, gpointer user_data)
 {
 	struct ofono_modem *modem = user_data;
@@ -340,6 +352,7 @@ static int create_gril(struct ofono_modem *modem)
 {
 	struct ril_data *rd = ofono_modem_get_data(modem);
 	int slot_id = ofono_modem_get_integer(modem, "Slot");
+	const char *trace_ring;
 
 	ofono_info("Using %s as socket for slot %d.",
 					RILD_CMD_SOCKET[slot_id], slot_id);
@@ -369,6 +382,16 @@ static int create_gril(struct ofono_modem *modem)
 	if (getenv("OFONO_RIL_HEX_TRACE"))
 		g_ril_set_debugf(rd->ril, ril_debug, GRIL_HEX_PREFIX[slot_id]);
 
+	trace_ring = getenv("OFONO_RIL_TRACE_RING");
+	if (trace_ring) {
+		char *path = g_strdup_printf("%s.%d", trace_ring, slot_id);
+
+		g_ril_set_trace_ring(rd->ril, RIL_TRACE_RING_SIZE, path);
+		g_free(path);
+	}
+
+	g_ril_set_latency(rd->ril, ril_latency, modem);
+
 	g_ril_register(rd->ril, RIL_UNSOL_RIL_CONNECTED,
 			ril_connected, modem);
 
@@ -469,5 +492,5 @@ static void ril_exit(void)
 	ofono_modem_driver_unregister(&ril_driver);
 }
 
-OFONO_PLUGIN_DEFINE(ril, "RIL modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(ril, "RIL modem driver", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT, ril_init, ril_exit)
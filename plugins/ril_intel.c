@@ -620,5 +620,6 @@ static void ril_exit(void)
 	ofono_modem_driver_unregister(&ril_driver);
 }
 
-OFONO_PLUGIN_DEFINE(ril_intel, "Intel RIL-based modem driver", VERSION,
-			OFONO_PLUGIN_PRIORITY_DEFAULT, ril_init, ril_exit)
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(ril_intel, "Intel RIL-based modem driver",
+			VERSION, OFONO_PLUGIN_PRIORITY_DEFAULT,
+			ril_init, ril_exit)
@@ -254,5 +254,5 @@ static void samsung_exit(void)
 	ofono_modem_driver_unregister(&samsung_driver);
 }
 
-OFONO_PLUGIN_DEFINE(samsung, "Samsung modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(samsung, "Samsung modem driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, samsung_init, samsung_exit)
@@ -340,5 +340,5 @@ static void samsungipc_exit(void)
 	ofono_modem_driver_unregister(&samsungipc_driver);
 }
 
-OFONO_PLUGIN_DEFINE(samsungipc, "Samsung IPC driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(samsungipc, "Samsung IPC driver", VERSION,
 	OFONO_PLUGIN_PRIORITY_DEFAULT, samsungipc_init, samsungipc_exit)
@@ -269,5 +269,6 @@ static void sim7100_exit(void)
 	ofono_modem_driver_unregister(&sim7100_driver);
 }
 
-OFONO_PLUGIN_DEFINE(sim7100, "SIMCom SIM7100E modem driver", VERSION,
-		OFONO_PLUGIN_PRIORITY_DEFAULT, sim7100_init, sim7100_exit)
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(sim7100, "SIMCom SIM7100E modem driver",
+		VERSION, OFONO_PLUGIN_PRIORITY_DEFAULT,
+		sim7100_init, sim7100_exit)
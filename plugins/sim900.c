@@ -471,5 +471,5 @@ static void sim900_exit(void)
 	ofono_modem_driver_unregister(&sim900_driver);
 }
 
-OFONO_PLUGIN_DEFINE(sim900, "SIM900 modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(sim900, "SIM900 modem driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, sim900_init, sim900_exit)
@@ -216,6 +216,6 @@ static void speedupcdma_exit(void)
 	ofono_modem_driver_unregister(&speedupcdma_driver);
 }
 
-OFONO_PLUGIN_DEFINE(speedupcdma, "Speed Up CDMA modem driver", VERSION,
-				OFONO_PLUGIN_PRIORITY_DEFAULT,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(speedupcdma, "Speed Up CDMA modem driver",
+				VERSION, OFONO_PLUGIN_PRIORITY_DEFAULT,
 				speedupcdma_init, speedupcdma_exit)
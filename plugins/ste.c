@@ -528,5 +528,5 @@ static void ste_exit(void)
 	ofono_modem_driver_unregister(&ste_driver);
 }
 
-OFONO_PLUGIN_DEFINE(ste, "ST-Ericsson modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(ste, "ST-Ericsson modem driver", VERSION,
 			OFONO_PLUGIN_PRIORITY_DEFAULT, ste_init, ste_exit)
@@ -529,5 +529,5 @@ static void telit_exit(void)
 	ofono_modem_driver_unregister(&telit_driver);
 }
 
-OFONO_PLUGIN_DEFINE(telit, "Telit driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(telit, "Telit driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, telit_init, telit_exit)
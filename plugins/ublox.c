@@ -434,5 +434,5 @@ static void ublox_exit(void)
 	ofono_modem_driver_unregister(&ublox_driver);
 }
 
-OFONO_PLUGIN_DEFINE(ublox, "u-blox modem driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(ublox, "u-blox modem driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, ublox_init, ublox_exit)
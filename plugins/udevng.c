@@ -56,6 +56,7 @@ struct modem_info {
 	};
 	struct ofono_modem *modem;
 	const char *sysattr;
+	gboolean dirty;
 };
 
 struct device_info {
@@ -1391,7 +1392,9 @@ static struct {
 	{ }
 };
 
-static GHashTable *modem_list;
+static GHashTable *modem_list;		/* syspath -> modem_info */
+static GHashTable *device_list;		/* devpath -> modem_info */
+static GSList *dirty_list;
 
 static const char *get_sysattr(const char *driver)
 {
@@ -1417,6 +1420,15 @@ static void device_info_free(struct device_info* info)
 	g_free(info);
 }
 
+static void modem_set_dirty(struct modem_info *modem)
+{
+	if (modem->dirty == TRUE)
+		return;
+
+	modem->dirty = TRUE;
+	dirty_list = g_slist_prepend(dirty_list, modem);
+}
+
 static void serial_device_info_free(struct serial_device_info* info)
 {
 	g_free(info->devpath);
@@ -1435,18 +1447,26 @@ static void destroy_modem(gpointer data)
 
 	ofono_modem_remove(modem->modem);
 
+	if (modem->dirty == TRUE)
+		dirty_list = g_slist_remove(dirty_list, modem);
+
 	switch (modem->type) {
 	case MODEM_TYPE_USB:
 		for (list = modem->devices; list; list = list->next) {
 			struct device_info *info = list->data;
 
 			DBG("%s", info->devnode);
+			g_hash_table_remove(device_list, info->devpath);
 			device_info_free(info);
 		}
 
 		g_slist_free(modem->devices);
 		break;
 	case MODEM_TYPE_SERIAL:
+		if (modem->serial == NULL)
+			break;
+
+		g_hash_table_remove(device_list, modem->serial->devpath);
 		serial_device_info_free(modem->serial);
 		break;
 	}
@@ -1459,32 +1479,9 @@ static void destroy_modem(gpointer data)
 	g_free(modem);
 }
 
-static gboolean check_remove(gpointer key, gpointer value, gpointer user_data)
-{
-	struct modem_info *modem = value;
-	const char *devpath = user_data;
-	GSList *list;
-
-	switch (modem->type) {
-	case MODEM_TYPE_USB:
-		for (list = modem->devices; list; list = list->next) {
-			struct device_info *info = list->data;
-
-			if (g_strcmp0(info->devpath, devpath) == 0)
-				return TRUE;
-		}
-		break;
-	case MODEM_TYPE_SERIAL:
-		if (g_strcmp0(modem->serial->devpath, devpath) == 0)
-			return TRUE;
-		break;
-	}
-
-	return FALSE;
-}
-
 static void remove_device(struct udev_device *device)
 {
+	struct modem_info *modem;
 	const char *syspath;
 
 	syspath = udev_device_get_syspath(device);
@@ -1493,8 +1490,11 @@ static void remove_device(struct udev_device *device)
 
 	DBG("%s", syspath);
 
-	g_hash_table_foreach_remove(modem_list, check_remove,
-						(char *) syspath);
+	modem = g_hash_table_lookup(device_list, syspath);
+	if (modem == NULL)
+		return;
+
+	g_hash_table_remove(modem_list, modem->syspath);
 }
 
 static gint compare_device(gconstpointer a, gconstpointer b)
@@ -1579,6 +1579,12 @@ static void add_serial_device(struct udev_device *dev)
 		g_hash_table_replace(modem_list, modem->syspath, modem);
 	}
 
+	if (modem->serial != NULL) {
+		g_hash_table_remove(device_list, modem->serial->devpath);
+		serial_device_info_free(modem->serial);
+		modem->serial = NULL;
+	}
+
 	subsystem = udev_device_get_subsystem(dev);
 
 	DBG("%s", syspath);
@@ -1595,6 +1601,9 @@ static void add_serial_device(struct udev_device *dev)
 	info->dev = udev_device_ref(dev);
 
 	modem->serial = info;
+
+	g_hash_table_replace(device_list, info->devpath, modem);
+	modem_set_dirty(modem);
 }
 
 static void add_device(const char *syspath, const char *devname,
@@ -1612,6 +1621,9 @@ static void add_device(const char *syspath, const char *devname,
 	if (devpath == NULL)
 		return;
 
+	if (g_hash_table_contains(device_list, devpath) == TRUE)
+		return;
+
 	devnode = udev_device_get_devnode(device);
 	if (devnode == NULL) {
 		devnode = udev_device_get_property_value(device, "INTERFACE");
@@ -1688,6 +1700,9 @@ static void add_device(const char *syspath, const char *devname,
 
 	modem->devices = g_slist_insert_sorted(modem->devices, info,
 							compare_device);
+
+	g_hash_table_replace(device_list, info->devpath, modem);
+	modem_set_dirty(modem);
 }
 
 static struct {
@@ -1780,6 +1795,7 @@ static void check_usb_device(struct udev_device *device)
 	struct udev_device *usb_device;
 	const char *syspath, *devname, *driver;
 	const char *vendor = NULL, *model = NULL;
+	struct modem_info *modem;
 
 	usb_device = udev_device_get_parent_with_subsystem_devtype(device,
 							"usb", "usb_device");
@@ -1790,6 +1806,11 @@ static void check_usb_device(struct udev_device *device)
 	if (syspath == NULL)
 		return;
 
+	/* Interfaces showing up after the modem was created are unused */
+	modem = g_hash_table_lookup(modem_list, syspath);
+	if (modem != NULL && modem->modem != NULL)
+		return;
+
 	devname = udev_device_get_devnode(usb_device);
 	if (devname == NULL)
 		return;
@@ -1877,10 +1898,9 @@ static void check_device(struct udev_device *device)
 
 }
 
-static gboolean create_modem(gpointer key, gpointer value, gpointer user_data)
+static gboolean create_modem(struct modem_info *modem)
 {
-	struct modem_info *modem = value;
-	const char *syspath = key;
+	const char *syspath = modem->syspath;
 	unsigned int i;
 
 	if (modem->modem != NULL)
@@ -1916,6 +1936,20 @@ static gboolean create_modem(gpointer key, gpointer value, gpointer user_data)
 	return TRUE;
 }
 
+/* Only modems which gained devices since the last pass are looked at */
+static void create_dirty_modems(void)
+{
+	while (dirty_list) {
+		struct modem_info *modem = dirty_list->data;
+
+		dirty_list = g_slist_delete_link(dirty_list, dirty_list);
+		modem->dirty = FALSE;
+
+		if (create_modem(modem) == TRUE)
+			g_hash_table_remove(modem_list, modem->syspath);
+	}
+}
+
 static void enumerate_devices(struct udev *context)
 {
 	struct udev_enumerate *enumerate;
@@ -1951,13 +1985,14 @@ static void enumerate_devices(struct udev *context)
 
 	udev_enumerate_unref(enumerate);
 
-	g_hash_table_foreach_remove(modem_list, create_modem, NULL);
+	create_dirty_modems();
 }
 
 static struct udev *udev_ctx;
 static struct udev_monitor *udev_mon;
 static guint udev_watch = 0;
 static guint udev_delay = 0;
+static guint udev_scan = 0;
 
 static gboolean check_modem_list(gpointer user_data)
 {
@@ -1965,7 +2000,16 @@ static gboolean check_modem_list(gpointer user_data)
 
 	DBG("");
 
-	g_hash_table_foreach_remove(modem_list, create_modem, NULL);
+	create_dirty_modems();
+
+	return FALSE;
+}
+
+static gboolean enumerate_idle(gpointer user_data)
+{
+	udev_scan = 0;
+
+	enumerate_devices(udev_ctx);
 
 	return FALSE;
 }
@@ -1991,12 +2035,15 @@ static gboolean udev_event(GIOChannel *channel, GIOCondition cond,
 		return TRUE;
 
 	if (g_str_equal(action, "add") == TRUE) {
-		if (udev_delay > 0)
-			g_source_remove(udev_delay);
-
 		check_device(device);
 
-		udev_delay = g_timeout_add_seconds(1, check_modem_list, NULL);
+		if (dirty_list != NULL) {
+			if (udev_delay > 0)
+				g_source_remove(udev_delay);
+
+			udev_delay = g_timeout_add_seconds(1,
+							check_modem_list, NULL);
+		}
 	} else if (g_str_equal(action, "remove") == TRUE)
 		remove_device(device);
 
@@ -2017,8 +2064,6 @@ static void udev_start(void)
 		return;
 	}
 
-	enumerate_devices(udev_ctx);
-
 	fd = udev_monitor_get_fd(udev_mon);
 
 	channel = g_io_channel_unix_new(fd);
@@ -2030,6 +2075,12 @@ static void udev_start(void)
 							udev_event, NULL);
 
 	g_io_channel_unref(channel);
+
+	/*
+	 * Scan for devices present at startup once the main loop runs,
+	 * so the remaining plugins are not held up by the enumeration.
+	 */
+	udev_scan = g_idle_add(enumerate_idle, NULL);
 }
 
 static int detect_init(void)
@@ -2050,6 +2101,7 @@ static int detect_init(void)
 
 	modem_list = g_hash_table_new_full(g_str_hash, g_str_equal,
 						NULL, destroy_modem);
+	device_list = g_hash_table_new(g_str_hash, g_str_equal);
 
 	udev_monitor_filter_add_match_subsystem_devtype(udev_mon, "tty", NULL);
 	udev_monitor_filter_add_match_subsystem_devtype(udev_mon, "usb", NULL);
@@ -2067,6 +2119,9 @@ static int detect_init(void)
 
 static void detect_exit(void)
 {
+	if (udev_scan > 0)
+		g_source_remove(udev_scan);
+
 	if (udev_delay > 0)
 		g_source_remove(udev_delay);
 
@@ -2079,6 +2134,7 @@ static void detect_exit(void)
 	udev_monitor_filter_remove(udev_mon);
 
 	g_hash_table_destroy(modem_list);
+	g_hash_table_destroy(device_list);
 
 	udev_monitor_unref(udev_mon);
 	udev_unref(udev_ctx);
@@ -1336,5 +1336,5 @@ static void xmm7xxx_exit(void)
 	ofono_modem_driver_unregister(&xmm7xxx_driver);
 }
 
-OFONO_PLUGIN_DEFINE(xmm7xxx, "Intel XMM7xxx driver", VERSION,
+OFONO_MODEM_DRIVER_PLUGIN_DEFINE(xmm7xxx, "Intel XMM7xxx driver", VERSION,
 		OFONO_PLUGIN_PRIORITY_DEFAULT, xmm7xxx_init, xmm7xxx_exit)
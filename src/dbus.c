@@ -23,6 +23,7 @@
 #include <config.h>
 #endif
 
+#include <string.h>
 #include <glib.h>
 #include <errno.h>
 #include <gdbus.h>
@@ -31,8 +32,68 @@
 
 #define OFONO_ERROR_INTERFACE "org.ofono.Error"
 
+#define STRENGTH_INTERVAL	5000	/* In milliseconds */
+
 static DBusConnection *g_connection;
 
+/*
+ * PropertyChanged signals of basic types are not sent right away but
+ * queued per object, interface and property.  Further changes of the same
+ * property before the queue is flushed only replace the value, so clients
+ * see the latest state once.  The queue is flushed when the main loop goes
+ * idle, or after the coalescing window if one is set, and the signal
+ * strength properties are additionally limited to one signal per
+ * interval.  Any other message for an object flushes its queued changes
+ * first, so the order seen by clients is kept.
+ */
+struct property_rate_limit {
+	const char *interface;
+	const char *name;
+};
+
+static const struct property_rate_limit rate_limits[] = {
+	{ OFONO_NETWORK_REGISTRATION_INTERFACE,		"Strength"	},
+	{ OFONO_CDMA_NETWORK_REGISTRATION_INTERFACE,	"Strength"	},
+	{ OFONO_CDMA_NETWORK_REGISTRATION_INTERFACE,	"DataStrength"	},
+	{ }
+};
+
+static unsigned int strength_interval = STRENGTH_INTERVAL;
+
+union property_value {
+	dbus_bool_t bool_val;
+	unsigned char byte_val;
+	dbus_int16_t i16;
+	dbus_uint16_t u16;
+	dbus_int32_t i32;
+	dbus_uint32_t u32;
+	dbus_int64_t i64;
+	dbus_uint64_t u64;
+	double dbl;
+	char *str;
+};
+
+struct property_signal {
+	char *key;
+	char *path;
+	char *interface;
+	char *name;
+	int type;
+	union property_value value;
+	gboolean pending;
+	unsigned int interval;
+	gint64 deadline;		/* Monotonic, in microseconds */
+	gint64 last_emit;
+};
+
+static GHashTable *signal_table;
+static GQueue signal_queue = G_QUEUE_INIT;
+static guint signal_source;
+static gint64 signal_flush_at;
+static unsigned int signal_window;
+static struct ofono_dbus_signal_stats signal_stats;
+static gboolean signal_flushing;
+
 struct error_mapping_entry {
 	int error;
 	DBusMessage *(*ofono_error_func)(DBusMessage *);
@@ -209,8 +270,7 @@ void ofono_dbus_dict_append_dict(DBusMessageIter *dict, const char *key,
 	dbus_message_iter_close_container(dict, &entry);
 }
 
-int ofono_dbus_signal_property_changed(DBusConnection *conn,
-					const char *path,
+static int send_property_changed(DBusConnection *conn, const char *path,
 					const char *interface,
 					const char *name,
 					int type, const void *value)
@@ -234,6 +294,316 @@ int ofono_dbus_signal_property_changed(DBusConnection *conn,
 	return g_dbus_send_message(conn, signal);
 }
 
+static size_t property_value_size(int type)
+{
+	switch (type) {
+	case DBUS_TYPE_BOOLEAN:
+		return sizeof(dbus_bool_t);
+	case DBUS_TYPE_BYTE:
+		return sizeof(unsigned char);
+	case DBUS_TYPE_INT16:
+	case DBUS_TYPE_UINT16:
+		return sizeof(dbus_uint16_t);
+	case DBUS_TYPE_INT32:
+	case DBUS_TYPE_UINT32:
+		return sizeof(dbus_uint32_t);
+	case DBUS_TYPE_INT64:
+	case DBUS_TYPE_UINT64:
+		return sizeof(dbus_uint64_t);
+	case DBUS_TYPE_DOUBLE:
+		return sizeof(double);
+	}
+
+	return 0;
+}
+
+static void property_value_clear(struct property_signal *ps)
+{
+	if (ps->type == DBUS_TYPE_STRING || ps->type == DBUS_TYPE_OBJECT_PATH)
+		g_free(ps->value.str);
+
+	memset(&ps->value, 0, sizeof(ps->value));
+}
+
+static void property_value_set(struct property_signal *ps, int type,
+				const void *value)
+{
+	property_value_clear(ps);
+	ps->type = type;
+
+	if (type == DBUS_TYPE_STRING || type == DBUS_TYPE_OBJECT_PATH)
+		ps->value.str = g_strdup(*(const char **) value);
+	else
+		memcpy(&ps->value, value, property_value_size(type));
+}
+
+static unsigned int rate_limit_lookup(const char *interface, const char *name)
+{
+	const struct property_rate_limit *rl;
+
+	for (rl = rate_limits; rl->interface; rl++) {
+		if (g_str_equal(rl->interface, interface) &&
+				g_str_equal(rl->name, name))
+			return strength_interval;
+	}
+
+	return 0;
+}
+
+static void property_signal_free(gpointer data)
+{
+	struct property_signal *ps = data;
+
+	property_value_clear(ps);
+	g_free(ps->key);
+	g_free(ps->path);
+	g_free(ps->interface);
+	g_free(ps->name);
+	g_free(ps);
+}
+
+static gboolean property_signal_expired(gpointer key, gpointer value,
+						gpointer user_data)
+{
+	struct property_signal *ps = value;
+	gint64 now = *(gint64 *) user_data;
+
+	if (ps->pending)
+		return FALSE;
+
+	return ps->last_emit + ps->interval * 1000LL <= now;
+}
+
+static void signal_schedule(gint64 deadline, gint64 now);
+
+static void signal_emit(struct property_signal *ps, gint64 now)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+
+	g_queue_remove(&signal_queue, ps);
+
+	send_property_changed(conn, ps->path, ps->interface, ps->name,
+					ps->type, &ps->value);
+	signal_stats.emitted += 1;
+
+	ps->pending = FALSE;
+	ps->last_emit = now;
+	property_value_clear(ps);
+}
+
+static gboolean path_is_below(const char *path, const char *prefix)
+{
+	size_t len = strlen(prefix);
+
+	if (strncmp(path, prefix, len))
+		return FALSE;
+
+	return path[len] == '\0' || path[len] == '/' || prefix[len - 1] == '/';
+}
+
+static gboolean property_signal_match(struct property_signal *ps,
+					const char *path, const char *interface)
+{
+	return g_str_equal(ps->path, path) &&
+			g_str_equal(ps->interface, interface);
+}
+
+static gboolean property_signal_removed(gpointer key, gpointer value,
+						gpointer user_data)
+{
+	struct property_signal *ps = value;
+	struct property_signal *match = user_data;
+
+	if (ps->pending)
+		return FALSE;
+
+	return property_signal_match(ps, match->path, match->interface);
+}
+
+/*
+ * Called before anything else is sent, so queued changes of the object
+ * and of the objects below it reach clients first.  Messages without a
+ * path, such as method replies, flush the whole queue.  Properties still
+ * held back by their rate limit stay queued.  When an interface is about
+ * to be removed, its queued properties are sent regardless.
+ */
+static void signal_flush_path(DBusConnection *conn, const char *path,
+						const char *interface)
+{
+	gint64 now = g_get_monotonic_time();
+	GList *l = signal_queue.head;
+
+	if (conn != ofono_dbus_get_connection() || signal_table == NULL ||
+			signal_flushing)
+		return;
+
+	signal_flushing = TRUE;
+
+	while (l) {
+		struct property_signal *ps = l->data;
+
+		l = l->next;
+
+		if (interface) {
+			if (!property_signal_match(ps, path, interface))
+				continue;
+		} else {
+			if (path && !path_is_below(ps->path, path))
+				continue;
+
+			if (ps->last_emit > 0 &&
+				ps->last_emit + ps->interval * 1000LL > now)
+				continue;
+		}
+
+		signal_emit(ps, now);
+	}
+
+	signal_flushing = FALSE;
+
+	/* A new instance of the interface starts without a rate limit */
+	if (interface) {
+		struct property_signal match = {
+			.path = (char *) path,
+			.interface = (char *) interface,
+		};
+
+		g_hash_table_foreach_remove(signal_table,
+					property_signal_removed, &match);
+	}
+}
+
+static void signal_flush(gboolean force)
+{
+	gint64 now = g_get_monotonic_time();
+	gint64 next = G_MAXINT64;
+	GList *l = signal_queue.head;
+
+	signal_flushing = TRUE;
+
+	while (l) {
+		struct property_signal *ps = l->data;
+
+		l = l->next;
+
+		if (!force && ps->deadline > now) {
+			next = MIN(next, ps->deadline);
+			continue;
+		}
+
+		signal_emit(ps, now);
+	}
+
+	signal_flushing = FALSE;
+
+	/* Only rate limited properties need to remember the last emission */
+	g_hash_table_foreach_remove(signal_table, property_signal_expired,
+					&now);
+
+	if (next != G_MAXINT64)
+		signal_schedule(next, now);
+}
+
+static gboolean signal_flush_cb(gpointer user_data)
+{
+	signal_source = 0;
+	signal_flush(FALSE);
+
+	return FALSE;
+}
+
+static void signal_schedule(gint64 deadline, gint64 now)
+{
+	if (signal_source > 0) {
+		if (signal_flush_at <= deadline)
+			return;
+
+		g_source_remove(signal_source);
+	}
+
+	signal_flush_at = deadline;
+
+	if (deadline <= now)
+		signal_source = g_idle_add(signal_flush_cb, NULL);
+	else
+		signal_source = g_timeout_add((deadline - now + 999) / 1000,
+						signal_flush_cb, NULL);
+}
+
+int ofono_dbus_signal_property_changed(DBusConnection *conn,
+					const char *path,
+					const char *interface,
+					const char *name,
+					int type, const void *value)
+{
+	struct property_signal *ps;
+	char *key;
+	gint64 now;
+
+	if (signal_table == NULL || conn != ofono_dbus_get_connection())
+		return send_property_changed(conn, path, interface, name,
+						type, value);
+
+	if (type != DBUS_TYPE_STRING && type != DBUS_TYPE_OBJECT_PATH &&
+			property_value_size(type) == 0)
+		return send_property_changed(conn, path, interface, name,
+						type, value);
+
+	key = g_strconcat(path, " ", interface, " ", name, NULL);
+
+	ps = g_hash_table_lookup(signal_table, key);
+	if (ps == NULL) {
+		ps = g_new0(struct property_signal, 1);
+		ps->key = key;
+		ps->path = g_strdup(path);
+		ps->interface = g_strdup(interface);
+		ps->name = g_strdup(name);
+		ps->interval = rate_limit_lookup(interface, name);
+
+		g_hash_table_insert(signal_table, ps->key, ps);
+	} else
+		g_free(key);
+
+	property_value_set(ps, type, value);
+	signal_stats.queued += 1;
+
+	if (ps->pending) {
+		signal_stats.coalesced += 1;
+		return 0;
+	}
+
+	now = g_get_monotonic_time();
+
+	ps->pending = TRUE;
+	ps->deadline = now + signal_window * 1000LL;
+
+	if (ps->last_emit > 0 &&
+			ps->last_emit + ps->interval * 1000LL > ps->deadline) {
+		ps->deadline = ps->last_emit + ps->interval * 1000LL;
+		signal_stats.rate_limited += 1;
+	}
+
+	g_queue_push_tail(&signal_queue, ps);
+	signal_schedule(ps->deadline, now);
+
+	return 0;
+}
+
+void __ofono_dbus_set_signal_window(unsigned int msecs)
+{
+	signal_window = msecs;
+}
+
+void __ofono_dbus_set_strength_interval(unsigned int msecs)
+{
+	strength_interval = msecs;
+}
+
+void __ofono_dbus_get_signal_stats(struct ofono_dbus_signal_stats *stats)
+{
+	*stats = signal_stats;
+}
+
 int ofono_dbus_signal_array_property_changed(DBusConnection *conn,
 						const char *path,
 						const char *interface,
@@ -489,6 +859,10 @@ int __ofono_dbus_init(DBusConnection *conn)
 {
 	dbus_gsm_set_connection(conn);
 
+	signal_table = g_hash_table_new_full(g_str_hash, g_str_equal,
+						NULL, property_signal_free);
+	g_dbus_set_flush_function(signal_flush_path);
+
 	return 0;
 }
 
@@ -496,6 +870,26 @@ void __ofono_dbus_cleanup(void)
 {
 	DBusConnection *conn = ofono_dbus_get_connection();
 
+	if (signal_table != NULL) {
+		if (signal_source > 0) {
+			g_source_remove(signal_source);
+			signal_source = 0;
+		}
+
+		if (conn != NULL && dbus_connection_get_is_connected(conn))
+			signal_flush(TRUE);
+
+		g_dbus_set_flush_function(NULL);
+		g_queue_clear(&signal_queue);
+		g_hash_table_destroy(signal_table);
+		signal_table = NULL;
+
+		DBG("PropertyChanged queued %u coalesced %u rate limited %u "
+			"emitted %u", signal_stats.queued,
+			signal_stats.coalesced, signal_stats.rate_limited,
+			signal_stats.emitted);
+	}
+
 	if (conn == NULL || !dbus_connection_get_is_connected(conn))
 		return;
 
@@ -0,0 +1,102 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "histogram.h"
+
+unsigned int histogram_bucket_index(unsigned int usec)
+{
+	unsigned int shift;
+
+	if (usec < HISTOGRAM_SUB_COUNT)
+		return usec;
+
+	shift = 31 - __builtin_clz(usec) - HISTOGRAM_SUB_BITS;
+
+	return HISTOGRAM_SUB_COUNT * (shift + 1) +
+			((usec >> shift) & (HISTOGRAM_SUB_COUNT - 1));
+}
+
+unsigned int histogram_bucket_lower(unsigned int index)
+{
+	unsigned int shift;
+
+	if (index < HISTOGRAM_SUB_COUNT)
+		return index;
+
+	shift = index / HISTOGRAM_SUB_COUNT - 1;
+
+	return (HISTOGRAM_SUB_COUNT + index % HISTOGRAM_SUB_COUNT) << shift;
+}
+
+unsigned int histogram_bucket_upper(unsigned int index)
+{
+	if (index + 1 >= HISTOGRAM_BUCKETS)
+		return UINT32_MAX;
+
+	return histogram_bucket_lower(index + 1) - 1;
+}
+
+void histogram_init(struct histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = UINT32_MAX;
+}
+
+void histogram_add(struct histogram *h, unsigned int usec, bool ok)
+{
+	h->count += 1;
+	h->sum += usec;
+	h->buckets[histogram_bucket_index(usec)] += 1;
+
+	if (!ok)
+		h->errors += 1;
+
+	if (usec < h->min)
+		h->min = usec;
+
+	if (usec > h->max)
+		h->max = usec;
+}
+
+/* Upper bound of the bucket holding the percentile, capped by the maximum */
+unsigned int histogram_percentile(const struct histogram *h,
+						unsigned int percent)
+{
+	unsigned int target = (h->count * (uint64_t) percent + 99) / 100;
+	unsigned int seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += h->buckets[i];
+
+		if (seen >= target) {
+			unsigned int upper = histogram_bucket_upper(i);
+
+			return upper < h->max ? upper : h->max;
+		}
+	}
+
+	return h->max;
+}
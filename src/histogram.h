@@ -0,0 +1,49 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Latencies are kept in log-linear buckets: values below HISTOGRAM_SUB_COUNT
+ * microseconds get a bucket each, every power of two above is split into
+ * HISTOGRAM_SUB_COUNT linear buckets.  This bounds the relative error of
+ * any reported value to 1 / HISTOGRAM_SUB_COUNT over the whole 32 bit range.
+ */
+#define HISTOGRAM_SUB_BITS	2
+#define HISTOGRAM_SUB_COUNT	(1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS	(HISTOGRAM_SUB_COUNT * (33 - HISTOGRAM_SUB_BITS))
+
+struct histogram {
+	unsigned int count;
+	unsigned int errors;
+	unsigned int min;
+	unsigned int max;
+	uint64_t sum;
+	unsigned int buckets[HISTOGRAM_BUCKETS];
+};
+
+void histogram_init(struct histogram *h);
+void histogram_add(struct histogram *h, unsigned int usec, bool ok);
+unsigned int histogram_percentile(const struct histogram *h,
+						unsigned int percent);
+
+unsigned int histogram_bucket_index(unsigned int usec);
+unsigned int histogram_bucket_lower(unsigned int index);
+unsigned int histogram_bucket_upper(unsigned int index);
@@ -25,17 +25,24 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <time.h>
+#include <sys/uio.h>
 #ifdef __GLIBC__
 #include <execinfo.h>
 #endif
 #include <dlfcn.h>
 
 #include "ofono.h"
+#include "trace.h"
 
 static const char *program_exec;
 static const char *program_path;
@@ -115,6 +122,153 @@ void ofono_debug(const char *format, ...)
 	va_end(ap);
 }
 
+/*
+ * Trace ring
+ *
+ * DBG sites enabled for tracing store the format string pointer and
+ * their raw arguments into a fixed size record.  Formatting only happens
+ * when the ring is dumped.  Writers claim a slot by bumping the head and
+ * publish it by storing its sequence number last, so a dump from a signal
+ * handler skips records that are half written.
+ */
+#define TRACE_RING_SIZE		4096	/* Must be a power of two */
+
+static struct trace_record *trace_ring;
+static unsigned long trace_head;
+static char *trace_path;
+
+/**
+ * ofono_debug_trace:
+ * @desc: debug descriptor of the call site
+ * @func: function name of the call site
+ * @format: format string
+ * @varargs: list of arguments
+ *
+ * Record a debug message into the trace ring without formatting it
+ *
+ * This is called by DBG() for sites that have tracing enabled.  The
+ * format string must stay valid as long as the descriptor is registered.
+ */
+void ofono_debug_trace(const struct ofono_debug_desc *desc,
+				const char *func, const char *format, ...)
+{
+	struct trace_record *rec;
+	struct timespec ts;
+	unsigned long seq;
+	va_list ap;
+
+	if (trace_ring == NULL)
+		return;
+
+	seq = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+	rec = &trace_ring[seq & (TRACE_RING_SIZE - 1)];
+
+	__atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	rec->timestamp = (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	rec->desc = desc;
+	rec->func = func;
+	rec->format = format;
+	rec->len = 0;
+	rec->truncated = FALSE;
+
+	va_start(ap, format);
+	trace_encode(rec, format, &ap);
+	va_end(ap);
+
+	__atomic_store_n(&rec->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+static void trace_foreach(ofono_log_trace_func_t func, void *user_data,
+							bool raw_time)
+{
+	unsigned long head, seq;
+	char line[512];
+
+	if (trace_ring == NULL)
+		return;
+
+	head = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+	seq = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+	for (; seq < head; seq++) {
+		const struct trace_record *rec =
+				&trace_ring[seq & (TRACE_RING_SIZE - 1)];
+
+		/* Overwritten or still being written */
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != seq + 1)
+			continue;
+
+		trace_format(rec, raw_time, line, sizeof(line));
+		func(line, user_data);
+	}
+}
+
+/**
+ * __ofono_log_trace_foreach:
+ * @func: called with each formatted record, oldest first
+ * @user_data: passed to @func
+ *
+ * Format the records currently held by the trace ring
+ *
+ * Each line is valid UTF-8, cut to fit if needed.
+ */
+void __ofono_log_trace_foreach(ofono_log_trace_func_t func, void *user_data)
+{
+	trace_foreach(func, user_data, false);
+}
+
+static void trace_write_line(const char *line, void *user_data)
+{
+	int fd = GPOINTER_TO_INT(user_data);
+	struct iovec iov[2] = {
+		{ .iov_base = (void *) line, .iov_len = strlen(line) },
+		{ .iov_base = "\n", .iov_len = 1 },
+	};
+
+	if (writev(fd, iov, 2) < 0)
+		return;
+}
+
+static int trace_dump(const char *path, bool raw_time)
+{
+	int fd, err;
+
+	if (path == NULL)
+		path = trace_path;
+
+	if (path == NULL)
+		return -ENOENT;
+
+	if (trace_ring == NULL)
+		return -ENODATA;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -errno;
+
+	trace_foreach(trace_write_line, GINT_TO_POINTER(fd), raw_time);
+
+	err = fsync(fd) < 0 ? -errno : 0;
+	close(fd);
+
+	return err;
+}
+
+/**
+ * __ofono_log_trace_dump:
+ * @path: file to write, NULL for the one given with --trace-file
+ *
+ * Write the formatted trace ring to a file
+ */
+int __ofono_log_trace_dump(const char *path)
+{
+	return trace_dump(path, false);
+}
+
 #ifdef __GLIBC__
 static void print_backtrace(unsigned int offset)
 {
@@ -221,12 +375,38 @@ static void print_backtrace(unsigned int offset)
 	close(infd[0]);
 }
 
+static void trace_log_line(const char *line, void *user_data)
+{
+	ofono_error("trace: %s", line);
+}
+
+static void trace_dump_crash(void)
+{
+	int err;
+
+	if (trace_ring == NULL)
+		return;
+
+	/* Skip the local time conversion, it may take locks */
+	err = trace_dump(NULL, true);
+	if (err == 0) {
+		ofono_error("Trace written to %s", trace_path);
+		return;
+	}
+
+	ofono_error("++++++++ trace ++++++++");
+	trace_foreach(trace_log_line, NULL, true);
+	ofono_error("+++++++++++++++++++++++");
+}
+
 static void signal_handler(int signo)
 {
 	ofono_error("Aborting (signal %d) [%s]", signo, program_exec);
 
 	print_backtrace(2);
 
+	trace_dump_crash();
+
 	exit(EXIT_FAILURE);
 }
 
@@ -251,20 +431,27 @@ static void signal_setup(sighandler_t handler)
 extern struct ofono_debug_desc __start___debug[];
 extern struct ofono_debug_desc __stop___debug[];
 
+struct debug_section {
+	struct ofono_debug_desc *start;
+	struct ofono_debug_desc *stop;
+};
+
 static gchar **enabled = NULL;
+static gchar **traced = NULL;
+static GSList *sections = NULL;
 
-static ofono_bool_t is_enabled(struct ofono_debug_desc *desc)
+static ofono_bool_t is_enabled(gchar **patterns, struct ofono_debug_desc *desc)
 {
 	int i;
 
-	if (enabled == NULL)
+	if (patterns == NULL)
 		return FALSE;
 
-	for (i = 0; enabled[i] != NULL; i++) {
-		if (desc->name != NULL && g_pattern_match_simple(enabled[i],
+	for (i = 0; patterns[i] != NULL; i++) {
+		if (desc->name != NULL && g_pattern_match_simple(patterns[i],
 							desc->name) == TRUE)
 			return TRUE;
-		if (desc->file != NULL && g_pattern_match_simple(enabled[i],
+		if (desc->file != NULL && g_pattern_match_simple(patterns[i],
 							desc->file) == TRUE)
 			return TRUE;
 	}
@@ -272,10 +459,23 @@ static ofono_bool_t is_enabled(struct ofono_debug_desc *desc)
 	return FALSE;
 }
 
+static int trace_ring_alloc(void)
+{
+	if (trace_ring != NULL)
+		return 0;
+
+	trace_ring = g_try_new0(struct trace_record, TRACE_RING_SIZE);
+	if (trace_ring == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
 void __ofono_log_enable(struct ofono_debug_desc *start,
 					struct ofono_debug_desc *stop)
 {
 	struct ofono_debug_desc *desc;
+	struct debug_section *section;
 	const char *name = NULL, *file = NULL;
 
 	if (start == NULL || stop == NULL)
@@ -290,9 +490,111 @@ void __ofono_log_enable(struct ofono_debug_desc *start,
 				file = NULL;
 		}
 
-		if (is_enabled(desc) == TRUE)
+		if (is_enabled(enabled, desc) == TRUE)
 			desc->flags |= OFONO_DEBUG_FLAG_PRINT;
+
+		if (is_enabled(traced, desc) == TRUE)
+			desc->flags |= OFONO_DEBUG_FLAG_TRACE;
 	}
+
+	section = g_try_new0(struct debug_section, 1);
+	if (section == NULL)
+		return;
+
+	section->start = start;
+	section->stop = stop;
+	sections = g_slist_prepend(sections, section);
+}
+
+void __ofono_log_disable(struct ofono_debug_desc *start,
+					struct ofono_debug_desc *stop)
+{
+	GSList *l;
+	unsigned int i;
+
+	for (l = sections; l; l = l->next) {
+		struct debug_section *section = l->data;
+
+		if (section->start != start)
+			continue;
+
+		sections = g_slist_delete_link(sections, l);
+		g_free(section);
+		break;
+	}
+
+	if (trace_ring == NULL)
+		return;
+
+	/* The format strings go away with the plugin */
+	for (i = 0; i < TRACE_RING_SIZE; i++) {
+		struct trace_record *rec = &trace_ring[i];
+
+		if (rec->desc >= start && rec->desc < stop)
+			__atomic_store_n(&rec->seq, 0, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * __ofono_log_set_flags:
+ * @pattern: file or name patterns, as given to --debug
+ * @flags: OFONO_DEBUG_FLAG_PRINT and/or OFONO_DEBUG_FLAG_TRACE
+ * @enable: whether to set or clear @flags
+ *
+ * Change the flags of registered debug descriptors at run time.
+ * Returns the number of descriptors changed or a negative errno.
+ */
+int __ofono_log_set_flags(const char *pattern, unsigned int flags,
+						ofono_bool_t enable)
+{
+	gchar **patterns;
+	GSList *l;
+	int count = 0;
+
+	if (enable && (flags & OFONO_DEBUG_FLAG_TRACE) &&
+					trace_ring_alloc() < 0)
+		return -ENOMEM;
+
+	patterns = g_strsplit_set(pattern, ":, ", 0);
+
+	for (l = sections; l; l = l->next) {
+		struct debug_section *section = l->data;
+		struct ofono_debug_desc *desc;
+
+		for (desc = section->start; desc < section->stop; desc++) {
+			unsigned int old = desc->flags;
+
+			if (is_enabled(patterns, desc) == FALSE)
+				continue;
+
+			if (enable)
+				desc->flags |= flags;
+			else
+				desc->flags &= ~flags;
+
+			if (desc->flags != old)
+				count += 1;
+		}
+	}
+
+	g_strfreev(patterns);
+
+	return count;
+}
+
+/**
+ * __ofono_log_set_trace:
+ * @trace: patterns of the DBG sites to record, as given to --trace
+ * @path: file the trace ring is written to on a crash, or NULL
+ *
+ * Must be called before __ofono_log_init()
+ */
+void __ofono_log_set_trace(const char *trace, const char *path)
+{
+	if (trace != NULL)
+		traced = g_strsplit_set(trace, ":, ", 0);
+
+	trace_path = g_strdup(path);
 }
 
 int __ofono_log_init(const char *program, const char *debug,
@@ -320,6 +622,9 @@ int __ofono_log_init(const char *program, const char *debug,
 
 	syslog(LOG_INFO, "oFono version %s", VERSION);
 
+	if (traced != NULL && trace_ring_alloc() < 0)
+		ofono_error("Unable to allocate the trace ring");
+
 	return 0;
 }
 
@@ -334,4 +639,12 @@ void __ofono_log_cleanup(void)
 #endif
 
 	g_strfreev(enabled);
+	g_strfreev(traced);
+	g_free(trace_path);
+
+	g_slist_free_full(sections, g_free);
+	sections = NULL;
+
+	g_free(trace_ring);
+	trace_ring = NULL;
 }
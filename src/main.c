@@ -35,6 +35,7 @@
 #include <ell/ell.h>
 
 #include "ofono.h"
+#include "storage.h"
 
 #define SHUTDOWN_GRACE_SECONDS 10
 
@@ -131,27 +132,46 @@ static void system_bus_disconnected(DBusConnection *conn, void *user_data)
 }
 
 static gchar *option_debug = NULL;
+static gchar *option_trace = NULL;
+static gchar *option_trace_file = NULL;
 static gchar *option_plugin = NULL;
 static gchar *option_noplugin = NULL;
 static gboolean option_detach = TRUE;
 static gboolean option_version = FALSE;
+static gint option_signal_window = 0;
+static gint option_strength_interval = -1;
+static gint option_sync_delay = -1;
+static gint option_scan_cache = -1;
 
-static gboolean parse_debug(const char *key, const char *value,
-					gpointer user_data, GError **error)
+static void append_pattern(gchar **option, const char *value)
 {
 	if (value) {
-		if (option_debug) {
-			char *prev = option_debug;
+		if (*option) {
+			char *prev = *option;
 
-			option_debug = g_strconcat(prev, ",", value, NULL);
+			*option = g_strconcat(prev, ",", value, NULL);
 			g_free(prev);
 		} else {
-			option_debug = g_strdup(value);
+			*option = g_strdup(value);
 		}
 	} else {
-		g_free(option_debug);
-		option_debug = g_strdup("*");
+		g_free(*option);
+		*option = g_strdup("*");
 	}
+}
+
+static gboolean parse_debug(const char *key, const char *value,
+					gpointer user_data, GError **error)
+{
+	append_pattern(&option_debug, value);
+
+	return TRUE;
+}
+
+static gboolean parse_trace(const char *key, const char *value,
+					gpointer user_data, GError **error)
+{
+	append_pattern(&option_trace, value);
 
 	return TRUE;
 }
@@ -160,6 +180,11 @@ static GOptionEntry options[] = {
 	{ "debug", 'd', G_OPTION_FLAG_OPTIONAL_ARG,
 				G_OPTION_ARG_CALLBACK, parse_debug,
 				"Specify debug options to enable", "DEBUG" },
+	{ "trace", 't', G_OPTION_FLAG_OPTIONAL_ARG,
+				G_OPTION_ARG_CALLBACK, parse_trace,
+				"Specify debug options to record", "DEBUG" },
+	{ "trace-file", 0, 0, G_OPTION_ARG_STRING, &option_trace_file,
+				"Write the trace to FILE on a crash", "FILE" },
 	{ "plugin", 'p', 0, G_OPTION_ARG_STRING, &option_plugin,
 				"Specify plugins to load", "NAME,..," },
 	{ "noplugin", 'P', 0, G_OPTION_ARG_STRING, &option_noplugin,
@@ -167,6 +192,19 @@ static GOptionEntry options[] = {
 	{ "nodetach", 'n', G_OPTION_FLAG_REVERSE,
 				G_OPTION_ARG_NONE, &option_detach,
 				"Don't run as daemon in background" },
+	{ "signal-window", 0, 0, G_OPTION_ARG_INT, &option_signal_window,
+				"Coalesce property changes over MSEC "
+				"milliseconds", "MSEC" },
+	{ "strength-interval", 0, 0, G_OPTION_ARG_INT,
+				&option_strength_interval,
+				"Send signal strength changes at most every "
+				"MSEC milliseconds", "MSEC" },
+	{ "sync-delay", 0, 0, G_OPTION_ARG_INT, &option_sync_delay,
+				"Delay settings writes by MSEC milliseconds",
+				"MSEC" },
+	{ "scan-cache", 0, 0, G_OPTION_ARG_INT, &option_scan_cache,
+				"Reuse operator scans for SEC seconds",
+				"SEC" },
 	{ "version", 'v', 0, G_OPTION_ARG_NONE, &option_version,
 				"Show version information and exit" },
 	{ NULL },
@@ -252,6 +290,7 @@ int main(int argc, char **argv)
 
 	signal = setup_signalfd();
 
+	__ofono_log_set_trace(option_trace, option_trace_file);
 	__ofono_log_init(argv[0], option_debug, option_detach);
 
 	dbus_error_init(&error);
@@ -274,6 +313,18 @@ int main(int argc, char **argv)
 
 	__ofono_dbus_init(conn);
 
+	if (option_signal_window > 0)
+		__ofono_dbus_set_signal_window(option_signal_window);
+
+	if (option_strength_interval >= 0)
+		__ofono_dbus_set_strength_interval(option_strength_interval);
+
+	if (option_sync_delay >= 0)
+		storage_set_sync_delay(option_sync_delay);
+
+	if (option_scan_cache >= 0)
+		__ofono_netreg_set_scan_cache(option_scan_cache);
+
 	__ofono_modemwatch_init();
 
 	__ofono_manager_init();
@@ -291,6 +342,8 @@ int main(int argc, char **argv)
 
 	__ofono_modemwatch_cleanup();
 
+	storage_flush();
+
 	__ofono_dbus_cleanup();
 	dbus_connection_unref(conn);
 
@@ -305,6 +358,8 @@ cleanup:
 	__ofono_log_cleanup();
 
 	g_free(option_debug);
+	g_free(option_trace);
+	g_free(option_trace_file);
 
 	return 0;
 }
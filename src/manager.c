@@ -23,6 +23,7 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
 #include <string.h>
 #include <glib.h>
 #include <gdbus.h>
@@ -95,6 +96,125 @@ static const GDBusSignalTable manager_signals[] = {
 	{ }
 };
 
+static DBusMessage *debug_set_flags(DBusMessage *msg, unsigned int flags)
+{
+	const char *pattern;
+	dbus_bool_t enable;
+
+	if (dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &pattern,
+					DBUS_TYPE_BOOLEAN, &enable,
+					DBUS_TYPE_INVALID) == FALSE)
+		return __ofono_error_invalid_args(msg);
+
+	if (__ofono_log_set_flags(pattern, flags, enable) < 0)
+		return __ofono_error_failed(msg);
+
+	return dbus_message_new_method_return(msg);
+}
+
+static DBusMessage *debug_set_debug(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	return debug_set_flags(msg, OFONO_DEBUG_FLAG_PRINT);
+}
+
+static DBusMessage *debug_set_trace(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	return debug_set_flags(msg, OFONO_DEBUG_FLAG_TRACE);
+}
+
+static void append_trace_line(const char *line, void *user_data)
+{
+	DBusMessageIter *array = user_data;
+
+	dbus_message_iter_append_basic(array, DBUS_TYPE_STRING, &line);
+}
+
+static DBusMessage *debug_get_trace(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter array;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_TYPE_STRING_AS_STRING, &array);
+	__ofono_log_trace_foreach(append_trace_line, &array);
+	dbus_message_iter_close_container(&iter, &array);
+
+	return reply;
+}
+
+static DBusMessage *debug_dump_trace(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	switch (__ofono_log_trace_dump(NULL)) {
+	case 0:
+		return dbus_message_new_method_return(msg);
+	case -ENOENT:
+	case -ENODATA:
+		return __ofono_error_not_available(msg);
+	default:
+		return __ofono_error_failed(msg);
+	}
+}
+
+static DBusMessage *debug_get_signal_statistics(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	struct ofono_dbus_signal_stats stats;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter dict;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	__ofono_dbus_get_signal_stats(&stats);
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+	ofono_dbus_dict_append(&dict, "Queued", DBUS_TYPE_UINT32,
+					&stats.queued);
+	ofono_dbus_dict_append(&dict, "Coalesced", DBUS_TYPE_UINT32,
+					&stats.coalesced);
+	ofono_dbus_dict_append(&dict, "RateLimited", DBUS_TYPE_UINT32,
+					&stats.rate_limited);
+	ofono_dbus_dict_append(&dict, "Emitted", DBUS_TYPE_UINT32,
+					&stats.emitted);
+	dbus_message_iter_close_container(&iter, &dict);
+
+	return reply;
+}
+
+static const GDBusMethodTable debug_methods[] = {
+	{ GDBUS_METHOD("SetDebug",
+			GDBUS_ARGS({ "pattern", "s" }, { "enable", "b" }),
+			NULL, debug_set_debug) },
+	{ GDBUS_METHOD("SetTrace",
+			GDBUS_ARGS({ "pattern", "s" }, { "enable", "b" }),
+			NULL, debug_set_trace) },
+	{ GDBUS_METHOD("GetTrace",
+			NULL, GDBUS_ARGS({ "lines", "as" }),
+			debug_get_trace) },
+	{ GDBUS_METHOD("DumpTrace", NULL, NULL, debug_dump_trace) },
+	{ GDBUS_METHOD("GetSignalStatistics",
+			NULL, GDBUS_ARGS({ "statistics", "a{sv}" }),
+			debug_get_signal_statistics) },
+	{ }
+};
+
 int __ofono_manager_init(void)
 {
 	DBusConnection *conn = ofono_dbus_get_connection();
@@ -108,6 +228,10 @@ int __ofono_manager_init(void)
 	if (ret == FALSE)
 		return -1;
 
+	g_dbus_register_interface(conn, OFONO_MANAGER_PATH,
+					OFONO_DEBUG_INTERFACE,
+					debug_methods, NULL, NULL, NULL, NULL);
+
 	return 0;
 }
 
@@ -115,6 +239,8 @@ void __ofono_manager_cleanup(void)
 {
 	DBusConnection *conn = ofono_dbus_get_connection();
 
+	g_dbus_unregister_interface(conn, OFONO_MANAGER_PATH,
+					OFONO_DEBUG_INTERFACE);
 	g_dbus_unregister_interface(conn, OFONO_MANAGER_PATH,
 					OFONO_MANAGER_INTERFACE);
 }
@@ -64,7 +64,9 @@ struct ofono_modem {
 	char			*path;
 	enum modem_state	modem_state;
 	GSList			*atoms;
+	GSList			*atoms_by_type[OFONO_ATOM_TYPE_MAX];
 	struct ofono_watchlist	*atom_watches;
+	GSList			*watches_by_type[OFONO_ATOM_TYPE_MAX];
 	GSList			*interface_list;
 	GSList			*feature_list;
 	unsigned int		call_ids;
@@ -90,6 +92,7 @@ struct ofono_modem {
 	void			*driver_data;
 	char			*driver_type;
 	char			*name;
+	struct ofono_stats	*stats;
 };
 
 struct ofono_devinfo {
@@ -221,6 +224,8 @@ struct ofono_atom *__ofono_modem_add_atom(struct ofono_modem *modem,
 	atom->modem = modem;
 
 	modem->atoms = g_slist_prepend(modem->atoms, atom);
+	modem->atoms_by_type[type] = g_slist_prepend(
+					modem->atoms_by_type[type], atom);
 
 	return atom;
 }
@@ -258,17 +263,12 @@ static void call_watches(struct ofono_atom *atom,
 				enum ofono_atom_watch_condition cond)
 {
 	struct ofono_modem *modem = atom->modem;
-	GSList *atom_watches = modem->atom_watches->items;
 	GSList *l;
 	struct atom_watch *watch;
 	ofono_atom_watch_func notify;
 
-	for (l = atom_watches; l; l = l->next) {
+	for (l = modem->watches_by_type[atom->type]; l; l = l->next) {
 		watch = l->data;
-
-		if (watch->type != atom->type)
-			continue;
-
 		notify = watch->item.notify;
 		notify(atom, cond, watch->item.notify_data);
 	}
@@ -323,11 +323,13 @@ unsigned int __ofono_modem_add_atom_watch(struct ofono_modem *modem,
 
 	id = __ofono_watchlist_add_item(modem->atom_watches,
 					(struct ofono_watchlist_item *)watch);
+	modem->watches_by_type[type] = g_slist_prepend(
+					modem->watches_by_type[type], watch);
 
-	for (l = modem->atoms; l; l = l->next) {
+	for (l = modem->atoms_by_type[type]; l; l = l->next) {
 		atom = l->data;
 
-		if (atom->type != type || atom->unregister == NULL)
+		if (atom->unregister == NULL)
 			continue;
 
 		notify(atom, OFONO_ATOM_WATCH_CONDITION_REGISTERED, data);
@@ -339,6 +341,16 @@ unsigned int __ofono_modem_add_atom_watch(struct ofono_modem *modem,
 gboolean __ofono_modem_remove_atom_watch(struct ofono_modem *modem,
 						unsigned int id)
 {
+	struct atom_watch *watch;
+
+	watch = (struct atom_watch *) __ofono_watchlist_find_item(
+						modem->atom_watches, id);
+	if (watch == NULL)
+		return FALSE;
+
+	modem->watches_by_type[watch->type] = g_slist_remove(
+				modem->watches_by_type[watch->type], watch);
+
 	return __ofono_watchlist_remove_item(modem->atom_watches, id);
 }
 
@@ -351,10 +363,10 @@ struct ofono_atom *__ofono_modem_find_atom(struct ofono_modem *modem,
 	if (modem == NULL)
 		return NULL;
 
-	for (l = modem->atoms; l; l = l->next) {
+	for (l = modem->atoms_by_type[type]; l; l = l->next) {
 		atom = l->data;
 
-		if (atom->type == type && atom->unregister != NULL)
+		if (atom->unregister != NULL)
 			return atom;
 	}
 
@@ -371,12 +383,9 @@ void __ofono_modem_foreach_atom(struct ofono_modem *modem,
 	if (modem == NULL)
 		return;
 
-	for (l = modem->atoms; l; l = l->next) {
+	for (l = modem->atoms_by_type[type]; l; l = l->next) {
 		atom = l->data;
 
-		if (atom->type != type)
-			continue;
-
 		callback(atom, data);
 	}
 }
@@ -392,12 +401,9 @@ void __ofono_modem_foreach_registered_atom(struct ofono_modem *modem,
 	if (modem == NULL)
 		return;
 
-	for (l = modem->atoms; l; l = l->next) {
+	for (l = modem->atoms_by_type[type]; l; l = l->next) {
 		atom = l->data;
 
-		if (atom->type != type)
-			continue;
-
 		if (atom->unregister == NULL)
 			continue;
 
@@ -410,6 +416,8 @@ void __ofono_atom_free(struct ofono_atom *atom)
 	struct ofono_modem *modem = atom->modem;
 
 	modem->atoms = g_slist_remove(modem->atoms, atom);
+	modem->atoms_by_type[atom->type] = g_slist_remove(
+				modem->atoms_by_type[atom->type], atom);
 
 	__ofono_atom_unregister(atom);
 
@@ -444,6 +452,8 @@ static void flush_atoms(struct ofono_modem *modem, enum modem_state new_state)
 		if (atom->destruct)
 			atom->destruct(atom);
 
+		modem->atoms_by_type[atom->type] = g_slist_remove(
+				modem->atoms_by_type[atom->type], atom);
 		g_free(atom);
 
 		if (prev)
@@ -460,7 +470,7 @@ static void flush_atoms(struct ofono_modem *modem, enum modem_state new_state)
 static void notify_online_watches(struct ofono_modem *modem)
 {
 	struct ofono_watchlist_item *item;
-	GSList *l;
+	GList *l;
 	ofono_modem_online_notify_func notify;
 
 	if (modem->online_watches == NULL)
@@ -476,7 +486,7 @@ static void notify_online_watches(struct ofono_modem *modem)
 static void notify_powered_watches(struct ofono_modem *modem)
 {
 	struct ofono_watchlist_item *item;
-	GSList *l;
+	GList *l;
 	ofono_modem_powered_notify_func notify;
 
 	if (modem->powered_watches == NULL)
@@ -601,17 +611,7 @@ void __ofono_modem_remove_powered_watch(struct ofono_modem *modem,
 
 static gboolean modem_has_sim(struct ofono_modem *modem)
 {
-	GSList *l;
-	struct ofono_atom *atom;
-
-	for (l = modem->atoms; l; l = l->next) {
-		atom = l->data;
-
-		if (atom->type == OFONO_ATOM_TYPE_SIM)
-			return TRUE;
-	}
-
-	return FALSE;
+	return modem->atoms_by_type[OFONO_ATOM_TYPE_SIM] != NULL;
 }
 
 static gboolean modem_is_always_online(struct ofono_modem *modem)
@@ -1977,7 +1977,7 @@ gboolean __ofono_modemwatch_remove(unsigned int id)
 
 static void call_modemwatches(struct ofono_modem *modem, gboolean added)
 {
-	GSList *l;
+	GList *l;
 	struct ofono_watchlist_item *watch;
 	ofono_modemwatch_cb_t notify;
 
@@ -2031,10 +2031,27 @@ ofono_bool_t ofono_modem_is_registered(struct ofono_modem *modem)
 	return TRUE;
 }
 
+static void modem_probe_driver(struct ofono_modem *modem)
+{
+	GSList *l;
+
+	for (l = g_driver_list; l; l = l->next) {
+		const struct ofono_modem_driver *drv = l->data;
+
+		if (g_strcmp0(drv->name, modem->driver_type))
+			continue;
+
+		if (drv->probe(modem) < 0)
+			continue;
+
+		modem->driver = drv;
+		break;
+	}
+}
+
 int ofono_modem_register(struct ofono_modem *modem)
 {
 	DBusConnection *conn = ofono_dbus_get_connection();
-	GSList *l;
 
 	DBG("%p", modem);
 
@@ -2047,18 +2064,11 @@ int ofono_modem_register(struct ofono_modem *modem)
 	if (modem->driver != NULL)
 		return -EALREADY;
 
-	for (l = g_driver_list; l; l = l->next) {
-		const struct ofono_modem_driver *drv = l->data;
+	modem_probe_driver(modem);
 
-		if (g_strcmp0(drv->name, modem->driver_type))
-			continue;
-
-		if (drv->probe(modem) < 0)
-			continue;
-
-		modem->driver = drv;
-		break;
-	}
+	if (modem->driver == NULL &&
+			__ofono_plugin_start_driver(modem->driver_type))
+		modem_probe_driver(modem);
 
 	if (modem->driver == NULL)
 		return -ENODEV;
@@ -2084,6 +2094,8 @@ int ofono_modem_register(struct ofono_modem *modem)
 	modem->online_watches = __ofono_watchlist_new(g_free);
 	modem->powered_watches = __ofono_watchlist_new(g_free);
 
+	modem->stats = __ofono_stats_create(modem->path);
+
 	emit_modem_added(modem);
 	call_modemwatches(modem, TRUE);
 
@@ -2109,12 +2121,18 @@ static void emit_modem_removed(struct ofono_modem *modem)
 static void modem_unregister(struct ofono_modem *modem)
 {
 	DBusConnection *conn = ofono_dbus_get_connection();
+	int i;
 
 	DBG("%p", modem);
 
 	if (modem->powered == TRUE)
 		set_powered(modem, FALSE);
 
+	for (i = 0; i < OFONO_ATOM_TYPE_MAX; i++) {
+		g_slist_free(modem->watches_by_type[i]);
+		modem->watches_by_type[i] = NULL;
+	}
+
 	__ofono_watchlist_free(modem->atom_watches);
 	modem->atom_watches = NULL;
 
@@ -2157,6 +2175,9 @@ static void modem_unregister(struct ofono_modem *modem)
 					&modem->lockdown);
 	}
 
+	__ofono_stats_remove(modem->stats);
+	modem->stats = NULL;
+
 	g_dbus_unregister_interface(conn, modem->path, OFONO_MODEM_INTERFACE);
 
 	if (modem->driver && modem->driver->remove)
@@ -2189,6 +2210,16 @@ void ofono_modem_remove(struct ofono_modem *modem)
 	g_free(modem);
 }
 
+void ofono_modem_record_latency(struct ofono_modem *modem, const char *group,
+				const char *name, unsigned int usec,
+				ofono_bool_t ok)
+{
+	if (modem == NULL || modem->stats == NULL)
+		return;
+
+	__ofono_stats_record(modem->stats, group, name, usec, ok);
+}
+
 void ofono_modem_reset(struct ofono_modem *modem)
 {
 	int err;
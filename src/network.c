@@ -44,6 +44,8 @@
 #define NETWORK_REGISTRATION_FLAG_ROAMING_SHOW_SPN	0x2
 #define NETWORK_REGISTRATION_FLAG_READING_PNN		0x4
 
+#define OPERATOR_KEY_LENGTH (OFONO_MAX_MCC_LENGTH + OFONO_MAX_MNC_LENGTH + 1)
+
 enum network_registration_mode {
 	NETWORK_REGISTRATION_MODE_AUTO =	0,
 	NETWORK_REGISTRATION_MODE_MANUAL =	2,
@@ -59,6 +61,8 @@ struct ofono_netreg {
 	char *base_station;
 	struct network_operator_data *current_operator;
 	GSList *operator_list;
+	GHashTable *operator_table;	/* MCC + MNC -> operator */
+	gint64 scan_time;
 	struct ofono_network_registration_ops *ops;
 	int flags;
 	DBusMessage *pending;
@@ -88,6 +92,7 @@ struct network_operator_data {
 };
 
 static GSList *g_drivers = NULL;
+static unsigned int scan_cache = 60;
 
 static const char *registration_mode_to_string(int mode)
 {
@@ -253,6 +258,12 @@ static struct network_operator_data *
 	return opd;
 }
 
+static void network_operator_key(char *key, const char *mcc,
+							const char *mnc)
+{
+	snprintf(key, OPERATOR_KEY_LENGTH, "%s%s", mcc, mnc);
+}
+
 static void network_operator_destroy(gpointer user_data)
 {
 	struct network_operator_data *op = user_data;
@@ -274,20 +285,6 @@ static gint network_operator_compare(gconstpointer a, gconstpointer b)
 	return comp1 != 0 ? comp1 : comp2;
 }
 
-static gint network_operator_data_compare(gconstpointer a, gconstpointer b)
-{
-	const struct network_operator_data *opa = a;
-	const struct network_operator_data *opb = b;
-
-	int comp1;
-	int comp2;
-
-	comp1 = strcmp(opa->mcc, opb->mcc);
-	comp2 = strcmp(opa->mnc, opb->mnc);
-
-	return comp1 != 0 ? comp1 : comp2;
-}
-
 static const char *network_operator_build_path(struct ofono_netreg *netreg,
 							const char *mcc,
 							const char *mnc)
@@ -673,66 +670,69 @@ static gboolean network_operator_dbus_unregister(struct ofono_netreg *netreg,
 static GSList *compress_operator_list(const struct ofono_network_operator *list,
 					int total)
 {
-	GSList *oplist = 0;
-	GSList *o;
-	int i;
+	GHashTable *seen;
+	GSList *oplist = NULL;
 	struct network_operator_data *opd;
+	char key[OPERATOR_KEY_LENGTH];
+	int i;
 
-	for (i = 0; i < total; i++) {
-		o = NULL;
+	seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
+	for (i = 0; i < total; i++) {
 		if (list[i].mcc[0] == '\0' || list[i].mnc[0] == '\0')
 			continue;
 
-		if (oplist)
-			o = g_slist_find_custom(oplist, &list[i],
-						network_operator_compare);
+		network_operator_key(key, list[i].mcc, list[i].mnc);
 
-		if (o == NULL) {
+		opd = g_hash_table_lookup(seen, key);
+		if (opd == NULL) {
 			opd = network_operator_create(&list[i]);
+			g_hash_table_insert(seen, g_strdup(key), opd);
 			oplist = g_slist_prepend(oplist, opd);
-		} else if (o && list[i].tech != -1) {
-			opd = o->data;
+		} else if (list[i].tech != -1)
 			opd->techs |= 1 << list[i].tech;
-		}
 	}
 
-	if (oplist)
-		oplist = g_slist_reverse(oplist);
+	g_hash_table_destroy(seen);
 
-	return oplist;
+	return g_slist_reverse(oplist);
 }
 
 static gboolean update_operator_list(struct ofono_netreg *netreg, int total,
 				const struct ofono_network_operator *list)
 {
+	struct network_operator_data *current_op = netreg->current_operator;
+	GHashTable *old = netreg->operator_table;
+	GHashTableIter iter;
+	gpointer value;
 	GSList *n = NULL;
-	GSList *o;
 	GSList *compressed;
 	GSList *c;
-	struct network_operator_data *current_op = NULL;
+	char key[OPERATOR_KEY_LENGTH];
+	gboolean found_current = FALSE;
 	gboolean changed = FALSE;
 
 	compressed = compress_operator_list(list, total);
 
+	netreg->operator_table = g_hash_table_new_full(g_str_hash,
+							g_str_equal,
+							g_free, NULL);
+
 	for (c = compressed; c; c = c->next) {
 		struct network_operator_data *copd = c->data;
+		struct network_operator_data *opd;
 
-		o = g_slist_find_custom(netreg->operator_list, copd,
-					network_operator_data_compare);
+		network_operator_key(key, copd->mcc, copd->mnc);
 
-		if (o) { /* Update and move to a new list */
-			set_network_operator_status(o->data, copd->status);
-			set_network_operator_techs(o->data, copd->techs);
-			set_network_operator_name(o->data, copd->name);
+		opd = g_hash_table_lookup(old, key);
+		if (opd) { /* Update and move to the new table */
+			g_hash_table_remove(old, key);
 
-			n = g_slist_prepend(n, o->data);
-			netreg->operator_list =
-				g_slist_remove(netreg->operator_list, o->data);
+			set_network_operator_status(opd, copd->status);
+			set_network_operator_techs(opd, copd->techs);
+			set_network_operator_name(opd, copd->name);
 		} else {
 			/* New operator */
-			struct network_operator_data *opd;
-
 			opd = g_memdup(copd,
 					sizeof(struct network_operator_data));
 
@@ -741,31 +741,45 @@ static gboolean update_operator_list(struct ofono_netreg *netreg, int total,
 				continue;
 			}
 
-			n = g_slist_prepend(n, opd);
 			changed = TRUE;
 		}
+
+		if (opd == current_op)
+			found_current = TRUE;
+
+		g_hash_table_insert(netreg->operator_table, g_strdup(key), opd);
+		n = g_slist_prepend(n, opd);
 	}
 
 	g_slist_free_full(compressed, g_free);
 
-	if (n)
-		n = g_slist_reverse(n);
+	n = g_slist_reverse(n);
+
+	/* Whatever is left is gone, except for the current operator */
+	g_hash_table_iter_init(&iter, old);
+
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		struct network_operator_data *op = value;
 
-	if (netreg->operator_list)
 		changed = TRUE;
 
-	for (o = netreg->operator_list; o; o = o->next) {
-		struct network_operator_data *op = o->data;
-		if (op != op->netreg->current_operator)
-			network_operator_dbus_unregister(netreg, op);
+		if (op == current_op)
+			continue;
+
+		if (op->mcc[0] == '\0' || op->mnc[0] == '\0')
+			g_free(op);
 		else
-			current_op = op;
+			network_operator_dbus_unregister(netreg, op);
 	}
 
-	if (current_op) {
+	g_hash_table_destroy(old);
+
+	if (current_op && !found_current) {
 		n = g_slist_prepend(n, current_op);
-		netreg->operator_list =
-			g_slist_remove(netreg->operator_list, current_op);
+
+		network_operator_key(key, current_op->mcc, current_op->mnc);
+		g_hash_table_insert(netreg->operator_table, g_strdup(key),
+								current_op);
 	}
 
 	g_slist_free(netreg->operator_list);
@@ -898,19 +912,8 @@ static void append_operator_struct(struct ofono_netreg *netreg,
 static void append_operator_struct_list(struct ofono_netreg *netreg,
 					DBusMessageIter *array)
 {
-	DBusConnection *conn = ofono_dbus_get_connection();
-	char **children;
-	char path[256];
 	GSList *l;
 
-	snprintf(path, sizeof(path), "%s/operator",
-			__ofono_atom_get_path(netreg->atom));
-
-	if (!dbus_connection_list_registered(conn, path, &children)) {
-		DBG("Unable to obtain registered NetworkOperator(s)");
-		return;
-	}
-
 	/*
 	 * Quoting 27.007: "The list of operators shall be in order: home
 	 * network, networks referenced in SIM or active application in the
@@ -919,43 +922,29 @@ static void append_operator_struct_list(struct ofono_netreg *netreg,
 	 * PLMN selector (in the SIM or GSM application), and other networks."
 	 * Thus we must make sure we return the list in the same order,
 	 * if possible.  Luckily the operator_list is stored in order already
+	 *
+	 * Operators without MCC / MNC have no object, so they are skipped.
 	 */
 	for (l = netreg->operator_list; l; l = l->next) {
 		struct network_operator_data *opd = l->data;
-		char mnc[OFONO_MAX_MNC_LENGTH + 1];
-		char mcc[OFONO_MAX_MCC_LENGTH + 1];
-		int j;
 
-		for (j = 0; children[j]; j++) {
-			sscanf(children[j], "%3[0-9]%[0-9]", mcc, mnc);
+		if (opd->mcc[0] == '\0' || opd->mnc[0] == '\0')
+			continue;
 
-			if (!strcmp(opd->mcc, mcc) && !strcmp(opd->mnc, mnc))
-				append_operator_struct(netreg, opd, array);
-		}
+		append_operator_struct(netreg, opd, array);
 	}
-
-	dbus_free_string_array(children);
 }
 
-static void operator_list_callback(const struct ofono_error *error, int total,
-				const struct ofono_network_operator *list,
-				void *data)
+static DBusMessage *operator_list_reply(struct ofono_netreg *netreg,
+							DBusMessage *msg)
 {
-	struct ofono_netreg *netreg = data;
 	DBusMessage *reply;
 	DBusMessageIter iter;
 	DBusMessageIter array;
 
-	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
-		DBG("Error occurred during operator list");
-		__ofono_dbus_pending_reply(&netreg->pending,
-					__ofono_error_failed(netreg->pending));
-		return;
-	}
-
-	update_operator_list(netreg, total, list);
-
-	reply = dbus_message_new_method_return(netreg->pending);
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
 
 	dbus_message_iter_init_append(reply, &iter);
 
@@ -972,7 +961,27 @@ static void operator_list_callback(const struct ofono_error *error, int total,
 	append_operator_struct_list(netreg, &array);
 	dbus_message_iter_close_container(&iter, &array);
 
-	__ofono_dbus_pending_reply(&netreg->pending, reply);
+	return reply;
+}
+
+static void operator_list_callback(const struct ofono_error *error, int total,
+				const struct ofono_network_operator *list,
+				void *data)
+{
+	struct ofono_netreg *netreg = data;
+
+	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
+		DBG("Error occurred during operator list");
+		__ofono_dbus_pending_reply(&netreg->pending,
+					__ofono_error_failed(netreg->pending));
+		return;
+	}
+
+	update_operator_list(netreg, total, list);
+	netreg->scan_time = g_get_monotonic_time();
+
+	__ofono_dbus_pending_reply(&netreg->pending,
+				operator_list_reply(netreg, netreg->pending));
 }
 
 static DBusMessage *network_scan(DBusConnection *conn,
@@ -983,6 +992,14 @@ static DBusMessage *network_scan(DBusConnection *conn,
 	if (netreg->mode == NETWORK_REGISTRATION_MODE_AUTO_ONLY)
 		return __ofono_error_access_denied(msg);
 
+	/* A scan can take minutes, answer from a recent one if possible */
+	if (netreg->scan_time != 0 &&
+			g_get_monotonic_time() - netreg->scan_time <
+				(gint64) scan_cache * G_USEC_PER_SEC) {
+		DBG("Using cached operator scan");
+		return operator_list_reply(netreg, msg);
+	}
+
 	if (netreg->pending)
 		return __ofono_error_busy(msg);
 
@@ -1000,30 +1017,8 @@ static DBusMessage *network_get_operators(DBusConnection *conn,
 						DBusMessage *msg, void *data)
 {
 	struct ofono_netreg *netreg = data;
-	DBusMessage *reply;
-	DBusMessageIter iter;
-	DBusMessageIter array;
 
-	reply = dbus_message_new_method_return(msg);
-	if (reply == NULL)
-		return NULL;
-
-	dbus_message_iter_init_append(reply, &iter);
-
-	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
-					DBUS_STRUCT_BEGIN_CHAR_AS_STRING
-					DBUS_TYPE_OBJECT_PATH_AS_STRING
-					DBUS_TYPE_ARRAY_AS_STRING
-					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
-					DBUS_TYPE_STRING_AS_STRING
-					DBUS_TYPE_VARIANT_AS_STRING
-					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
-					DBUS_STRUCT_END_CHAR_AS_STRING,
-					&array);
-	append_operator_struct_list(netreg, &array);
-	dbus_message_iter_close_container(&iter, &array);
-
-	return reply;
+	return operator_list_reply(netreg, msg);
 }
 
 static const GDBusMethodTable network_registration_methods[] = {
@@ -1181,7 +1176,7 @@ gboolean __ofono_netreg_remove_status_watch(struct ofono_netreg *netreg,
 static void notify_status_watches(struct ofono_netreg *netreg)
 {
 	struct ofono_watchlist_item *item;
-	GSList *l;
+	GList *l;
 	ofono_netreg_status_notify_cb_t notify;
 	const char *mcc = NULL;
 	const char *mnc = NULL;
@@ -1220,7 +1215,8 @@ static void current_operator_callback(const struct ofono_error *error,
 	DBusConnection *conn = ofono_dbus_get_connection();
 	struct ofono_netreg *netreg = data;
 	const char *path = __ofono_atom_get_path(netreg->atom);
-	GSList *op = NULL;
+	struct network_operator_data *opd = NULL;
+	char key[OPERATOR_KEY_LENGTH];
 
 	DBG("%p, %p", netreg, netreg->current_operator);
 
@@ -1245,12 +1241,12 @@ static void current_operator_callback(const struct ofono_error *error,
 	/* It will be updated properly later */
 	reset_available(netreg->current_operator, current);
 
-	if (current)
-		op = g_slist_find_custom(netreg->operator_list, current,
-					network_operator_compare);
+	if (current) {
+		network_operator_key(key, current->mcc, current->mnc);
+		opd = g_hash_table_lookup(netreg->operator_table, key);
+	}
 
-	if (op) {
-		struct network_operator_data *opd = op->data;
+	if (opd) {
 		unsigned int techs = opd->techs;
 
 		if (current->tech != -1) {
@@ -1261,16 +1257,14 @@ static void current_operator_callback(const struct ofono_error *error,
 		set_network_operator_status(opd, OPERATOR_STATUS_CURRENT);
 		set_network_operator_name(opd, current->name);
 
-		if (netreg->current_operator == op->data)
+		if (netreg->current_operator == opd)
 			return;
 
-		netreg->current_operator = op->data;
+		netreg->current_operator = opd;
 		goto emit;
 	}
 
 	if (current) {
-		struct network_operator_data *opd;
-
 		opd = network_operator_create(current);
 
 		if (opd->mcc[0] != '\0' && opd->mnc[0] != '\0' &&
@@ -1283,6 +1277,7 @@ static void current_operator_callback(const struct ofono_error *error,
 		netreg->current_operator = opd;
 		netreg->operator_list = g_slist_append(netreg->operator_list,
 							opd);
+		g_hash_table_insert(netreg->operator_table, g_strdup(key), opd);
 	} else {
 		/* We don't free this here because operator is registered */
 		/* Taken care of elsewhere */
@@ -1809,6 +1804,8 @@ static void netreg_unregister(struct ofono_atom *atom)
 
 	g_slist_free(netreg->operator_list);
 	netreg->operator_list = NULL;
+	g_hash_table_remove_all(netreg->operator_table);
+	netreg->scan_time = 0;
 
 	if (netreg->base_station) {
 		g_free(netreg->base_station);
@@ -1840,6 +1837,11 @@ static void netreg_unregister(struct ofono_atom *atom)
 					OFONO_NETWORK_REGISTRATION_INTERFACE);
 }
 
+void __ofono_netreg_set_scan_cache(unsigned int seconds)
+{
+	scan_cache = seconds;
+}
+
 static void netreg_remove(struct ofono_atom *atom)
 {
 	struct ofono_netreg *netreg = __ofono_atom_get_data(atom);
@@ -1855,6 +1857,8 @@ static void netreg_remove(struct ofono_atom *atom)
 	sim_eons_free(netreg->eons);
 	sim_spdi_free(netreg->spdi);
 
+	g_hash_table_destroy(netreg->operator_table);
+
 	g_free(netreg);
 }
 
@@ -1879,6 +1883,9 @@ struct ofono_netreg *ofono_netreg_create(struct ofono_modem *modem,
 	netreg->cellid = -1;
 	netreg->technology = -1;
 	netreg->signal_strength = -1;
+	netreg->operator_table = g_hash_table_new_full(g_str_hash,
+							g_str_equal,
+							g_free, NULL);
 
 	netreg->atom = __ofono_modem_add_atom(modem, OFONO_ATOM_TYPE_NETREG,
 						netreg_remove, netreg);
@@ -43,12 +43,41 @@ int __ofono_log_init(const char *program, const char *debug,
 void __ofono_log_cleanup(void);
 void __ofono_log_enable(struct ofono_debug_desc *start,
 					struct ofono_debug_desc *stop);
+void __ofono_log_disable(struct ofono_debug_desc *start,
+					struct ofono_debug_desc *stop);
+int __ofono_log_set_flags(const char *pattern, unsigned int flags,
+						ofono_bool_t enable);
+void __ofono_log_set_trace(const char *trace, const char *path);
+
+typedef void (*ofono_log_trace_func_t)(const char *line, void *user_data);
+
+void __ofono_log_trace_foreach(ofono_log_trace_func_t func, void *user_data);
+int __ofono_log_trace_dump(const char *path);
 
 #include <ofono/dbus.h>
 
 int __ofono_dbus_init(DBusConnection *conn);
 void __ofono_dbus_cleanup(void);
 
+struct ofono_dbus_signal_stats {
+	unsigned int queued;
+	unsigned int coalesced;
+	unsigned int rate_limited;
+	unsigned int emitted;
+};
+
+void __ofono_dbus_set_signal_window(unsigned int msecs);
+void __ofono_dbus_set_strength_interval(unsigned int msecs);
+void __ofono_dbus_get_signal_stats(struct ofono_dbus_signal_stats *stats);
+
+struct ofono_stats;
+
+struct ofono_stats *__ofono_stats_create(const char *path);
+void __ofono_stats_remove(struct ofono_stats *stats);
+void __ofono_stats_record(struct ofono_stats *stats, const char *group,
+				const char *name, unsigned int usec,
+				ofono_bool_t ok);
+
 DBusMessage *__ofono_error_invalid_args(DBusMessage *msg);
 DBusMessage *__ofono_error_invalid_format(DBusMessage *msg);
 DBusMessage *__ofono_error_not_implemented(DBusMessage *msg);
@@ -86,13 +115,17 @@ struct ofono_watchlist_item {
 
 struct ofono_watchlist {
 	int next_id;
-	GSList *items;
+	GList *items;
+	GHashTable *index;		/* id -> link in items */
 	ofono_destroy_func destroy;
 };
 
 struct ofono_watchlist *__ofono_watchlist_new(ofono_destroy_func destroy);
 unsigned int __ofono_watchlist_add_item(struct ofono_watchlist *watchlist,
 					struct ofono_watchlist_item *item);
+struct ofono_watchlist_item *__ofono_watchlist_find_item(
+					struct ofono_watchlist *watchlist,
+					unsigned int id);
 gboolean __ofono_watchlist_remove_item(struct ofono_watchlist *watchlist,
 					unsigned int id);
 void __ofono_watchlist_free(struct ofono_watchlist *watchlist);
@@ -101,6 +134,7 @@ void __ofono_watchlist_free(struct ofono_watchlist *watchlist);
 
 int __ofono_plugin_init(const char *pattern, const char *exclude);
 void __ofono_plugin_cleanup(void);
+gboolean __ofono_plugin_start_driver(const char *name);
 
 #include <ofono/modem.h>
 
@@ -154,6 +188,7 @@ enum ofono_atom_type {
 	OFONO_ATOM_TYPE_NETMON,
 	OFONO_ATOM_TYPE_LTE,
 	OFONO_ATOM_TYPE_IMS,
+	OFONO_ATOM_TYPE_MAX,
 };
 
 enum ofono_atom_watch_condition {
@@ -480,6 +515,7 @@ gboolean __ofono_netreg_remove_status_watch(struct ofono_netreg *netreg,
 
 void __ofono_netreg_set_base_station_name(struct ofono_netreg *netreg,
 						const char *name);
+void __ofono_netreg_set_scan_cache(unsigned int seconds);
 
 #include <ofono/history.h>
 
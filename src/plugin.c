@@ -34,6 +34,7 @@ static GSList *plugins = NULL;
 struct ofono_plugin {
 	void *handle;
 	gboolean active;
+	gboolean pending;
 	struct ofono_plugin_desc *desc;
 };
 
@@ -64,6 +65,7 @@ static gboolean add_plugin(void *handle, struct ofono_plugin_desc *desc)
 
 	plugin->handle = handle;
 	plugin->active = FALSE;
+	plugin->pending = FALSE;
 	plugin->desc = desc;
 
 	__ofono_log_enable(desc->debug_start, desc->debug_stop);
@@ -99,6 +101,52 @@ static gboolean check_plugin(struct ofono_plugin_desc *desc,
 	return TRUE;
 }
 
+static gboolean start_plugin(struct ofono_plugin *plugin)
+{
+	gint64 start = g_get_monotonic_time();
+	int err;
+
+	plugin->pending = FALSE;
+
+	err = plugin->desc->init();
+
+	DBG("%s: %d (%" G_GINT64_FORMAT " us)", plugin->desc->name, err,
+					g_get_monotonic_time() - start);
+
+	if (err < 0)
+		return FALSE;
+
+	plugin->active = TRUE;
+
+	return TRUE;
+}
+
+/*
+ * Modem driver plugins are started on demand, the first time a modem
+ * using their driver is registered.
+ */
+gboolean __ofono_plugin_start_driver(const char *name)
+{
+	GSList *list;
+
+	if (name == NULL)
+		return FALSE;
+
+	for (list = plugins; list; list = list->next) {
+		struct ofono_plugin *plugin = list->data;
+
+		if (plugin->pending == FALSE)
+			continue;
+
+		if (g_str_equal(plugin->desc->name, name) == FALSE)
+			continue;
+
+		return start_plugin(plugin);
+	}
+
+	return FALSE;
+}
+
 #include "builtin.h"
 
 int __ofono_plugin_init(const char *pattern, const char *exclude)
@@ -110,6 +158,8 @@ int __ofono_plugin_init(const char *pattern, const char *exclude)
 	const gchar *file;
 	gchar *filename;
 	unsigned int i;
+	unsigned int deferred = 0;
+	gint64 start;
 
 	DBG("");
 
@@ -169,15 +219,25 @@ int __ofono_plugin_init(const char *pattern, const char *exclude)
 		g_dir_close(dir);
 	}
 
+	start = g_get_monotonic_time();
+
 	for (list = plugins; list; list = list->next) {
 		struct ofono_plugin *plugin = list->data;
 
-		if (plugin->desc->init() < 0)
+		if (plugin->desc->flags & OFONO_PLUGIN_FLAG_DRIVER) {
+			plugin->pending = TRUE;
+			deferred += 1;
 			continue;
+		}
 
-		plugin->active = TRUE;
+		start_plugin(plugin);
 	}
 
+	ofono_info("Plugins started in %" G_GINT64_FORMAT " ms, "
+				"%u modem drivers deferred",
+				(g_get_monotonic_time() - start) / 1000,
+				deferred);
+
 	g_strfreev(patterns);
 	g_strfreev(excludes);
 
@@ -205,8 +265,12 @@ void __ofono_plugin_cleanup(void)
 	for (list = plugins; list; list = list->next) {
 		struct ofono_plugin *plugin = list->data;
 
-		if (plugin->handle)
-			dlclose(plugin->handle);
+		if (plugin->handle == NULL)
+			continue;
+
+		__ofono_log_disable(plugin->desc->debug_start,
+					plugin->desc->debug_stop);
+		dlclose(plugin->handle);
 	}
 
 	/* Finally, free the memory */
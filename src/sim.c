@@ -368,7 +368,7 @@ static void service_number_free(gpointer pointer)
 
 static void call_state_watches(struct ofono_sim *sim)
 {
-	GSList *l;
+	GList *l;
 	ofono_sim_state_event_cb_t notify;
 
 	for (l = sim->state_watches->items; l; l = l->next) {
@@ -1098,8 +1098,9 @@ static void sim_get_image_cb(struct ofono_sim *sim,
 
 	__ofono_dbus_pending_reply(&sim->pending, reply);
 
-	if (cache)
-		sim_fs_cache_image(sim->simfs, (const char *) xpm, id);
+	if (cache && sim->efimg_length > id * 9)
+		sim_fs_cache_image(sim->simfs, (const char *) xpm,
+					&sim->efimg[id * 9]);
 
 	l_free(xpm);
 }
@@ -1212,12 +1213,13 @@ static void sim_get_image(struct ofono_sim *sim, unsigned char id,
 		return;
 	}
 
-	image = sim_fs_get_cached_image(sim->simfs, id);
+	efimg = &sim->efimg[id * 9];
+
+	/* Records describing the same image instance share the entry */
+	image = sim_fs_get_cached_image(sim->simfs, efimg);
 	if (image != NULL)
 		sim_get_image_cb(sim, id, image, FALSE);
 
-	efimg = &sim->efimg[id * 9];
-
 	iidf_id = efimg[3] << 8 | efimg[4];
 	iidf_offset = efimg[5] << 8 | efimg[6];
 	iidf_len = efimg[7] << 8 | efimg[8];
@@ -2995,7 +2997,7 @@ static void spn_watch_cb(gpointer data, gpointer user_data)
 static inline void spn_watches_notify(struct ofono_sim *sim)
 {
 	if (sim->spn_watches->items)
-		g_slist_foreach(sim->spn_watches->items, spn_watch_cb, sim);
+		g_list_foreach(sim->spn_watches->items, spn_watch_cb, sim);
 
 	sim->reading_spn = false;
 }
@@ -3507,6 +3509,11 @@ void *ofono_sim_get_data(struct ofono_sim *sim)
 	return sim->driver_data;
 }
 
+struct ofono_modem *ofono_sim_get_modem(struct ofono_sim *sim)
+{
+	return __ofono_atom_get_modem(sim->atom);
+}
+
 static ofono_bool_t is_valid_pin(const char *pin, unsigned int min,
 					unsigned int max)
 {
@@ -3584,58 +3591,150 @@ static void sim_file_changed_flush(struct ofono_sim *sim, int id)
 				sim->efimg[i * 9 + 4];
 
 			if (imgid == id)
-				sim_fs_image_cache_flush_file(sim->simfs, i);
+				sim_fs_image_cache_flush_file(sim->simfs,
+							&sim->efimg[i * 9]);
 		}
 	}
 
 	sim_fs_cache_flush_file(sim->simfs, id);
 }
 
+static void sim_reinit_naa(struct ofono_sim *sim)
+{
+	sim->state = OFONO_SIM_STATE_RESETTING;
+	__ofono_modem_sim_reset(__ofono_atom_get_modem(sim->atom));
+
+	/* Force the sim state out of READY */
+	sim_free_main_state(sim);
+	call_state_watches(sim);
+}
+
+static void sim_refresh_ad_cb(int ok, int length, int record,
+				const unsigned char *data,
+				int record_length, void *userdata)
+{
+	struct ofono_sim *sim = userdata;
+	int mnc_length = sim->mnc_length;
+
+	if (ok && length >= 4 && (data[3] & 0xf) >= 2 && (data[3] & 0xf) <= 3)
+		mnc_length = data[3] & 0xf;
+
+	/* MCC / MNC split of the IMSI is unchanged, nothing else to do */
+	if (mnc_length == sim->mnc_length)
+		return;
+
+	DBG("MNC length changed, reinitializing NAA");
+	sim_reinit_naa(sim);
+}
+
+static void sim_refresh_cphs_information_cb(int ok, int length, int record,
+				const unsigned char *data,
+				int record_length, void *userdata)
+{
+	struct ofono_sim *sim = userdata;
+	enum ofono_sim_cphs_phase cphs_phase = sim->cphs_phase;
+	unsigned char cphs_service_table[2];
+
+	memcpy(cphs_service_table, sim->cphs_service_table, 2);
+
+	sim_cphs_information_read_cb(ok, length, record, data,
+					record_length, sim);
+
+	/* Atoms only consult the CPHS bits during initialization */
+	if (cphs_phase == sim->cphs_phase &&
+			!memcmp(cphs_service_table,
+				sim->cphs_service_table, 2))
+		return;
+
+	DBG("CPHS information changed, reinitializing NAA");
+	sim_reinit_naa(sim);
+}
+
+static bool sim_refresh_adn_affects_init(struct ofono_sim *sim)
+{
+	/* EFadn status is only consulted for FDN on 2G SIMs */
+	if (sim->fixed_dialing)
+		return true;
+
+	return sim_sst_is_active(sim->efsst, sim->efsst_length,
+					SIM_SST_SERVICE_FDN);
+}
+
+static bool sim_refresh_bdn_affects_init(struct ofono_sim *sim)
+{
+	/* EFbdn status is only consulted for BDN on 2G SIMs */
+	if (sim->barred_dialing)
+		return true;
+
+	return sim_sst_is_active(sim->efsst, sim->efsst_length,
+					SIM_SST_SERVICE_BDN);
+}
+
+#define DFGSM (0x7f20 << 16)
+#define DFTEL (0x7f10 << 16)
+
+/*
+ * Files used in the SIM initialisation procedure, except EFiccid, EFpl
+ * and EFli which are handled through file watches.  A change to any of
+ * these requires the NAA to be reinitialized, unless the current state
+ * shows that the file did not influence the initialisation
+ * (affects_init), or re-reading the file shows that the values derived
+ * from it are unchanged (verify_cb).  Files without either require an
+ * unconditional reinitialization.
+ */
+static const struct {
+	uint32_t path;
+	bool (*affects_init)(struct ofono_sim *sim);
+	ofono_sim_file_read_cb_t verify_cb;
+} sim_refresh_init_files[] = {
+	{ DFGSM | SIM_EFEST_FILEID, NULL, NULL },
+	{ DFGSM | SIM_EFUST_FILEID, NULL, NULL }, /* aka. EFSST */
+	{ DFGSM | SIM_EFPHASE_FILEID, NULL, NULL },
+	{ DFGSM | SIM_EFAD_FILEID, NULL, sim_refresh_ad_cb },
+	{ DFTEL | SIM_EFBDN_FILEID, sim_refresh_bdn_affects_init, NULL },
+	{ DFTEL | SIM_EFADN_FILEID, sim_refresh_adn_affects_init, NULL },
+	{ DFGSM | SIM_EF_CPHS_INFORMATION_FILEID, NULL,
+					sim_refresh_cphs_information_cb },
+};
+
 void __ofono_sim_refresh(struct ofono_sim *sim, struct l_queue *files,
 				bool full_file_change, bool naa_init)
 {
 	const struct l_queue_entry *l;
 	bool reinit_naa = naa_init || full_file_change;
+	uint32_t paths[L_ARRAY_SIZE(sim_refresh_init_files)];
+	unsigned int verify[L_ARRAY_SIZE(sim_refresh_init_files)];
+	unsigned int n_verify = 0;
+	uint32_t matched = 0;
+	unsigned int i;
 
 	/*
 	 * Check if any files used in SIM initialisation procedure
-	 * are affected, except EFiccid, EFpl, EFli.
+	 * are affected.  Each of them is considered once, however
+	 * often the SIM lists it.
 	 */
-	for (l = l_queue_get_entries(files); l; l = l->next) {
-		struct stk_file *file = l->data;
-		uint32_t mf, df, ef;
+	for (i = 0; i < L_ARRAY_SIZE(sim_refresh_init_files); i++)
+		paths[i] = sim_refresh_init_files[i].path;
 
-		if (file->len != 6)
-			continue;
+	if (!reinit_naa)
+		matched = stk_refresh_match_files(files, paths,
+							L_ARRAY_SIZE(paths));
 
-		mf = (file->file[0] << 8) | (file->file[1] << 0);
-		df = (file->file[2] << 8) | (file->file[3] << 0);
-		ef = (file->file[4] << 8) | (file->file[5] << 0);
-
-		if (mf != 0x3f00)
+	for (i = 0; i < L_ARRAY_SIZE(paths) && !reinit_naa; i++) {
+		if (!(matched & (1u << i)))
 			continue;
 
-		/*
-		 * 8.18: "the path '3F007FFF' indicates the relevant
-		 * NAA Application dedicated file;".
-		 */
-		if (df == 0x7fff)
-			df = 0x7f20;
-
-#define DFGSM (0x7f20 << 16)
-#define DFTEL (0x7f10 << 16)
+		if (sim_refresh_init_files[i].affects_init &&
+				!sim_refresh_init_files[i].affects_init(sim))
+			continue;
 
-		switch ((df << 16) | ef) {
-		case DFGSM | SIM_EFEST_FILEID:
-		case DFGSM | SIM_EFUST_FILEID: /* aka. EFSST */
-		case DFGSM | SIM_EFPHASE_FILEID:
-		case DFGSM | SIM_EFAD_FILEID:
-		case DFTEL | SIM_EFBDN_FILEID:
-		case DFTEL | SIM_EFADN_FILEID:
-		case DFGSM | SIM_EF_CPHS_INFORMATION_FILEID:
-			reinit_naa = TRUE;
-			break;
+		if (sim_refresh_init_files[i].verify_cb &&
+				sim->context != NULL) {
+			verify[n_verify++] = i;
+			continue;
 		}
+
+		reinit_naa = true;
 	}
 
 	/* Flush cached content for affected files */
@@ -3651,18 +3750,31 @@ void __ofono_sim_refresh(struct ofono_sim *sim, struct l_queue *files,
 		}
 	}
 
-	if (reinit_naa) {
-		sim->state = OFONO_SIM_STATE_RESETTING;
-		__ofono_modem_sim_reset(__ofono_atom_get_modem(sim->atom));
+	if (reinit_naa)
+		sim_reinit_naa(sim);
+	else {
+		/*
+		 * Re-read the initialisation files whose derived state
+		 * can be compared in place, the callbacks fall back to
+		 * a full reinitialization if anything changed.  Any
+		 * reinitialization frees sim->context, which cancels
+		 * the remaining reads.
+		 */
+		for (i = 0; i < n_verify; i++) {
+			const unsigned int idx = verify[i];
 
-		/* Force the sim state out of READY */
-		sim_free_main_state(sim);
-		call_state_watches(sim);
+			ofono_sim_read(sim->context,
+				sim_refresh_init_files[idx].path & 0xffff,
+				OFONO_SIM_FILE_STRUCTURE_TRANSPARENT,
+				sim_refresh_init_files[idx].verify_cb, sim);
+		}
 	}
 
 	/*
 	 * Notify the subscribers of files that have changed and who
-	 * haven't unsubsribed during the SIM state change.
+	 * haven't unsubsribed during the SIM state change.  Atoms that
+	 * derive state from a file watch it, so only the affected atoms
+	 * re-read their files and signal the changes over D-Bus.
 	 */
 	if (full_file_change)
 		sim_fs_notify_file_watches(sim->simfs, -1);
@@ -3692,7 +3804,7 @@ static void close_channel_cb(const struct ofono_error *error, void *data)
 	if (error->type != OFONO_ERROR_TYPE_NO_ERROR)
 		DBG("session %d failed to close", session->session_id);
 
-	if (g_slist_length(session->watches->items) > 0 &&
+	if (session->watches->items != NULL &&
 				session->state == SESSION_STATE_OPENING) {
 		/*
 		 * An atom requested to open during a close, we can re-open
@@ -3711,7 +3823,7 @@ static void open_channel_cb(const struct ofono_error *error, int session_id,
 		void *data)
 {
 	struct ofono_sim_aid_session *session = data;
-	GSList *iter = session->watches->items;
+	GList *iter = session->watches->items;
 	ofono_bool_t active = TRUE;
 
 	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
@@ -3721,7 +3833,7 @@ static void open_channel_cb(const struct ofono_error *error, int session_id,
 		goto end;
 	}
 
-	if (g_slist_length(iter) == 0) {
+	if (iter == NULL) {
 		/*
 		 * All watchers stopped watching before the channel could open.
 		 * Close the channel.
@@ -3745,7 +3857,7 @@ end:
 
 		notify(active, session->session_id, item->notify_data);
 
-		iter = g_slist_next(iter);
+		iter = g_list_next(iter);
 	}
 }
 
@@ -3770,7 +3882,7 @@ unsigned int __ofono_sim_add_session_watch(
 	item->destroy = destroy;
 	item->notify_data = data;
 
-	if (g_slist_length(session->watches->items) == 0 &&
+	if (session->watches->items == NULL &&
 			session->state == SESSION_STATE_INACTIVE) {
 		/*
 		 * If the session is inactive and there are no watchers, open
@@ -3802,7 +3914,7 @@ void __ofono_sim_remove_session_watch(struct ofono_sim_aid_session *session,
 {
 	__ofono_watchlist_remove_item(session->watches, id);
 
-	if (g_slist_length(session->watches->items) == 0) {
+	if (session->watches->items == NULL) {
 		/* last watcher, close session */
 		session->state = SESSION_STATE_CLOSING;
 		session->sim->driver->close_channel(session->sim,
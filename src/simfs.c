@@ -39,6 +39,7 @@
 #include "simfs.h"
 #include "simutil.h"
 #include "storage.h"
+#include "util.h"
 
 #define SIM_CACHE_MODE 0600
 #define SIM_CACHE_BASEPATH STORAGEDIR "/%s-%i"
@@ -47,9 +48,10 @@
 #define SIM_CACHE_HEADER_SIZE 39
 #define SIM_FILE_INFO_SIZE 7
 #define SIM_IMAGE_CACHE_BASEPATH STORAGEDIR "/%s-%i/images"
-#define SIM_IMAGE_CACHE_PATH SIM_IMAGE_CACHE_BASEPATH "/%d.xpm"
+#define SIM_IMAGE_CACHE_PATH SIM_IMAGE_CACHE_BASEPATH "/%s.xpm"
+#define SIM_IMAGE_KEY_SIZE 19	/* EFimg descriptor in hex */
 
-#define SIM_FS_VERSION 2
+#define SIM_FS_VERSION 3
 
 static gboolean sim_fs_op_next(gpointer user_data);
 static gboolean sim_fs_op_read_record(gpointer user);
@@ -71,6 +73,8 @@ struct sim_fs_op {
 	gboolean is_read;
 	void *userdata;
 	struct ofono_sim_context *context;
+	gint64 start;			/* When the driver was first asked */
+	gboolean failed;
 };
 
 struct ofono_sim_context {
@@ -89,6 +93,7 @@ struct sim_fs {
 	struct ofono_sim_aid_session *session;
 	int session_id;
 	unsigned int watch_id;
+	GHashTable *images;
 };
 
 static void sim_fs_op_free(gpointer pointer)
@@ -124,6 +129,8 @@ void sim_fs_free(struct sim_fs *fs)
 	if (fs->watch_id)
 		__ofono_sim_remove_session_watch(fs->session, fs->watch_id);
 
+	g_hash_table_destroy(fs->images);
+
 	g_free(fs);
 }
 
@@ -145,6 +152,10 @@ struct sim_fs *sim_fs_new(struct ofono_sim *sim,
 	fs->driver = driver;
 	fs->fd = -1;
 
+	/* Decoded images of the current SIM, keyed by EFimg descriptor */
+	fs->images = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, g_free);
+
 	return fs;
 }
 
@@ -248,7 +259,7 @@ void sim_fs_notify_file_watches(struct sim_fs *fs, int id)
 
 	for (l = fs->contexts; l; l = l->next) {
 		struct ofono_sim_context *context = l->data;
-		GSList *k;
+		GList *k;
 
 		if (context->file_watches == NULL)
 			continue;
@@ -264,10 +275,33 @@ void sim_fs_notify_file_watches(struct sim_fs *fs, int id)
 
 }
 
+static void sim_fs_record_latency(struct sim_fs *fs, struct sim_fs_op *op)
+{
+	struct ofono_modem *modem = ofono_sim_get_modem(fs->sim);
+	const char *group;
+	char name[8];
+
+	if (op->info_only == TRUE)
+		group = "sim-info";
+	else if (op->is_read == TRUE)
+		group = "sim-read";
+	else
+		group = "sim-write";
+
+	snprintf(name, sizeof(name), "%04X", op->id);
+
+	ofono_modem_record_latency(modem, group, name,
+					g_get_monotonic_time() - op->start,
+					!op->failed);
+}
+
 static void sim_fs_end_current(struct sim_fs *fs)
 {
 	struct sim_fs_op *op = g_queue_pop_head(fs->op_q);
 
+	if (op->start)
+		sim_fs_record_latency(fs, op);
+
 	if (g_queue_get_length(fs->op_q) > 0)
 		fs->op_source = g_idle_add(sim_fs_op_next, fs);
 	else if (fs->watch_id) /* release the session if no pending reads */
@@ -287,6 +321,8 @@ static void sim_fs_op_error(struct sim_fs *fs)
 {
 	struct sim_fs_op *op = g_queue_peek_head(fs->op_q);
 
+	op->failed = TRUE;
+
 	if (op->cb == NULL) {
 		sim_fs_end_current(fs);
 		return;
@@ -946,6 +982,8 @@ static gboolean sim_fs_op_next(gpointer user_data)
 		if (sim_fs_op_check_cached(fs))
 			return FALSE;
 
+		op->start = g_get_monotonic_time();
+
 		if (!fs->session) {
 			driver->read_file_info(fs->sim, op->id,
 						op->path_len ? op->path : NULL,
@@ -963,6 +1001,8 @@ static gboolean sim_fs_op_next(gpointer user_data)
 						fs, session_destroy_cb);
 		}
 	} else {
+		op->start = g_get_monotonic_time();
+
 		switch (op->structure) {
 		case OFONO_SIM_FILE_STRUCTURE_TRANSPARENT:
 			driver->write_file_transparent(fs->sim, op->id, 0,
@@ -1142,10 +1182,22 @@ int sim_fs_write(struct ofono_sim_context *context, int id,
 	return 0;
 }
 
-void sim_fs_cache_image(struct sim_fs *fs, const char *image, int id)
+/*
+ * Images are cached by their 9 byte EFimg descriptor rather than by the
+ * record number, so records describing the same image instance share
+ * one entry, both in memory and on disk.
+ */
+static const char *image_key(const unsigned char *efimg, char *key)
+{
+	return encode_hex_own_buf(efimg, 9, 0, key);
+}
+
+void sim_fs_cache_image(struct sim_fs *fs, const char *image,
+				const unsigned char *efimg)
 {
 	const char *imsi;
 	enum ofono_sim_phase phase;
+	char key[SIM_IMAGE_KEY_SIZE];
 
 	if (fs == NULL || image == NULL)
 		return;
@@ -1158,15 +1210,20 @@ void sim_fs_cache_image(struct sim_fs *fs, const char *image, int id)
 	if (phase == OFONO_SIM_PHASE_UNKNOWN)
 		return;
 
+	image_key(efimg, key);
+
+	g_hash_table_replace(fs->images, g_strdup(key), g_strdup(image));
+
 	write_file((const unsigned char *) image, strlen(image),
 			SIM_CACHE_MODE, SIM_IMAGE_CACHE_PATH, imsi,
-			phase, id);
+			phase, key);
 }
 
-char *sim_fs_get_cached_image(struct sim_fs *fs, int id)
+char *sim_fs_get_cached_image(struct sim_fs *fs, const unsigned char *efimg)
 {
 	const char *imsi;
 	enum ofono_sim_phase phase;
+	char key[SIM_IMAGE_KEY_SIZE];
 	unsigned short image_length;
 	int fd;
 	char *buffer;
@@ -1185,7 +1242,13 @@ char *sim_fs_get_cached_image(struct sim_fs *fs, int id)
 	if (phase == OFONO_SIM_PHASE_UNKNOWN)
 		return NULL;
 
-	path = g_strdup_printf(SIM_IMAGE_CACHE_PATH, imsi, phase, id);
+	image_key(efimg, key);
+
+	buffer = g_hash_table_lookup(fs->images, key);
+	if (buffer != NULL)
+		return g_strdup(buffer);
+
+	path = g_strdup_printf(SIM_IMAGE_CACHE_PATH, imsi, phase, key);
 
 	L_TFR(stat(path, &st_buf));
 	fd = L_TFR(open(path, O_RDONLY));
@@ -1210,6 +1273,8 @@ char *sim_fs_get_cached_image(struct sim_fs *fs, int id)
 		return NULL;
 	}
 
+	g_hash_table_replace(fs->images, g_strdup(key), g_strdup(buffer));
+
 	return buffer;
 }
 
@@ -1233,16 +1298,14 @@ static void remove_cachefile(const char *imsi, enum ofono_sim_phase phase,
 static void remove_imagefile(const char *imsi, enum ofono_sim_phase phase,
 				const struct dirent *file)
 {
-	int id;
 	char *path;
 
 	if (file->d_type != DT_REG)
 		return;
 
-	if (sscanf(file->d_name, "%d", &id) != 1)
-		return;
-
-	path = g_strdup_printf(SIM_IMAGE_CACHE_PATH, imsi, phase, id);
+	/* Also catches images cached by record number in older versions */
+	path = g_strdup_printf(SIM_IMAGE_CACHE_BASEPATH "/%s", imsi, phase,
+				file->d_name);
 	remove(path);
 	g_free(path);
 }
@@ -1256,6 +1319,9 @@ void sim_fs_check_version(struct sim_fs *fs)
 	if (imsi == NULL || phase == OFONO_SIM_PHASE_UNKNOWN)
 		return;
 
+	/* Called once the SIM is ready, drop images of any previous SIM */
+	g_hash_table_remove_all(fs->images);
+
 	if (read_file(&version, 1, SIM_CACHE_VERSION, imsi, phase) == 1)
 		if (version == SIM_FS_VERSION)
 			return;
@@ -1309,6 +1375,8 @@ void sim_fs_image_cache_flush(struct sim_fs *fs)
 
 	g_free(path);
 
+	g_hash_table_remove_all(fs->images);
+
 	if (len <= 0)
 		return;
 
@@ -1321,11 +1389,18 @@ void sim_fs_image_cache_flush(struct sim_fs *fs)
 	g_free(entries);
 }
 
-void sim_fs_image_cache_flush_file(struct sim_fs *fs, int id)
+void sim_fs_image_cache_flush_file(struct sim_fs *fs,
+					const unsigned char *efimg)
 {
 	const char *imsi = ofono_sim_get_imsi(fs->sim);
 	enum ofono_sim_phase phase = ofono_sim_get_phase(fs->sim);
-	char *path = g_strdup_printf(SIM_IMAGE_CACHE_PATH, imsi, phase, id);
+	char key[SIM_IMAGE_KEY_SIZE];
+	char *path;
+
+	image_key(efimg, key);
+	path = g_strdup_printf(SIM_IMAGE_CACHE_PATH, imsi, phase, key);
+
+	g_hash_table_remove(fs->images, key);
 
 	remove(path);
 	g_free(path);
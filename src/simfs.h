@@ -59,14 +59,16 @@ int sim_fs_write(struct ofono_sim_context *context, int id,
 			enum ofono_sim_file_structure structure, int record,
 			const unsigned char *data, int length, void *userdata);
 
-char *sim_fs_get_cached_image(struct sim_fs *fs, int id);
+char *sim_fs_get_cached_image(struct sim_fs *fs, const unsigned char *efimg);
 
-void sim_fs_cache_image(struct sim_fs *fs, const char *image, int id);
+void sim_fs_cache_image(struct sim_fs *fs, const char *image,
+				const unsigned char *efimg);
 
 void sim_fs_cache_flush(struct sim_fs *fs);
 void sim_fs_cache_flush_file(struct sim_fs *fs, int id);
 void sim_fs_image_cache_flush(struct sim_fs *fs);
-void sim_fs_image_cache_flush_file(struct sim_fs *fs, int id);
+void sim_fs_image_cache_flush_file(struct sim_fs *fs,
+					const unsigned char *efimg);
 
 void sim_fs_free(struct sim_fs *fs);
 void sim_fs_context_free(struct ofono_sim_context *context);
@@ -1285,42 +1285,57 @@ static int find_ef_by_id(const void *key, const void *value)
 	return id - info->id;
 }
 
-struct sim_ef_info *sim_ef_db_lookup(unsigned short id)
-{
-	struct sim_ef_info *result;
-	unsigned int nelem = sizeof(ef_db) / sizeof(struct sim_ef_info);
+/*
+ * ef_db is static, so the paths of every file and the location of each
+ * entry can be worked out once and reused for every subsequent SIM file
+ * operation.  The index is an open-addressed table with linear probing,
+ * sized to keep the load factor low enough that lookups almost always
+ * resolve on the first probe.
+ */
+#define EF_DB_INDEX_SIZE 128
+
+struct ef_db_index_entry {
+	struct sim_ef_info *info;
+	unsigned char path_2g[6];
+	unsigned char path_2g_len;
+	unsigned char path_3g[6];
+	unsigned char path_3g_len;
+};
+
+/* Probing relies on free slots, grow the table along with ef_db */
+G_STATIC_ASSERT(G_N_ELEMENTS(ef_db) <= EF_DB_INDEX_SIZE / 2);
 
-	result = bsearch(GUINT_TO_POINTER((unsigned int) id), ef_db, nelem,
-				sizeof(struct sim_ef_info), find_ef_by_id);
+static struct ef_db_index_entry ef_db_index[EF_DB_INDEX_SIZE];
+static gboolean ef_db_index_ready;
 
-	return result;
+static inline unsigned int ef_db_hash(unsigned short id)
+{
+	return (id ^ (id >> 4) ^ (id >> 8)) & (EF_DB_INDEX_SIZE - 1);
 }
 
-unsigned int sim_ef_db_get_path_2g(unsigned short id, unsigned char out_path[])
+static unsigned int ef_db_build_path(struct sim_ef_info *info, gboolean is_3g,
+					unsigned char out_path[])
 {
-	struct sim_ef_info *info;
 	unsigned int nelem = sizeof(ef_db) / sizeof(struct sim_ef_info);
+	unsigned short parent = is_3g ? info->parent3g : info->parent2g;
 	unsigned char path[6];
 	int i = 0;
 	int j;
 
-	info = bsearch(GUINT_TO_POINTER((unsigned int) id), ef_db, nelem,
-				sizeof(struct sim_ef_info), find_ef_by_id);
-	if (info == NULL)
-		return 0;
-
-	path[i++] = info->parent2g & 0xff;
-	path[i++] = info->parent2g >> 8;
+	path[i++] = parent & 0xff;
+	path[i++] = parent >> 8;
 
-	while (info->parent2g != ROOTMF) {
-		info = bsearch(GUINT_TO_POINTER((unsigned int) info->parent2g),
+	while (parent != ROOTMF) {
+		info = bsearch(GUINT_TO_POINTER((unsigned int) parent),
 				ef_db, nelem, sizeof(struct sim_ef_info),
 				find_ef_by_id);
-		if (info == NULL)
+		if (info == NULL || i == sizeof(path))
 			return 0;
 
-		path[i++] = info->parent2g & 0xff;
-		path[i++] = info->parent2g >> 8;
+		parent = is_3g ? info->parent3g : info->parent2g;
+
+		path[i++] = parent & 0xff;
+		path[i++] = parent >> 8;
 	}
 
 	for (j = 0; j < i; j++)
@@ -1329,37 +1344,78 @@ unsigned int sim_ef_db_get_path_2g(unsigned short id, unsigned char out_path[])
 	return i;
 }
 
-unsigned int sim_ef_db_get_path_3g(unsigned short id, unsigned char out_path[])
+static void ef_db_index_init(void)
 {
-	struct sim_ef_info *info;
 	unsigned int nelem = sizeof(ef_db) / sizeof(struct sim_ef_info);
-	unsigned char path[6];
-	int i = 0;
-	int j;
+	unsigned int i;
+
+	for (i = 0; i < nelem; i++) {
+		struct sim_ef_info *info = &ef_db[i];
+		unsigned int slot = ef_db_hash(info->id);
+		struct ef_db_index_entry *entry;
+
+		while (ef_db_index[slot].info != NULL)
+			slot = (slot + 1) & (EF_DB_INDEX_SIZE - 1);
+
+		entry = &ef_db_index[slot];
+		entry->info = info;
+		entry->path_2g_len = ef_db_build_path(info, FALSE,
+							entry->path_2g);
+		entry->path_3g_len = ef_db_build_path(info, TRUE,
+							entry->path_3g);
+	}
 
-	info = bsearch(GUINT_TO_POINTER((unsigned int) id), ef_db, nelem,
-				sizeof(struct sim_ef_info), find_ef_by_id);
-	if (info == NULL)
-		return 0;
+	ef_db_index_ready = TRUE;
+}
 
-	path[i++] = info->parent3g & 0xff;
-	path[i++] = info->parent3g >> 8;
+static struct ef_db_index_entry *ef_db_index_lookup(unsigned short id)
+{
+	unsigned int slot;
 
-	while (info->parent3g != ROOTMF) {
-		info = bsearch(GUINT_TO_POINTER((unsigned int) info->parent3g),
-				ef_db, nelem, sizeof(struct sim_ef_info),
-				find_ef_by_id);
-		if (info == NULL)
-			return 0;
+	if (!ef_db_index_ready)
+		ef_db_index_init();
 
-		path[i++] = info->parent3g & 0xff;
-		path[i++] = info->parent3g >> 8;
+	for (slot = ef_db_hash(id); ef_db_index[slot].info != NULL;
+			slot = (slot + 1) & (EF_DB_INDEX_SIZE - 1)) {
+		if (ef_db_index[slot].info->id == id)
+			return &ef_db_index[slot];
 	}
 
-	for (j = 0; j < i; j++)
-		out_path[j] = path[i - j - 1];
+	return NULL;
+}
 
-	return i;
+struct sim_ef_info *sim_ef_db_lookup(unsigned short id)
+{
+	struct ef_db_index_entry *entry = ef_db_index_lookup(id);
+
+	if (entry == NULL)
+		return NULL;
+
+	return entry->info;
+}
+
+unsigned int sim_ef_db_get_path_2g(unsigned short id, unsigned char out_path[])
+{
+	struct ef_db_index_entry *entry = ef_db_index_lookup(id);
+
+	if (entry == NULL)
+		return 0;
+
+	memcpy(out_path, entry->path_2g, entry->path_2g_len);
+
+	return entry->path_2g_len;
+}
+
+unsigned int sim_ef_db_get_path_3g(unsigned short id, unsigned char out_path[])
+{
+	struct ef_db_index_entry *entry = ef_db_index_lookup(id);
+
+	if (entry == NULL)
+		return 0;
+
+	memcpy(out_path, entry->path_3g, entry->path_3g_len);
+
+	return entry->path_3g_len;
 }
 
 gboolean sim_parse_3g_get_response(const unsigned char *data, int len,
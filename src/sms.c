@@ -69,6 +69,7 @@ struct ofono_sms {
 	GQueue *txq;
 	unsigned long tx_counter;
 	guint tx_source;
+	gint64 tx_start;
 	struct ofono_message_waiting *mw;
 	unsigned int mw_watch;
 	ofono_bool_t registered;
@@ -722,6 +723,10 @@ static void tx_finished(const struct ofono_error *error, int mr, void *data)
 
 	sms->flags &= ~MESSAGE_MANAGER_FLAG_TXQ_ACTIVE;
 
+	ofono_modem_record_latency(__ofono_atom_get_modem(sms->atom),
+				"sms", "submit",
+				g_get_monotonic_time() - sms->tx_start, ok);
+
 	if (ok == FALSE) {
 		/* Retry again when back in online mode */
 		/* Note this does not increment retry count */
@@ -806,6 +811,7 @@ static gboolean tx_next(gpointer user_data)
 		send_mms = 1;
 
 	sms->flags |= MESSAGE_MANAGER_FLAG_TXQ_ACTIVE;
+	sms->tx_start = g_get_monotonic_time();
 
 	sms->driver->submit(sms, pdu->pdu, pdu->pdu_len, pdu->tpdu_len,
 				send_mms, tx_finished, sms);
@@ -1225,7 +1231,7 @@ static void dispatch_app_datagram(struct ofono_sms *sms,
 
 	ofono_sms_datagram_notify_cb_t notify;
 	struct sms_handler *h;
-	GSList *l;
+	GList *l;
 	gboolean dispatched = FALSE;
 
 	ts = sms_scts_to_time(scts, &remote);
@@ -1270,7 +1276,7 @@ static void dispatch_text_message(struct ofono_sms *sms,
 	const char *str = buf;
 	ofono_sms_text_notify_cb_t notify;
 	struct sms_handler *h;
-	GSList *l;
+	GList *l;
 
 	if (message == NULL)
 		return;
@@ -0,0 +1,224 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <glib.h>
+#include <gdbus.h>
+
+#include "ofono.h"
+#include "histogram.h"
+
+struct ofono_stats {
+	char *path;
+	GHashTable *histograms;		/* "group:name" -> histogram */
+};
+
+void __ofono_stats_record(struct ofono_stats *stats, const char *group,
+				const char *name, unsigned int usec,
+				ofono_bool_t ok)
+{
+	struct histogram *h;
+	char key[64];
+
+	snprintf(key, sizeof(key), "%s:%s", group, name);
+
+	h = g_hash_table_lookup(stats->histograms, key);
+	if (h == NULL) {
+		h = g_try_new(struct histogram, 1);
+		if (h == NULL)
+			return;
+
+		histogram_init(h);
+		g_hash_table_insert(stats->histograms, g_strdup(key), h);
+	}
+
+	histogram_add(h, usec, ok);
+}
+
+static void append_buckets(DBusMessageIter *dict, const struct histogram *h)
+{
+	DBusMessageIter entry, variant, array, bucket;
+	const char *key = "Histogram";
+	unsigned int i;
+
+	dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY,
+						NULL, &entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+	dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT,
+					"a(uu)", &variant);
+	dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY,
+					"(uu)", &array);
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		dbus_uint32_t upper = histogram_bucket_upper(i);
+
+		if (h->buckets[i] == 0)
+			continue;
+
+		dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT,
+							NULL, &bucket);
+		dbus_message_iter_append_basic(&bucket, DBUS_TYPE_UINT32,
+							&upper);
+		dbus_message_iter_append_basic(&bucket, DBUS_TYPE_UINT32,
+							&h->buckets[i]);
+		dbus_message_iter_close_container(&array, &bucket);
+	}
+
+	dbus_message_iter_close_container(&variant, &array);
+	dbus_message_iter_close_container(&entry, &variant);
+	dbus_message_iter_close_container(dict, &entry);
+}
+
+static void append_histogram(DBusMessageIter *array, const char *key,
+				const struct histogram *h)
+{
+	DBusMessageIter entry, dict;
+	dbus_uint32_t value;
+
+	dbus_message_iter_open_container(array, DBUS_TYPE_DICT_ENTRY,
+						NULL, &entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+	dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+
+	ofono_dbus_dict_append(&dict, "Count", DBUS_TYPE_UINT32, &h->count);
+	ofono_dbus_dict_append(&dict, "Errors", DBUS_TYPE_UINT32, &h->errors);
+	ofono_dbus_dict_append(&dict, "Minimum", DBUS_TYPE_UINT32, &h->min);
+	ofono_dbus_dict_append(&dict, "Maximum", DBUS_TYPE_UINT32, &h->max);
+
+	value = h->sum / h->count;
+	ofono_dbus_dict_append(&dict, "Average", DBUS_TYPE_UINT32, &value);
+
+	value = histogram_percentile(h, 50);
+	ofono_dbus_dict_append(&dict, "Median", DBUS_TYPE_UINT32, &value);
+
+	value = histogram_percentile(h, 90);
+	ofono_dbus_dict_append(&dict, "Percentile90", DBUS_TYPE_UINT32,
+								&value);
+
+	value = histogram_percentile(h, 99);
+	ofono_dbus_dict_append(&dict, "Percentile99", DBUS_TYPE_UINT32,
+								&value);
+
+	append_buckets(&dict, h);
+
+	dbus_message_iter_close_container(&entry, &dict);
+	dbus_message_iter_close_container(array, &entry);
+}
+
+static DBusMessage *stats_get_statistics(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct ofono_stats *stats = data;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter array;
+	GHashTableIter hiter;
+	gpointer key, value;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_ARRAY_AS_STRING
+					OFONO_PROPERTIES_ARRAY_SIGNATURE
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&array);
+
+	g_hash_table_iter_init(&hiter, stats->histograms);
+
+	while (g_hash_table_iter_next(&hiter, &key, &value))
+		append_histogram(&array, key, value);
+
+	dbus_message_iter_close_container(&iter, &array);
+
+	return reply;
+}
+
+static DBusMessage *stats_reset(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct ofono_stats *stats = data;
+
+	g_hash_table_remove_all(stats->histograms);
+
+	return dbus_message_new_method_return(msg);
+}
+
+static const GDBusMethodTable stats_methods[] = {
+	{ GDBUS_METHOD("GetStatistics",
+			NULL, GDBUS_ARGS({ "statistics", "a{sa{sv}}" }),
+			stats_get_statistics) },
+	{ GDBUS_METHOD("Reset", NULL, NULL, stats_reset) },
+	{ }
+};
+
+struct ofono_stats *__ofono_stats_create(const char *path)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+	struct ofono_stats *stats;
+
+	stats = g_try_new0(struct ofono_stats, 1);
+	if (stats == NULL)
+		return NULL;
+
+	stats->path = g_strdup(path);
+	stats->histograms = g_hash_table_new_full(g_str_hash, g_str_equal,
+							g_free, g_free);
+
+	if (!g_dbus_register_interface(conn, path,
+					OFONO_STATISTICS_INTERFACE,
+					stats_methods, NULL, NULL,
+					stats, NULL)) {
+		ofono_error("Could not register Statistics on %s", path);
+		g_hash_table_destroy(stats->histograms);
+		g_free(stats->path);
+		g_free(stats);
+
+		return NULL;
+	}
+
+	return stats;
+}
+
+void __ofono_stats_remove(struct ofono_stats *stats)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+
+	if (stats == NULL)
+		return;
+
+	g_dbus_unregister_interface(conn, stats->path,
+					OFONO_STATISTICS_INTERFACE);
+
+	g_hash_table_destroy(stats->histograms);
+	g_free(stats->path);
+	g_free(stats);
+}
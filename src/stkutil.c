@@ -2291,87 +2291,91 @@ static dataobj_handler list_handler_for_type(enum stk_data_object_type type)
 	}
 }
 
+/* Largest number of data objects any command parser asks for, plus slack */
+#define DATAOBJ_MAX_ENTRIES 16
+
 struct dataobj_handler_entry {
 	enum stk_data_object_type type;
 	int flags;
 	void *data;
+	dataobj_handler handler;
 };
 
 static enum stk_command_parse_result parse_dataobj(
 					struct comprehension_tlv_iter *iter,
 					enum stk_data_object_type type, ...)
 {
-	GSList *entries = NULL;
-	GSList *l;
+	struct dataobj_handler_entry entries[DATAOBJ_MAX_ENTRIES];
+	unsigned int n_entries = 0;
+	unsigned int next = 0;
+	unsigned int i;
 	va_list args;
 	bool minimum_set = true;
 	bool parse_error = false;
 
+	/*
+	 * The expected data objects and their order are fixed for every
+	 * command, resolve them into a table on the stack once and then
+	 * match the TLV stream against it in a single pass.
+	 */
 	va_start(args, type);
 
 	while (type != STK_DATA_OBJECT_TYPE_INVALID) {
 		struct dataobj_handler_entry *entry;
 
-		entry = g_new0(struct dataobj_handler_entry, 1);
+		if (n_entries == DATAOBJ_MAX_ENTRIES) {
+			va_end(args);
+			return STK_PARSE_RESULT_DATA_NOT_UNDERSTOOD;
+		}
 
+		entry = &entries[n_entries++];
 		entry->type = type;
 		entry->flags = va_arg(args, int);
 		entry->data = va_arg(args, void *);
 
+		if (entry->flags & DATAOBJ_FLAG_LIST)
+			entry->handler = list_handler_for_type(type);
+		else
+			entry->handler = handler_for_type(type);
+
 		type = va_arg(args, enum stk_data_object_type);
-		entries = g_slist_prepend(entries, entry);
 	}
 
 	va_end(args);
 
-	entries = g_slist_reverse(entries);
-
-	l = entries;
 	while (comprehension_tlv_iter_next(iter) == TRUE) {
-		dataobj_handler handler;
-		struct dataobj_handler_entry *entry;
-		GSList *l2;
-
-		for (l2 = l; l2; l2 = l2->next) {
-			entry = l2->data;
+		unsigned short tag = comprehension_tlv_iter_get_tag(iter);
+		struct dataobj_handler_entry *entry = NULL;
 
-			if (comprehension_tlv_iter_get_tag(iter) == entry->type)
+		for (i = next; i < n_entries; i++) {
+			if (tag == entries[i].type) {
+				entry = &entries[i];
 				break;
+			}
 
 			/* Can't skip over mandatory objects */
-			if (entry->flags & DATAOBJ_FLAG_MANDATORY) {
-				l2 = NULL;
+			if (entries[i].flags & DATAOBJ_FLAG_MANDATORY)
 				break;
-			}
 		}
 
-		if (l2 == NULL) {
+		if (entry == NULL) {
 			if (comprehension_tlv_get_cr(iter) == TRUE)
 				parse_error = true;
 
 			continue;
 		}
 
-		if (entry->flags & DATAOBJ_FLAG_LIST)
-			handler = list_handler_for_type(entry->type);
-		else
-			handler = handler_for_type(entry->type);
-
-		if (!handler(iter, entry->data))
+		if (!entry->handler(iter, entry->data))
 			parse_error = true;
 
-		l = l2->next;
+		next = i + 1;
 	}
 
-	for (; l; l = l->next) {
-		struct dataobj_handler_entry *entry = l->data;
-
-		if (entry->flags & DATAOBJ_FLAG_MANDATORY)
+	for (i = next; i < n_entries; i++) {
+		if (entries[i].flags & DATAOBJ_FLAG_MANDATORY)
 			minimum_set = false;
 	}
 
-	g_slist_free_full(entries, g_free);
-
 	if (!minimum_set)
 		return STK_PARSE_RESULT_MISSING_VALUE;
 	if (parse_error)
@@ -4851,13 +4855,9 @@ static bool build_dataobj_buffer_size(struct stk_tlv_builder *tlv,
 }
 
 /* Described in TS 102.223 Section 8.56 */
-static bool build_dataobj_channel_status(struct stk_tlv_builder *tlv,
-						const void *data, bool cr)
+static bool channel_status_bytes(const struct stk_channel *channel,
+					uint8_t *byte)
 {
-	const struct stk_channel *channel = data;
-	uint8_t tag = STK_DATA_OBJECT_TYPE_CHANNEL_STATUS;
-	uint8_t byte[2];
-
 	switch (channel->status) {
 	case STK_CHANNEL_PACKET_DATA_SERVICE_NOT_ACTIVATED:
 	case STK_CHANNEL_TCP_IN_CLOSED_STATE:
@@ -4877,8 +4877,23 @@ static bool build_dataobj_channel_status(struct stk_tlv_builder *tlv,
 		byte[0] = channel->id;
 		byte[1] = 0x05;
 		break;
+	default:
+		return false;
 	}
 
+	return true;
+}
+
+static bool build_dataobj_channel_status(struct stk_tlv_builder *tlv,
+						const void *data, bool cr)
+{
+	const struct stk_channel *channel = data;
+	uint8_t tag = STK_DATA_OBJECT_TYPE_CHANNEL_STATUS;
+	uint8_t byte[2];
+
+	if (!channel_status_bytes(channel, byte))
+		return false;
+
 	return stk_tlv_builder_open_container(tlv, cr, tag, false) &&
 			stk_tlv_builder_append_bytes(tlv, byte, 2) &&
 			stk_tlv_builder_close_container(tlv);
@@ -5618,36 +5633,30 @@ static bool build_send_data(struct stk_tlv_builder *builder,
 				NULL);
 }
 
+/*
+ * Every terminal response starts with the fixed size Command Details and
+ * Device Identities data objects, write them out directly.
+ */
+#define STK_RESPONSE_HEADER_LEN 9
+
 const uint8_t *stk_pdu_from_response(const struct stk_response *response,
 						unsigned int *out_length)
 {
 	struct stk_tlv_builder builder;
 	bool ok = true;
-	uint8_t tag;
 	static uint8_t pdu[512];
-
-	stk_tlv_builder_init(&builder, pdu, sizeof(pdu));
+	uint8_t *hdr = pdu;
 
 	/*
 	 * Encode command details, they come in order with
 	 * Command Details TLV first, followed by Device Identities TLV
 	 * and the Result TLV.  Comprehension required everywhere.
 	 */
-	tag = STK_DATA_OBJECT_TYPE_COMMAND_DETAILS;
-	if (!stk_tlv_builder_open_container(&builder, true, tag, false))
-		return NULL;
-
-	if (!stk_tlv_builder_append_byte(&builder, response->number))
-		return NULL;
-
-	if (!stk_tlv_builder_append_byte(&builder, response->type))
-		return NULL;
-
-	if (!stk_tlv_builder_append_byte(&builder, response->qualifier))
-		return NULL;
-
-	if (!stk_tlv_builder_close_container(&builder))
-		return NULL;
+	*hdr++ = 0x80 | STK_DATA_OBJECT_TYPE_COMMAND_DETAILS;
+	*hdr++ = 3;
+	*hdr++ = response->number;
+	*hdr++ = response->type;
+	*hdr++ = response->qualifier;
 
 	/*
 	 * TS 102 223 section 6.8 states:
@@ -5660,18 +5669,13 @@ const uint8_t *stk_pdu_from_response(const struct stk_response *response,
 	 * TS 102 384 conformance tests so we set it per command and per
 	 * data object type.
 	 */
-	tag = STK_DATA_OBJECT_TYPE_DEVICE_IDENTITIES;
-	if (!stk_tlv_builder_open_container(&builder, true, tag, false))
-		return NULL;
-
-	if (!stk_tlv_builder_append_byte(&builder, response->src))
-		return NULL;
-
-	if (!stk_tlv_builder_append_byte(&builder, response->dst))
-		return NULL;
+	*hdr++ = 0x80 | STK_DATA_OBJECT_TYPE_DEVICE_IDENTITIES;
+	*hdr++ = 2;
+	*hdr++ = response->src;
+	*hdr++ = response->dst;
 
-	if (!stk_tlv_builder_close_container(&builder))
-		return NULL;
+	stk_tlv_builder_init(&builder, pdu + STK_RESPONSE_HEADER_LEN,
+				sizeof(pdu) - STK_RESPONSE_HEADER_LEN);
 
 	if (!build_dataobj_result(&builder, &response->result, true))
 		return NULL;
@@ -5779,7 +5783,8 @@ const uint8_t *stk_pdu_from_response(const struct stk_response *response,
 		return NULL;
 
 	if (out_length)
-		*out_length = stk_tlv_builder_get_length(&builder);
+		*out_length = STK_RESPONSE_HEADER_LEN +
+				stk_tlv_builder_get_length(&builder);
 
 	return pdu;
 }
@@ -6038,6 +6043,132 @@ static bool build_envelope_terminal_apps(struct stk_tlv_builder *builder,
 				0, &ta->last, NULL);
 }
 
+/* Same encoding as build_dataobj_location_info */
+static uint8_t *put_location_info(uint8_t *p,
+					const struct stk_location_info *li)
+{
+	uint8_t *len;
+
+	if (li->mcc[0] == '\0')
+		return p;
+
+	*p++ = STK_DATA_OBJECT_TYPE_LOCATION_INFO;
+	len = p++;
+
+	sim_encode_mcc_mnc(p, li->mcc, li->mnc);
+	p += 3;
+
+	*p++ = li->lac_tac >> 8;
+	*p++ = li->lac_tac & 0xff;
+
+	if (li->has_ci) {
+		*p++ = li->ci >> 8;
+		*p++ = li->ci & 0xff;
+	}
+
+	if (li->has_ext_ci) {
+		*p++ = li->ext_ci >> 8;
+		*p++ = li->ext_ci & 0xff;
+	}
+
+	if (li->has_eutran_ci) {
+		*p++ = li->eutran_ci >> 20;
+		*p++ = (li->eutran_ci >> 12) & 0xff;
+		*p++ = (li->eutran_ci >> 4) & 0xff;
+		*p++ = ((li->eutran_ci << 4) | 0xf) & 0xff;
+	}
+
+	*len = p - len - 1;
+
+	return p;
+}
+
+/*
+ * Menu Selection and the frequent Event Downloads, Location Status and
+ * Data Available among them, are small, fixed-layout envelopes.  Write
+ * them out directly instead of going through the generic builders.
+ */
+static bool build_short_envelope(const struct stk_envelope *envelope,
+					uint8_t *buf, unsigned int *out_length)
+{
+	const struct stk_envelope_event_download *evt =
+		&envelope->event_download;
+	uint8_t *p = buf + 2;
+	uint8_t status[2];
+
+	switch (envelope->type) {
+	case STK_ENVELOPE_TYPE_MENU_SELECTION:
+		*p++ = 0x80 | STK_DATA_OBJECT_TYPE_DEVICE_IDENTITIES;
+		*p++ = 2;
+		*p++ = envelope->src;
+		*p++ = envelope->dst;
+
+		if (envelope->menu_selection.item_id != 0) {
+			*p++ = 0x80 | STK_DATA_OBJECT_TYPE_ITEM_ID;
+			*p++ = 1;
+			*p++ = envelope->menu_selection.item_id;
+		}
+
+		if (envelope->menu_selection.help_request) {
+			*p++ = STK_DATA_OBJECT_TYPE_HELP_REQUEST;
+			*p++ = 0;
+		}
+
+		break;
+	case STK_ENVELOPE_TYPE_EVENT_DOWNLOAD:
+		switch (evt->type) {
+		case STK_EVENT_TYPE_LOCATION_STATUS:
+		case STK_EVENT_TYPE_USER_ACTIVITY:
+		case STK_EVENT_TYPE_IDLE_SCREEN_AVAILABLE:
+		case STK_EVENT_TYPE_HCI_CONNECTIVITY_EVENT:
+			break;
+		case STK_EVENT_TYPE_DATA_AVAILABLE:
+			if (!channel_status_bytes(&evt->data_available.channel,
+							status))
+				return false;
+
+			break;
+		default:
+			return false;
+		}
+
+		*p++ = 0x80 | STK_DATA_OBJECT_TYPE_EVENT_LIST;
+		*p++ = 1;
+		*p++ = evt->type;
+		*p++ = 0x80 | STK_DATA_OBJECT_TYPE_DEVICE_IDENTITIES;
+		*p++ = 2;
+		*p++ = envelope->src;
+		*p++ = envelope->dst;
+
+		if (evt->type == STK_EVENT_TYPE_LOCATION_STATUS) {
+			*p++ = 0x80 | STK_DATA_OBJECT_TYPE_LOCATION_STATUS;
+			*p++ = 1;
+			*p++ = evt->location_status.state;
+			p = put_location_info(p, &evt->location_status.info);
+		} else if (evt->type == STK_EVENT_TYPE_DATA_AVAILABLE) {
+			*p++ = 0x80 | STK_DATA_OBJECT_TYPE_CHANNEL_STATUS;
+			*p++ = 2;
+			*p++ = status[0];
+			*p++ = status[1];
+			*p++ = 0x80 | STK_DATA_OBJECT_TYPE_CHANNEL_DATA_LENGTH;
+			*p++ = 1;
+			*p++ = MIN(evt->data_available.channel_data_len, 255);
+		}
+
+		break;
+	default:
+		return false;
+	}
+
+	buf[0] = envelope->type;
+	buf[1] = p - buf - 2;
+
+	if (out_length)
+		*out_length = p - buf;
+
+	return true;
+}
+
 const uint8_t *stk_pdu_from_envelope(const struct stk_envelope *envelope,
 						unsigned int *out_length)
 {
@@ -6047,6 +6178,9 @@ const uint8_t *stk_pdu_from_envelope(const struct stk_envelope *envelope,
 	static uint8_t buffer[512];
 	uint8_t *pdu;
 
+	if (build_short_envelope(envelope, buffer, out_length))
+		return buffer;
+
 	if (ber_tlv_builder_init(&btlv, buffer, sizeof(buffer)) != TRUE)
 		return NULL;
 
@@ -6535,3 +6669,48 @@ char *stk_image_to_xpm(const uint8_t *img, unsigned int len,
 	/* Caller must free char data */
 	return l_string_unwrap(xpm);
 }
+
+/*
+ * Match the file list of a REFRESH against @paths, given as DF << 16 | EF
+ * under the MF.  Returns a mask with bit n set if @paths[n] is listed,
+ * so each path is reported once however often the SIM repeats it.
+ */
+uint32_t stk_refresh_match_files(struct l_queue *files,
+					const uint32_t *paths,
+					unsigned int n_paths)
+{
+	const struct l_queue_entry *l;
+	uint32_t mask = 0;
+	unsigned int i;
+
+	if (n_paths > 32)
+		n_paths = 32;
+
+	for (l = l_queue_get_entries(files); l; l = l->next) {
+		const struct stk_file *file = l->data;
+		uint32_t mf, df, ef;
+
+		if (file->len != 6)
+			continue;
+
+		mf = (file->file[0] << 8) | (file->file[1] << 0);
+		df = (file->file[2] << 8) | (file->file[3] << 0);
+		ef = (file->file[4] << 8) | (file->file[5] << 0);
+
+		if (mf != 0x3f00)
+			continue;
+
+		/*
+		 * 8.18: "the path '3F007FFF' indicates the relevant
+		 * NAA Application dedicated file;".
+		 */
+		if (df == 0x7fff)
+			df = 0x7f20;
+
+		for (i = 0; i < n_paths; i++)
+			if (paths[i] == ((df << 16) | ef))
+				mask |= 1u << i;
+	}
+
+	return mask;
+}
@@ -1785,3 +1785,6 @@ char *stk_text_to_html(const char *text, const uint16_t *attrs, int num_attrs);
 char *stk_image_to_xpm(const uint8_t *img, unsigned int len,
 			enum stk_img_scheme scheme, const uint8_t *clut,
 			uint16_t clut_len);
+uint32_t stk_refresh_match_files(struct l_queue *files,
+					const uint32_t *paths,
+					unsigned int n_paths);
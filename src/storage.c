@@ -23,6 +23,7 @@
 #include <config.h>
 #endif
 
+#include <ofono/log.h>
 #include <ofono/storage.h>
 
 #include <string.h>
@@ -37,6 +38,31 @@
 
 #include "storage.h"
 
+#define STORAGE_SYNC_DELAY	1000	/* In milliseconds */
+#define STORAGE_CACHE_SIZE	16	/* Unused stores kept parsed */
+
+/*
+ * Stores are parsed once and shared: every storage_open() of the same
+ * store returns a reference to the same key file.  storage_sync() only
+ * marks a store dirty.  Dirty stores are written out together once the
+ * sync delay has passed since the first change, so a burst of setting
+ * changes costs one write per store, and a store whose contents did not
+ * change is not written at all.
+ */
+struct storage_entry {
+	char *path;
+	GKeyFile *keyfile;
+	unsigned int users;
+	gboolean dirty;
+	char *contents;			/* As last read or written */
+	unsigned long last_used;
+};
+
+static GHashTable *stores;
+static unsigned long stores_tick;
+static guint dirty_timeout;
+static unsigned int sync_delay = STORAGE_SYNC_DELAY;
+
 const char *ofono_config_dir(void)
 {
 	return CONFIGDIR;
@@ -171,61 +197,283 @@ error_create_dirs:
 	return r;
 }
 
-GKeyFile *storage_open(const char *imsi, const char *store)
+static char *store_path(const char *imsi, const char *store)
 {
-	GKeyFile *keyfile;
-	char *path;
+	if (imsi)
+		return g_strdup_printf(STORAGEDIR "/%s/%s", imsi, store);
 
-	if (store == NULL)
-		return NULL;
+	return g_strdup_printf(STORAGEDIR "/%s", store);
+}
 
-	if (imsi)
-		path = g_strdup_printf(STORAGEDIR "/%s/%s", imsi, store);
-	else
-		path = g_strdup_printf(STORAGEDIR "/%s", store);
+static void storage_entry_free(gpointer data)
+{
+	struct storage_entry *entry = data;
+
+	g_key_file_unref(entry->keyfile);
+	g_free(entry->contents);
+	g_free(entry->path);
+	g_free(entry);
+}
+
+static struct storage_entry *storage_entry_get(const char *imsi,
+						const char *store)
+{
+	struct storage_entry *entry;
+	char *path;
 
-	keyfile = g_key_file_new();
+	if (stores == NULL)
+		stores = g_hash_table_new_full(g_str_hash, g_str_equal,
+						NULL, storage_entry_free);
 
-	if (path) {
-		g_key_file_load_from_file(keyfile, path, 0, NULL);
+	path = store_path(imsi, store);
+
+	entry = g_hash_table_lookup(stores, path);
+	if (entry) {
 		g_free(path);
+		goto done;
 	}
 
-	return keyfile;
+	entry = g_new0(struct storage_entry, 1);
+	entry->path = path;
+	entry->keyfile = g_key_file_new();
+
+	if (g_file_get_contents(path, &entry->contents, NULL, NULL))
+		g_key_file_load_from_data(entry->keyfile, entry->contents, -1,
+						0, NULL);
+
+	g_hash_table_insert(stores, entry->path, entry);
+
+done:
+	entry->last_used = ++stores_tick;
+	return entry;
 }
 
-void storage_sync(const char *imsi, const char *store, GKeyFile *keyfile)
+/* Drop the least recently used stores nobody has open */
+static void storage_evict(void)
 {
-	char *path;
-	char *data;
-	gsize length = 0;
+	while (g_hash_table_size(stores) > STORAGE_CACHE_SIZE) {
+		struct storage_entry *victim = NULL;
+		GHashTableIter iter;
+		gpointer value;
 
-	if (imsi)
-		path = g_strdup_printf(STORAGEDIR "/%s/%s", imsi, store);
-	else
-		path = g_strdup_printf(STORAGEDIR "/%s", store);
+		g_hash_table_iter_init(&iter, stores);
+
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			struct storage_entry *entry = value;
+
+			if (entry->users > 0 || entry->dirty)
+				continue;
 
-	if (path == NULL)
+			if (victim == NULL ||
+					entry->last_used < victim->last_used)
+				victim = entry;
+		}
+
+		if (victim == NULL)
+			return;
+
+		g_hash_table_remove(stores, victim->path);
+	}
+}
+
+/*
+ * Write the store to a temporary file next to it, fsync and rename it
+ * in place, so a crash leaves either the old or the new contents.  The
+ * directory is synced by the caller once all stores have been renamed.
+ */
+static int store_write(struct storage_entry *entry, char *data, gsize length)
+{
+	char *tmp_path;
+	ssize_t r;
+	int fd;
+	int err = 0;
+
+	if (create_dirs(entry->path, S_IRUSR | S_IWUSR | S_IXUSR) != 0)
+		return -errno;
+
+	tmp_path = g_strdup_printf("%s.XXXXXX.tmp", entry->path);
+
+	fd = L_TFR(g_mkstemp_full(tmp_path, O_WRONLY | O_CREAT | O_TRUNC,
+					S_IRUSR | S_IWUSR));
+	if (fd == -1) {
+		err = -errno;
+		goto done;
+	}
+
+	r = L_TFR(write(fd, data, length));
+	if (r != (ssize_t) length)
+		err = r < 0 ? -errno : -EIO;
+	else if (fsync(fd) < 0)
+		err = -errno;
+
+	L_TFR(close(fd));
+
+	if (err == 0 && rename(tmp_path, entry->path) < 0)
+		err = -errno;
+
+	if (err < 0)
+		unlink(tmp_path);
+
+done:
+	g_free(tmp_path);
+
+	return err;
+}
+
+static void sync_dir(const char *dir)
+{
+	int fd;
+
+	fd = L_TFR(open(dir, O_RDONLY | O_DIRECTORY));
+	if (fd < 0)
 		return;
 
-	if (create_dirs(path, S_IRUSR | S_IWUSR | S_IXUSR) != 0) {
-		g_free(path);
+	fsync(fd);
+	L_TFR(close(fd));
+}
+
+static gboolean storage_flush_cb(gpointer user_data);
+
+void storage_flush(void)
+{
+	GHashTable *dirs;
+	GHashTableIter iter;
+	gpointer value;
+	gboolean failed = FALSE;
+
+	if (dirty_timeout > 0) {
+		g_source_remove(dirty_timeout);
+		dirty_timeout = 0;
+	}
+
+	if (stores == NULL)
 		return;
+
+	dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	g_hash_table_iter_init(&iter, stores);
+
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		struct storage_entry *entry = value;
+		gsize length = 0;
+		char *data;
+		int err;
+
+		if (!entry->dirty)
+			continue;
+
+		data = g_key_file_to_data(entry->keyfile, &length, NULL);
+
+		if (g_strcmp0(data, entry->contents) == 0) {
+			entry->dirty = FALSE;
+			g_free(data);
+			continue;
+		}
+
+		DBG("%s", entry->path);
+
+		err = store_write(entry, data, length);
+		if (err < 0) {
+			ofono_error("Unable to write %s: %s (%d)", entry->path,
+							strerror(-err), -err);
+			g_free(data);
+			failed = TRUE;
+			continue;
+		}
+
+		entry->dirty = FALSE;
+		g_free(entry->contents);
+		entry->contents = data;
+
+		g_hash_table_add(dirs, g_path_get_dirname(entry->path));
 	}
 
-	data = g_key_file_to_data(keyfile, &length, NULL);
+	/* Make the renames durable, once per directory */
+	g_hash_table_iter_init(&iter, dirs);
 
-	g_file_set_contents(path, data, length, NULL);
+	while (g_hash_table_iter_next(&iter, &value, NULL))
+		sync_dir(value);
 
-	g_free(data);
-	g_free(path);
+	g_hash_table_destroy(dirs);
+
+	/* Stores that failed stay dirty, try them again later */
+	if (failed)
+		dirty_timeout = g_timeout_add(sync_delay ? sync_delay :
+						STORAGE_SYNC_DELAY,
+						storage_flush_cb, NULL);
+
+	storage_evict();
+}
+
+static gboolean storage_flush_cb(gpointer user_data)
+{
+	dirty_timeout = 0;
+	storage_flush();
+
+	return FALSE;
+}
+
+void storage_set_sync_delay(unsigned int msecs)
+{
+	sync_delay = msecs;
+}
+
+GKeyFile *storage_open(const char *imsi, const char *store)
+{
+	struct storage_entry *entry;
+
+	if (store == NULL)
+		return NULL;
+
+	entry = storage_entry_get(imsi, store);
+	entry->users += 1;
+
+	return g_key_file_ref(entry->keyfile);
+}
+
+void storage_sync(const char *imsi, const char *store, GKeyFile *keyfile)
+{
+	struct storage_entry *entry;
+
+	entry = storage_entry_get(imsi, store);
+
+	/* Key files not obtained from storage_open() replace the cached one */
+	if (entry->keyfile != keyfile) {
+		g_key_file_unref(entry->keyfile);
+		entry->keyfile = g_key_file_ref(keyfile);
+	}
+
+	entry->dirty = TRUE;
+
+	if (sync_delay == 0) {
+		storage_flush();
+		return;
+	}
+
+	if (dirty_timeout == 0)
+		dirty_timeout = g_timeout_add(sync_delay, storage_flush_cb,
+						NULL);
 }
 
 void storage_close(const char *imsi, const char *store, GKeyFile *keyfile,
 			gboolean save)
 {
+	struct storage_entry *entry;
+	char *path;
+
 	if (save == TRUE)
 		storage_sync(imsi, store, keyfile);
 
-	g_key_file_free(keyfile);
+	path = store_path(imsi, store);
+	entry = stores ? g_hash_table_lookup(stores, path) : NULL;
+	g_free(path);
+
+	if (entry && entry->keyfile == keyfile && entry->users > 0)
+		entry->users -= 1;
+
+	/* The cache and any queued write keep their own reference */
+	g_key_file_unref(keyfile);
+
+	if (stores)
+		storage_evict();
 }
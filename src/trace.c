@@ -0,0 +1,551 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  Copyright (C) 2008-2011  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include <glib.h>
+
+#include <ofono/log.h>
+
+#include "trace.h"
+
+enum trace_arg {
+	TRACE_ARG_NONE,
+	TRACE_ARG_SKIP,
+	TRACE_ARG_INT,
+	TRACE_ARG_UINT,
+	TRACE_ARG_DOUBLE,
+	TRACE_ARG_POINTER,
+	TRACE_ARG_STRING,
+};
+
+enum trace_len {
+	TRACE_LEN_NONE,
+	TRACE_LEN_HH,
+	TRACE_LEN_H,
+	TRACE_LEN_L,
+	TRACE_LEN_LL,
+	TRACE_LEN_J,
+	TRACE_LEN_Z,
+	TRACE_LEN_T,
+	TRACE_LEN_LD,
+};
+
+struct trace_spec {
+	const char *start;
+	const char *end;
+	gboolean width_arg;
+	gboolean prec_arg;
+	int prec;
+	enum trace_len len;
+	enum trace_arg arg;
+	char conv;
+};
+
+static const char *trace_parse_spec(const char *p, struct trace_spec *spec)
+{
+	memset(spec, 0, sizeof(*spec));
+	spec->start = p++;
+	spec->prec = -1;
+
+	while (*p != '\0' && strchr("-+ #0'", *p) != NULL)
+		p++;
+
+	if (*p == '*') {
+		spec->width_arg = TRUE;
+		p++;
+	} else {
+		while (g_ascii_isdigit(*p))
+			p++;
+	}
+
+	if (*p == '.') {
+		p++;
+		spec->prec = 0;
+
+		if (*p == '*') {
+			spec->prec_arg = TRUE;
+			p++;
+		} else {
+			while (g_ascii_isdigit(*p))
+				spec->prec = spec->prec * 10 + *p++ - '0';
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		spec->len = TRACE_LEN_H;
+		if (*++p == 'h') {
+			spec->len = TRACE_LEN_HH;
+			p++;
+		}
+		break;
+	case 'l':
+		spec->len = TRACE_LEN_L;
+		if (*++p == 'l') {
+			spec->len = TRACE_LEN_LL;
+			p++;
+		}
+		break;
+	case 'q':
+		spec->len = TRACE_LEN_LL;
+		p++;
+		break;
+	case 'j':
+		spec->len = TRACE_LEN_J;
+		p++;
+		break;
+	case 'z':
+		spec->len = TRACE_LEN_Z;
+		p++;
+		break;
+	case 't':
+		spec->len = TRACE_LEN_T;
+		p++;
+		break;
+	case 'L':
+		spec->len = TRACE_LEN_LD;
+		p++;
+		break;
+	}
+
+	spec->conv = *p;
+	if (*p != '\0')
+		p++;
+
+	spec->end = p;
+
+	switch (spec->conv) {
+	case 'd':
+	case 'i':
+	case 'c':
+		spec->arg = TRACE_ARG_INT;
+		break;
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		spec->arg = TRACE_ARG_UINT;
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		spec->arg = TRACE_ARG_DOUBLE;
+		break;
+	case 'p':
+		spec->arg = TRACE_ARG_POINTER;
+		break;
+	case 's':
+		/* Wide strings are recorded by address only */
+		if (spec->len == TRACE_LEN_L)
+			spec->arg = TRACE_ARG_POINTER;
+		else
+			spec->arg = TRACE_ARG_STRING;
+		break;
+	case 'n':
+		spec->arg = TRACE_ARG_SKIP;
+		break;
+	default:
+		spec->arg = TRACE_ARG_NONE;
+		break;
+	}
+
+	return p;
+}
+
+static int64_t trace_get_int(const struct trace_spec *spec, va_list *ap)
+{
+	switch (spec->len) {
+	case TRACE_LEN_HH:
+		return (signed char) va_arg(*ap, int);
+	case TRACE_LEN_H:
+		return (short) va_arg(*ap, int);
+	case TRACE_LEN_L:
+		return va_arg(*ap, long);
+	case TRACE_LEN_LL:
+		return va_arg(*ap, long long);
+	case TRACE_LEN_J:
+		return va_arg(*ap, intmax_t);
+	case TRACE_LEN_Z:
+		return va_arg(*ap, ssize_t);
+	case TRACE_LEN_T:
+		return va_arg(*ap, ptrdiff_t);
+	default:
+		return va_arg(*ap, int);
+	}
+}
+
+static uint64_t trace_get_uint(const struct trace_spec *spec, va_list *ap)
+{
+	switch (spec->len) {
+	case TRACE_LEN_HH:
+		return (unsigned char) va_arg(*ap, unsigned int);
+	case TRACE_LEN_H:
+		return (unsigned short) va_arg(*ap, unsigned int);
+	case TRACE_LEN_L:
+		return va_arg(*ap, unsigned long);
+	case TRACE_LEN_LL:
+		return va_arg(*ap, unsigned long long);
+	case TRACE_LEN_J:
+		return va_arg(*ap, uintmax_t);
+	case TRACE_LEN_Z:
+		return va_arg(*ap, size_t);
+	case TRACE_LEN_T:
+		return va_arg(*ap, ptrdiff_t);
+	default:
+		return va_arg(*ap, unsigned int);
+	}
+}
+
+static gboolean trace_put(struct trace_record *rec, const void *val,
+								size_t len)
+{
+	if (rec->len + len > sizeof(rec->data)) {
+		rec->truncated = TRUE;
+		return FALSE;
+	}
+
+	memcpy(rec->data + rec->len, val, len);
+	rec->len += len;
+
+	return TRUE;
+}
+
+/* Shorten len so a cut string does not end in a partial UTF-8 character */
+static size_t utf8_cut(const char *str, size_t len)
+{
+	while (len > 0 && (str[len] & 0xc0) == 0x80)
+		len--;
+
+	return len;
+}
+
+static gboolean trace_put_string(struct trace_record *rec, const char *str,
+								int prec)
+{
+	size_t avail = sizeof(rec->data) - rec->len;
+	size_t len;
+
+	if (str == NULL)
+		str = "(null)";
+
+	len = prec < 0 ? strlen(str) : strnlen(str, prec);
+
+	if (len > TRACE_STRING_MAX)
+		len = utf8_cut(str, TRACE_STRING_MAX);
+
+	if (avail < 1 + len) {
+		if (avail > 1)
+			trace_put_string(rec, str, utf8_cut(str, avail - 1));
+
+		rec->truncated = TRUE;
+		return FALSE;
+	}
+
+	rec->data[rec->len++] = len;
+	memcpy(rec->data + rec->len, str, len);
+	rec->len += len;
+
+	return TRUE;
+}
+
+void trace_encode(struct trace_record *rec, const char *format, va_list *ap)
+{
+	const char *p = format;
+	struct trace_spec spec;
+
+	while ((p = strchr(p, '%')) != NULL) {
+		int32_t star;
+		int64_t i;
+		uint64_t u;
+		double d;
+
+		p = trace_parse_spec(p, &spec);
+
+		if (spec.width_arg) {
+			star = va_arg(*ap, int);
+			if (trace_put(rec, &star, sizeof(star)) == FALSE)
+				return;
+		}
+
+		if (spec.prec_arg) {
+			star = va_arg(*ap, int);
+			spec.prec = star;
+			if (trace_put(rec, &star, sizeof(star)) == FALSE)
+				return;
+		}
+
+		switch (spec.arg) {
+		case TRACE_ARG_NONE:
+			continue;
+		case TRACE_ARG_SKIP:
+			va_arg(*ap, void *);
+			continue;
+		case TRACE_ARG_INT:
+			i = trace_get_int(&spec, ap);
+			if (trace_put(rec, &i, sizeof(i)) == FALSE)
+				return;
+			break;
+		case TRACE_ARG_UINT:
+			u = trace_get_uint(&spec, ap);
+			if (trace_put(rec, &u, sizeof(u)) == FALSE)
+				return;
+			break;
+		case TRACE_ARG_DOUBLE:
+			if (spec.len == TRACE_LEN_LD)
+				d = va_arg(*ap, long double);
+			else
+				d = va_arg(*ap, double);
+
+			if (trace_put(rec, &d, sizeof(d)) == FALSE)
+				return;
+			break;
+		case TRACE_ARG_POINTER:
+			u = (uintptr_t) va_arg(*ap, void *);
+			if (trace_put(rec, &u, sizeof(u)) == FALSE)
+				return;
+			break;
+		case TRACE_ARG_STRING:
+			if (trace_put_string(rec, va_arg(*ap, const char *),
+							spec.prec) == FALSE)
+				return;
+			break;
+		}
+	}
+}
+
+static void trace_append(char *buf, size_t size, size_t *pos,
+						const char *format, ...)
+{
+	va_list ap;
+	int len;
+
+	if (*pos >= size - 1)
+		return;
+
+	va_start(ap, format);
+	len = vsnprintf(buf + *pos, size - *pos, format, ap);
+	va_end(ap);
+
+	if (len < 0)
+		return;
+
+	*pos += len;
+	if (*pos > size - 1)
+		*pos = size - 1;
+}
+
+static gboolean trace_get(const struct trace_record *rec, size_t *off,
+						void *val, size_t len)
+{
+	if (*off + len > rec->len)
+		return FALSE;
+
+	memcpy(val, rec->data + *off, len);
+	*off += len;
+
+	return TRUE;
+}
+
+/*
+ * Rebuild a single conversion with the recorded width and precision
+ * in place of '*' and the length modifier matching the recorded type.
+ */
+static void trace_build_spec(const struct trace_spec *spec, int32_t width,
+					int32_t prec, char *buf, size_t size)
+{
+	const char *p;
+	size_t pos = 0;
+
+	for (p = spec->start; p < spec->end - 1; p++) {
+		if (*p == '*') {
+			trace_append(buf, size, &pos, "%d",
+					p[-1] == '.' ? prec : width);
+			continue;
+		}
+
+		if (strchr("hlqjztL", *p) != NULL)
+			continue;
+
+		trace_append(buf, size, &pos, "%c", *p);
+	}
+
+	if ((spec->arg == TRACE_ARG_INT || spec->arg == TRACE_ARG_UINT) &&
+							spec->conv != 'c')
+		trace_append(buf, size, &pos, "ll");
+
+	if (spec->arg == TRACE_ARG_POINTER)
+		trace_append(buf, size, &pos, "p");
+	else
+		trace_append(buf, size, &pos, "%c", spec->conv);
+}
+
+static void trace_format_record(const struct trace_record *rec,
+					bool raw_time, char *buf, size_t size)
+{
+	const char *p = rec->format;
+	size_t pos = 0;
+	size_t off = 0;
+	struct trace_spec spec;
+	struct tm tm;
+	time_t sec;
+	char date[32];
+
+	sec = rec->timestamp / 1000000;
+
+	if (raw_time) {
+		snprintf(date, sizeof(date), "%llu", (unsigned long long) sec);
+	} else {
+		localtime_r(&sec, &tm);
+		strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+	}
+
+	trace_append(buf, size, &pos, "%s.%06u %s:%s() ", date,
+				(unsigned int) (rec->timestamp % 1000000),
+				rec->desc->file, rec->func);
+
+	while (*p != '\0') {
+		const char *pct = strchr(p, '%');
+		int32_t width = 0, prec = -1;
+		char fmt[32], str[TRACE_STRING_MAX + 1];
+		uint8_t len;
+		int64_t i;
+		uint64_t u;
+		double d;
+
+		if (pct == NULL) {
+			trace_append(buf, size, &pos, "%s", p);
+			return;
+		}
+
+		trace_append(buf, size, &pos, "%.*s", (int) (pct - p), p);
+		p = trace_parse_spec(pct, &spec);
+
+		if (spec.conv == '%') {
+			trace_append(buf, size, &pos, "%%");
+			continue;
+		}
+
+		if (spec.arg == TRACE_ARG_NONE || spec.arg == TRACE_ARG_SKIP)
+			continue;
+
+		if (spec.width_arg && !trace_get(rec, &off,
+						&width, sizeof(width)))
+			goto truncated;
+
+		if (spec.prec_arg && !trace_get(rec, &off,
+						&prec, sizeof(prec)))
+			goto truncated;
+
+		trace_build_spec(&spec, width, prec, fmt, sizeof(fmt));
+
+		switch (spec.arg) {
+		case TRACE_ARG_INT:
+			if (!trace_get(rec, &off, &i, sizeof(i)))
+				goto truncated;
+
+			if (spec.conv == 'c')
+				trace_append(buf, size, &pos, fmt, (int) i);
+			else
+				trace_append(buf, size, &pos, fmt,
+							(long long) i);
+			break;
+		case TRACE_ARG_UINT:
+			if (!trace_get(rec, &off, &u, sizeof(u)))
+				goto truncated;
+
+			trace_append(buf, size, &pos, fmt,
+						(unsigned long long) u);
+			break;
+		case TRACE_ARG_DOUBLE:
+			if (!trace_get(rec, &off, &d, sizeof(d)))
+				goto truncated;
+
+			trace_append(buf, size, &pos, fmt, d);
+			break;
+		case TRACE_ARG_POINTER:
+			if (!trace_get(rec, &off, &u, sizeof(u)))
+				goto truncated;
+
+			trace_append(buf, size, &pos, fmt,
+						(void *) (uintptr_t) u);
+			break;
+		case TRACE_ARG_STRING:
+			if (!trace_get(rec, &off, &len, sizeof(len)) ||
+					!trace_get(rec, &off, str, len))
+				goto truncated;
+
+			str[len] = '\0';
+			trace_append(buf, size, &pos, fmt, str);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (!rec->truncated)
+		return;
+
+truncated:
+	trace_append(buf, size, &pos, "...");
+}
+
+/*
+ * Replace whatever is not valid UTF-8 with '?', in place.  That covers
+ * raw bytes in string arguments and characters cut by a full line.
+ */
+static void trace_make_valid(char *buf)
+{
+	const gchar *end;
+
+	while (!g_utf8_validate(buf, -1, &end)) {
+		buf = (char *) end;
+		*buf++ = '?';
+	}
+}
+
+/*
+ * Format a record into buf as a single line.  The result is valid UTF-8,
+ * so it can be passed on as a D-Bus string, and no memory is allocated.
+ * With raw_time the timestamp is printed as seconds since the epoch,
+ * which avoids localtime_r() and strftime() when dumping after a crash.
+ */
+void trace_format(const struct trace_record *rec, bool raw_time,
+						char *buf, size_t size)
+{
+	trace_format_record(rec, raw_time, buf, size);
+	trace_make_valid(buf);
+}
@@ -0,0 +1,43 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  Copyright (C) 2008-2011  Intel Corporation. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_DATA_SIZE		84
+#define TRACE_STRING_MAX	255
+
+struct trace_record {
+	unsigned long seq;		/* Slot index + 1 once complete */
+	uint64_t timestamp;		/* Microseconds since the epoch */
+	const struct ofono_debug_desc *desc;
+	const char *func;
+	const char *format;
+	uint16_t len;
+	uint8_t truncated;
+	uint8_t data[TRACE_DATA_SIZE];
+};
+
+void trace_encode(struct trace_record *rec, const char *format, va_list *ap);
+void trace_format(const struct trace_record *rec, bool raw_time,
+						char *buf, size_t size);
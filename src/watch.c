@@ -31,6 +31,7 @@ struct ofono_watchlist *__ofono_watchlist_new(ofono_destroy_func destroy)
 	struct ofono_watchlist *watchlist;
 
 	watchlist = g_new0(struct ofono_watchlist, 1);
+	watchlist->index = g_hash_table_new(g_direct_hash, g_direct_equal);
 	watchlist->destroy = destroy;
 
 	return watchlist;
@@ -41,52 +42,54 @@ unsigned int __ofono_watchlist_add_item(struct ofono_watchlist *watchlist,
 {
 	item->id = ++watchlist->next_id;
 
-	watchlist->items = g_slist_prepend(watchlist->items, item);
+	watchlist->items = g_list_prepend(watchlist->items, item);
+	g_hash_table_insert(watchlist->index, GUINT_TO_POINTER(item->id),
+				watchlist->items);
 
 	return item->id;
 }
 
-gboolean __ofono_watchlist_remove_item(struct ofono_watchlist *watchlist,
+struct ofono_watchlist_item *__ofono_watchlist_find_item(
+					struct ofono_watchlist *watchlist,
 					unsigned int id)
 {
-	struct ofono_watchlist_item *item;
-	GSList *p;
-	GSList *c;
+	GList *link;
 
-	p = NULL;
-	c = watchlist->items;
+	link = g_hash_table_lookup(watchlist->index, GUINT_TO_POINTER(id));
+	if (link == NULL)
+		return NULL;
 
-	while (c) {
-		item = c->data;
+	return link->data;
+}
 
-		if (item->id != id) {
-			p = c;
-			c = c->next;
-			continue;
-		}
+gboolean __ofono_watchlist_remove_item(struct ofono_watchlist *watchlist,
+					unsigned int id)
+{
+	struct ofono_watchlist_item *item;
+	GList *link;
 
-		if (p)
-			p->next = c->next;
-		else
-			watchlist->items = c->next;
+	link = g_hash_table_lookup(watchlist->index, GUINT_TO_POINTER(id));
+	if (link == NULL)
+		return FALSE;
 
-		if (item->destroy)
-			item->destroy(item->notify_data);
+	item = link->data;
 
-		if (watchlist->destroy)
-			watchlist->destroy(item);
-		g_slist_free_1(c);
+	g_hash_table_remove(watchlist->index, GUINT_TO_POINTER(id));
+	watchlist->items = g_list_delete_link(watchlist->items, link);
 
-		return TRUE;
-	}
+	if (item->destroy)
+		item->destroy(item->notify_data);
+
+	if (watchlist->destroy)
+		watchlist->destroy(item);
 
-	return FALSE;
+	return TRUE;
 }
 
 void __ofono_watchlist_free(struct ofono_watchlist *watchlist)
 {
 	struct ofono_watchlist_item *item;
-	GSList *l;
+	GList *l;
 
 	for (l = watchlist->items; l; l = l->next) {
 		item = l->data;
@@ -98,7 +101,8 @@ void __ofono_watchlist_free(struct ofono_watchlist *watchlist)
 			watchlist->destroy(item);
 	}
 
-	g_slist_free(watchlist->items);
+	g_list_free(watchlist->items);
 	watchlist->items = NULL;
+	g_hash_table_destroy(watchlist->index);
 	g_free(watchlist);
 }
@@ -0,0 +1,205 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "gril/grilutil.h"
+#include "gril/griltrace.h"
+
+static gboolean option_version = FALSE;
+static gboolean option_hexdump = FALSE;
+
+static GOptionEntry options[] = {
+	{ "version", 'v', 0, G_OPTION_ARG_NONE, &option_version,
+				"Show version information and exit" },
+	{ "hexdump", 'x', 0, G_OPTION_ARG_NONE, &option_hexdump,
+				"Dump the parcel of every message" },
+	{ NULL },
+};
+
+static void print_line(const char *str, gpointer user_data)
+{
+	g_print("\t%s\n", str);
+}
+
+static int32_t get_int32(const guint8 *buf, gsize len, gsize offset)
+{
+	int32_t val;
+
+	if (offset + sizeof(val) > len)
+		return -1;
+
+	memcpy(&val, buf + offset, sizeof(val));
+	return val;
+}
+
+static void print_timestamp(uint64_t timestamp)
+{
+	time_t sec = timestamp / 1000000;
+	struct tm tm;
+	char buf[32];
+
+	localtime_r(&sec, &tm);
+	strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+
+	g_print("%s.%06u ", buf, (unsigned int) (timestamp % 1000000));
+}
+
+static void decode_record(GHashTable *requests, uint16_t slot,
+				const struct ril_trace_rec_hdr *hdr,
+				const guint8 *buf)
+{
+	gsize parcel_offset;
+	int32_t serial;
+	int32_t req;
+
+	print_timestamp(hdr->timestamp);
+
+	if (hdr->dir == RIL_TRACE_DIR_OUT) {
+		req = get_int32(buf, hdr->caplen, 0);
+		serial = get_int32(buf, hdr->caplen, 4);
+
+		g_hash_table_replace(requests, GINT_TO_POINTER(serial),
+						GINT_TO_POINTER(req));
+
+		g_print("[%u,%04d]> %s", slot, serial,
+					ril_request_id_to_string(req));
+		parcel_offset = 8;
+	} else if (get_int32(buf, hdr->caplen, 0) != 0) {
+		req = get_int32(buf, hdr->caplen, 4);
+
+		g_print("[%u,UNSOL]< %s", slot,
+					ril_unsol_request_to_string(req));
+		parcel_offset = 8;
+	} else {
+		int32_t error;
+
+		serial = get_int32(buf, hdr->caplen, 4);
+		error = get_int32(buf, hdr->caplen, 8);
+		req = GPOINTER_TO_INT(g_hash_table_lookup(requests,
+						GINT_TO_POINTER(serial)));
+
+		g_print("[%u,%04d]< %s %s", slot, serial,
+				req ? ril_request_id_to_string(req) : "?",
+				ril_error_to_string(error));
+		parcel_offset = 12;
+	}
+
+	if (hdr->caplen < hdr->len)
+		g_print(" (%u of %u bytes)", hdr->caplen, hdr->len);
+
+	g_print("\n");
+
+	if (option_hexdump && hdr->caplen > parcel_offset)
+		g_ril_util_debug_hexdump(hdr->dir == RIL_TRACE_DIR_IN,
+					buf + parcel_offset,
+					hdr->caplen - parcel_offset,
+					print_line, NULL);
+}
+
+static int decode_file(const char *path)
+{
+	struct ril_trace_file_hdr file_hdr;
+	struct ril_trace_rec_hdr hdr;
+	guint8 buf[RIL_TRACE_MAX_CAPLEN];
+	GHashTable *requests;
+	FILE *fp;
+	int err = 0;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		g_printerr("Can't open %s\n", path);
+		return -1;
+	}
+
+	if (fread(&file_hdr, sizeof(file_hdr), 1, fp) != 1 ||
+			file_hdr.magic != RIL_TRACE_MAGIC ||
+			file_hdr.version != RIL_TRACE_VERSION) {
+		g_printerr("%s is not a RIL trace\n", path);
+		fclose(fp);
+		return -1;
+	}
+
+	requests = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	while (fread(&hdr, sizeof(hdr), 1, fp) == 1) {
+		/* Empty records carry no data, fread() would report 0 */
+		if (hdr.caplen > sizeof(buf) || (hdr.caplen > 0 &&
+				fread(buf, hdr.caplen, 1, fp) != 1)) {
+			g_printerr("%s: truncated record\n", path);
+			err = -1;
+			break;
+		}
+
+		decode_record(requests, file_hdr.slot, &hdr, buf);
+	}
+
+	g_hash_table_destroy(requests);
+	fclose(fp);
+
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	int i;
+	int ret = 0;
+
+	context = g_option_context_new("FILE...");
+	g_option_context_add_main_entries(context, options, NULL);
+
+	if (g_option_context_parse(context, &argc, &argv, &error) == FALSE) {
+		if (error != NULL) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+		} else
+			g_printerr("An unknown error occurred\n");
+		exit(1);
+	}
+
+	g_option_context_free(context);
+
+	if (option_version == TRUE) {
+		g_print("%s\n", VERSION);
+		exit(0);
+	}
+
+	if (argc < 2) {
+		g_printerr("Missing parameters\n");
+		exit(1);
+	}
+
+	for (i = 1; i < argc; i++) {
+		if (decode_file(argv[i]) < 0)
+			ret = 1;
+	}
+
+	return ret;
+}
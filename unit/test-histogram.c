@@ -0,0 +1,122 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "histogram.h"
+
+static void test_bucket_edges(void)
+{
+	unsigned int i;
+
+	/* Small values get a bucket each */
+	for (i = 0; i < HISTOGRAM_SUB_COUNT; i++) {
+		g_assert(histogram_bucket_index(i) == i);
+		g_assert(histogram_bucket_lower(i) == i);
+		g_assert(histogram_bucket_upper(i) == i);
+	}
+
+	g_assert(histogram_bucket_index(4) == 4);
+	g_assert(histogram_bucket_index(7) == 7);
+	g_assert(histogram_bucket_index(8) == 8);
+	g_assert(histogram_bucket_index(9) == 8);
+	g_assert(histogram_bucket_index(10) == 9);
+	g_assert(histogram_bucket_lower(9) == 10);
+	g_assert(histogram_bucket_upper(8) == 9);
+
+	/* Buckets are contiguous and each one maps back to itself */
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		unsigned int lower = histogram_bucket_lower(i);
+		unsigned int upper = histogram_bucket_upper(i);
+
+		g_assert(lower <= upper);
+		g_assert(histogram_bucket_index(lower) == i);
+		g_assert(histogram_bucket_index(upper) == i);
+
+		if (i + 1 < HISTOGRAM_BUCKETS)
+			g_assert(histogram_bucket_lower(i + 1) == upper + 1);
+
+		/* Relative error stays within 1 / HISTOGRAM_SUB_COUNT */
+		if (lower >= HISTOGRAM_SUB_COUNT)
+			g_assert((upper - lower) / (double) lower <=
+						1.0 / HISTOGRAM_SUB_COUNT);
+	}
+
+	g_assert(histogram_bucket_index(UINT32_MAX) == HISTOGRAM_BUCKETS - 1);
+	g_assert(histogram_bucket_upper(HISTOGRAM_BUCKETS - 1) == UINT32_MAX);
+	g_assert(histogram_bucket_lower(HISTOGRAM_BUCKETS - 1) == 0xe0000000);
+}
+
+static void test_percentiles(void)
+{
+	struct histogram h;
+	unsigned int i;
+
+	histogram_init(&h);
+	g_assert(h.count == 0);
+	g_assert(h.min == UINT32_MAX);
+
+	/* 1..100 microseconds, every tenth one failed */
+	for (i = 1; i <= 100; i++)
+		histogram_add(&h, i, i % 10 != 0);
+
+	g_assert(h.count == 100);
+	g_assert(h.errors == 10);
+	g_assert(h.min == 1);
+	g_assert(h.max == 100);
+	g_assert(h.sum == 5050);
+
+	/* Reported as the upper bound of the holding bucket */
+	g_assert(histogram_percentile(&h, 50) == 55);
+	g_assert(histogram_percentile(&h, 90) == 95);
+	g_assert(histogram_percentile(&h, 99) == 100);
+	g_assert(histogram_percentile(&h, 100) == 100);
+
+	/* Never below the true value, at most a quarter above */
+	for (i = 1; i <= 100; i++) {
+		unsigned int value = histogram_percentile(&h, i);
+
+		g_assert(value >= i);
+		g_assert(value <= i + i / HISTOGRAM_SUB_COUNT);
+	}
+
+	/* A single sample is reported exactly */
+	histogram_init(&h);
+	histogram_add(&h, 1000000, TRUE);
+	g_assert(histogram_percentile(&h, 50) == 1000000);
+	g_assert(histogram_percentile(&h, 99) == 1000000);
+
+	/* The top bucket is capped by the maximum */
+	histogram_add(&h, UINT32_MAX - 1, TRUE);
+	g_assert(histogram_percentile(&h, 99) == UINT32_MAX - 1);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/testhistogram/Bucket edges", test_bucket_edges);
+	g_test_add_func("/testhistogram/Percentiles", test_percentiles);
+
+	return g_test_run();
+}
@@ -23,6 +23,8 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
+#include <time.h>
 #include <sys/uio.h>
 #include <linux/types.h>
 #include <assert.h>
@@ -718,6 +720,209 @@ static void parse_ip_configuration_query(const void *data)
 	mbim_message_unref(msg);
 }
 
+static void parse_long_string(const void *data)
+{
+	static const char str[] = "This string is long enough that its "
+					"UTF-16 encoding spans several of the "
+					"64 byte fragments used by the tests";
+	struct mbim_message *msg;
+	struct message_data msg_data;
+	void *binary;
+	size_t len;
+	uint32_t u;
+	char *out;
+
+	msg = _mbim_message_new_command_done(mbim_uuid_basic_connect, 1, 0);
+	assert(msg);
+	assert(mbim_message_set_arguments(msg, "us", 7, str));
+
+	binary = _mbim_message_to_bytearray(msg, &len);
+	assert(binary);
+	mbim_message_unref(msg);
+
+	msg_data.tid = 0;
+	msg_data.binary = binary;
+	msg_data.binary_len = len;
+
+	msg = build_message(&msg_data);
+	assert(mbim_message_get_arguments(msg, "us", &u, &out));
+	assert(u == 7);
+	assert(!strcmp(out, str));
+
+	l_free(out);
+	l_free(binary);
+	mbim_message_unref(msg);
+}
+
+static void build_flat(const void *data)
+{
+	static const uint8_t bytes[4] = { 0xde, 0xad, 0xbe, 0xef };
+	struct mbim_message_builder *builder;
+	struct mbim_message *flat;
+	struct mbim_message *message;
+	uint64_t t = 0x0123456789abcdefULL;
+	uint32_t u = 7;
+	uint16_t q = 0x1234;
+	uint8_t y = 0x56;
+	uint8_t out_bytes[4];
+	struct message_data msg_data;
+	unsigned int i;
+	char *s1;
+	char *s2;
+	void *flat_binary;
+	void *binary;
+	size_t flat_len;
+	size_t len;
+
+	/* Built directly from the compiled signature */
+	flat = _mbim_message_new_command_done(mbim_uuid_basic_connect, 1, 0);
+	assert(mbim_message_set_arguments(flat, "yqs4yuts", y, q,
+					"a\xc3\xa4\xf0\x9f\x98\x80", bytes,
+					u, t, NULL));
+
+	/* And field by field by the message builder */
+	message = _mbim_message_new_command_done(mbim_uuid_basic_connect,
+									1, 0);
+	builder = mbim_message_builder_new(message);
+	assert(mbim_message_builder_append_basic(builder, 'y', &y));
+	assert(mbim_message_builder_append_basic(builder, 'q', &q));
+	assert(mbim_message_builder_append_basic(builder, 's',
+					"a\xc3\xa4\xf0\x9f\x98\x80"));
+	assert(mbim_message_builder_append_bytes(builder, 4, bytes));
+	assert(mbim_message_builder_append_basic(builder, 'u', &u));
+	assert(mbim_message_builder_append_basic(builder, 't', &t));
+	assert(mbim_message_builder_append_basic(builder, 's', NULL));
+	assert(mbim_message_builder_finalize(builder));
+	mbim_message_builder_free(builder);
+
+	flat_binary = _mbim_message_to_bytearray(flat, &flat_len);
+	binary = _mbim_message_to_bytearray(message, &len);
+	assert(flat_len == len);
+	assert(!memcmp(flat_binary, binary, len));
+
+	l_free(binary);
+	mbim_message_unref(message);
+
+	/* Parsed directly from a single fragment, then field by field */
+	for (i = 0; i < 2; i++) {
+		if (i == 0) {
+			message = mbim_message_ref(flat);
+		} else {
+			msg_data.tid = 0;
+			msg_data.binary = flat_binary;
+			msg_data.binary_len = flat_len;
+			message = build_message(&msg_data);
+		}
+
+		assert(mbim_message_get_arguments(message, "yqs4yuts",
+						&y, &q, &s1, out_bytes,
+						&u, &t, &s2));
+		assert(y == 0x56 && q == 0x1234 && u == 7);
+		assert(t == 0x0123456789abcdefULL);
+		assert(!strcmp(s1, "a\xc3\xa4\xf0\x9f\x98\x80"));
+		assert(!memcmp(out_bytes, bytes, 4));
+		assert(!s2);
+
+		l_free(s1);
+		mbim_message_unref(message);
+	}
+
+	l_free(flat_binary);
+	mbim_message_unref(flat);
+
+	/* Invalid UTF-8 leaves the message unsealed */
+	message = _mbim_message_new_command_done(mbim_uuid_basic_connect,
+									1, 0);
+	assert(!mbim_message_set_arguments(message, "s", "\xff"));
+	assert(mbim_message_set_arguments(message, "s", "ok"));
+	mbim_message_unref(message);
+}
+
+#define BENCHMARK_ROUNDS 100000
+
+static uint64_t time_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void benchmark_packet_statistics(const void *data)
+{
+	struct mbim_message *msg;
+	struct iovec *iov;
+	void *binary;
+	size_t len;
+	uint32_t in_discards;
+	uint32_t in_errors;
+	uint64_t in_octets;
+	uint64_t in_packets;
+	uint64_t out_octets;
+	uint64_t out_packets;
+	uint32_t out_errors;
+	uint32_t out_discards;
+	uint64_t build_time;
+	uint64_t parse_time;
+	uint64_t start;
+	unsigned int i;
+
+	/* As held by an open device */
+	_mbim_message_sig_cache_ref();
+
+	start = time_now_us();
+
+	for (i = 0; i < BENCHMARK_ROUNDS; i++) {
+		msg = _mbim_message_new_command_done(mbim_uuid_basic_connect,
+						MBIM_CID_PACKET_STATISTICS, 0);
+		assert(mbim_message_set_arguments(msg, "uuttttuu", 1, 2,
+						(uint64_t) i, (uint64_t) 4,
+						(uint64_t) 5, (uint64_t) 6,
+						7, 8));
+		mbim_message_unref(msg);
+	}
+
+	build_time = time_now_us() - start;
+
+	msg = _mbim_message_new_command_done(mbim_uuid_basic_connect,
+						MBIM_CID_PACKET_STATISTICS, 0);
+	assert(mbim_message_set_arguments(msg, "uuttttuu", 1, 2,
+						(uint64_t) 3, (uint64_t) 4,
+						(uint64_t) 5, (uint64_t) 6,
+						7, 8));
+	binary = _mbim_message_to_bytearray(msg, &len);
+	mbim_message_unref(msg);
+
+	start = time_now_us();
+
+	/* Notifications are reassembled into a single fragment */
+	for (i = 0; i < BENCHMARK_ROUNDS; i++) {
+		iov = l_new(struct iovec, 1);
+		iov->iov_len = len - 20;
+		iov->iov_base = l_memdup(binary + 20, iov->iov_len);
+
+		msg = _mbim_message_build(binary, iov, 1);
+		assert(msg);
+		assert(mbim_message_get_arguments(msg, "uuttttuu",
+						&in_discards, &in_errors,
+						&in_octets, &in_packets,
+						&out_octets, &out_packets,
+						&out_errors, &out_discards));
+		assert(in_octets == 3 && out_discards == 8);
+		mbim_message_unref(msg);
+	}
+
+	parse_time = time_now_us() - start;
+
+	printf("%u rounds: build %llu us, parse %llu us\n", BENCHMARK_ROUNDS,
+				(unsigned long long) build_time,
+				(unsigned long long) parse_time);
+
+	l_free(binary);
+	_mbim_message_sig_cache_unref();
+}
+
 int main(int argc, char *argv[])
 {
 	l_test_init(&argc, &argv);
@@ -762,5 +967,12 @@ int main(int argc, char *argv[])
 				parse_ip_configuration_query,
 				&message_data_ip_configuration_query);
 
+	l_test_add("Long String (parse)", parse_long_string, NULL);
+
+	l_test_add("Flat Signature (build)", build_flat, NULL);
+
+	l_test_add("Packet Statistics (benchmark)",
+				benchmark_packet_statistics, NULL);
+
 	return l_test_run();
 }
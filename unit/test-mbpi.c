@@ -0,0 +1,319 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define MBPI_DATABASE	"unit/test-mbpi.xml"
+#define MBPI_INDEX	"unit/test-mbpi.idx"
+
+/* Built in, so both the index and the XML lookups can be compared */
+#include "plugins/mbpi.c"
+
+static const char test_db[] =
+	"<?xml version=\"1.0\"?>\n"
+	"<serviceproviders format=\"2.0\">\n"
+	"<country code=\"xx\">\n"
+	"  <provider>\n"
+	"    <name>Alpha</name>\n"
+	"    <gsm>\n"
+	"      <network-id mcc=\"001\" mnc=\"01\"/>\n"
+	"      <network-id mcc=\"001\" mnc=\"02\"/>\n"
+	"      <network-id mcc=\"001\" mnc=\"01\"/>\n"
+	"      <apn value=\"internet.alpha\">\n"
+	"        <usage type=\"internet\"/>\n"
+	"        <name>Alpha Internet</name>\n"
+	"        <username>user</username>\n"
+	"        <password>pass</password>\n"
+	"        <authentication method=\"pap\"/>\n"
+	"      </apn>\n"
+	"      <apn value=\"mms.alpha\">\n"
+	"        <usage type=\"mms\"/>\n"
+	"        <mmsc>http://mms.alpha</mmsc>\n"
+	"        <mmsproxy>10.0.0.1:8080</mmsproxy>\n"
+	"      </apn>\n"
+	"    </gsm>\n"
+	"  </provider>\n"
+	"  <provider>\n"
+	"    <name>Beta</name>\n"
+	"    <gsm>\n"
+	"      <network-id mcc=\"001\" mnc=\"02\"/>\n"
+	"      <apn value=\"internet.beta\">\n"
+	"        <usage type=\"internet\"/>\n"
+	"        <username>beta</username>\n"
+	"        <password>beta</password>\n"
+	"      </apn>\n"
+	"    </gsm>\n"
+	"  </provider>\n"
+	"  <provider>\n"
+	"    <name>Gamma</name>\n"
+	"    <gsm>\n"
+	"      <network-id mcc=\"001\" mnc=\"1\"/>\n"
+	"      <network-id mcc=\"01\" mnc=\"001\"/>\n"
+	"      <network-id mcc=\"999\" mnc=\"999\"/>\n"
+	"      <apn value=\"gamma\"/>\n"
+	"    </gsm>\n"
+	"  </provider>\n"
+	"  <provider>\n"
+	"    <name>Delta</name>\n"
+	"    <cdma>\n"
+	"      <sid value=\"4100\"/>\n"
+	"      <sid value=\"4101\"/>\n"
+	"    </cdma>\n"
+	"  </provider>\n"
+	"  <provider>\n"
+	"    <name>Epsilon</name>\n"
+	"    <cdma>\n"
+	"      <sid value=\"4101\"/>\n"
+	"      <sid value=\"50\"/>\n"
+	"    </cdma>\n"
+	"  </provider>\n"
+	"</country>\n"
+	"</serviceproviders>\n";
+
+static const struct {
+	const char *mcc;
+	const char *mnc;
+	unsigned int n_apns;
+	gboolean duplicate;
+} gsm_tests[] = {
+	{ "001", "01", 2, FALSE },
+	{ "001", "02", 3, TRUE },
+	{ "001", "1", 1, FALSE },
+	{ "01", "001", 1, FALSE },
+	{ "999", "999", 1, FALSE },
+	{ "001", "03", 0, FALSE },
+	{ "002", "01", 0, FALSE },
+};
+
+static const struct {
+	const char *sid;
+	const char *name;
+} cdma_tests[] = {
+	{ "4100", "Delta" },
+	{ "4101", "Delta" },
+	{ "50", "Epsilon" },
+};
+
+static void setup_db(void)
+{
+	g_assert(g_file_set_contents(MBPI_DATABASE, test_db, -1, NULL));
+	unlink(MBPI_INDEX);
+
+	if (index_cache) {
+		mbpi_index_free(index_cache);
+		index_cache = NULL;
+	}
+}
+
+static void teardown_db(void)
+{
+	if (index_cache) {
+		mbpi_index_free(index_cache);
+		index_cache = NULL;
+	}
+
+	unlink(MBPI_INDEX);
+	unlink(MBPI_DATABASE);
+}
+
+static void compare_apns(GSList *a, GSList *b)
+{
+	for (; a && b; a = a->next, b = b->next) {
+		struct ofono_gprs_provision_data *x = a->data;
+		struct ofono_gprs_provision_data *y = b->data;
+
+		g_assert_cmpstr(x->name, ==, y->name);
+		g_assert_cmpstr(x->apn, ==, y->apn);
+		g_assert_cmpstr(x->username, ==, y->username);
+		g_assert_cmpstr(x->password, ==, y->password);
+		g_assert_cmpstr(x->message_center, ==, y->message_center);
+		g_assert_cmpstr(x->message_proxy, ==, y->message_proxy);
+		g_assert(x->type == y->type);
+		g_assert(x->proto == y->proto);
+		g_assert(x->auth_method == y->auth_method);
+	}
+
+	g_assert(a == NULL && b == NULL);
+}
+
+static void compare_lookups(const struct mbpi_index *index)
+{
+	unsigned int i;
+	int dup;
+
+	for (i = 0; i < G_N_ELEMENTS(gsm_tests); i++) {
+		for (dup = 0; dup < 2; dup++) {
+			GError *index_error = NULL;
+			GError *parse_error = NULL;
+			GSList *from_index;
+			GSList *from_parse;
+			gboolean fails = !dup && gsm_tests[i].duplicate;
+
+			from_index = index_lookup_apn(index, gsm_tests[i].mcc,
+							gsm_tests[i].mnc, dup,
+							&index_error);
+			from_parse = parse_lookup_apn(gsm_tests[i].mcc,
+							gsm_tests[i].mnc, dup,
+							&parse_error);
+
+			g_assert(g_slist_length(from_index) ==
+					(fails ? 0 : gsm_tests[i].n_apns));
+			compare_apns(from_index, from_parse);
+
+			g_assert((index_error != NULL) == fails);
+			g_assert((parse_error != NULL) == fails);
+
+			if (fails) {
+				g_assert(index_error->code ==
+						MBPI_ERROR_DUPLICATE);
+				g_assert(parse_error->code ==
+						MBPI_ERROR_DUPLICATE);
+				g_error_free(index_error);
+				g_error_free(parse_error);
+			}
+
+			g_slist_free_full(from_index, free_ap);
+			g_slist_free_full(from_parse, free_ap);
+		}
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(cdma_tests); i++) {
+		char *from_index;
+		char *from_parse;
+
+		from_index = index_lookup_cdma_provider_name(index,
+							cdma_tests[i].sid);
+		from_parse = parse_lookup_cdma_provider_name(cdma_tests[i].sid,
+								NULL);
+
+		g_assert_cmpstr(from_index, ==, cdma_tests[i].name);
+		g_assert_cmpstr(from_parse, ==, cdma_tests[i].name);
+
+		g_free(from_index);
+		g_free(from_parse);
+	}
+
+	g_assert(index_lookup_cdma_provider_name(index, "4102") == NULL);
+}
+
+static void test_index_lookup(void)
+{
+	struct mbpi_index *index;
+
+	setup_db();
+
+	/* Built from the XML and written out */
+	index = mbpi_index_get();
+	g_assert(index);
+	g_assert(!index->mapped);
+	g_assert(g_file_test(MBPI_INDEX, G_FILE_TEST_EXISTS));
+
+	compare_lookups(index);
+
+	/* And mapped from the file by the next user */
+	mbpi_index_free(index_cache);
+	index_cache = NULL;
+
+	index = mbpi_index_get();
+	g_assert(index);
+	g_assert(index->mapped);
+
+	compare_lookups(index);
+
+	teardown_db();
+}
+
+static void test_index_public(void)
+{
+	GSList *apns;
+	char *name;
+
+	setup_db();
+
+	apns = mbpi_lookup_apn("001", "01", FALSE, NULL);
+	g_assert(g_slist_length(apns) == 2);
+	g_slist_free_full(apns, free_ap);
+
+	name = mbpi_lookup_cdma_provider_name("50", NULL);
+	g_assert_cmpstr(name, ==, "Epsilon");
+	g_free(name);
+
+	g_assert(index_cache);
+
+	teardown_db();
+}
+
+static void test_index_corrupt(void)
+{
+	struct mbpi_index_hdr hdr;
+	struct mbpi_index *index;
+	struct stat st;
+	size_t size = sizeof(hdr) + 64;
+	uint8_t *data;
+
+	memset(&st, 0, sizeof(st));
+	st.st_mtime = 1234;
+	st.st_size = 5678;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = MBPI_INDEX_MAGIC;
+	hdr.version = MBPI_INDEX_VERSION;
+	hdr.db_mtime = st.st_mtime;
+	hdr.db_size = st.st_size;
+	hdr.strings_len = 64;
+
+	/* A consistent, empty index is accepted */
+	data = g_malloc0(size);
+	memcpy(data, &hdr, sizeof(hdr));
+	index = mbpi_index_new(data, size, FALSE, &st);
+	g_assert(index);
+	mbpi_index_free(index);
+
+	/* Counts whose sizes would wrap around are rejected */
+	hdr.n_gsm = 0x80000000;
+	hdr.n_refs = 0x80000000;
+	hdr.n_apns = 0xffffffff;
+	hdr.n_cdma = 0xffffffff;
+
+	data = g_malloc0(size);
+	memcpy(data, &hdr, sizeof(hdr));
+	g_assert(mbpi_index_new(data, size, FALSE, &st) == NULL);
+
+	/* So are strings not ending within the index */
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = MBPI_INDEX_MAGIC;
+	hdr.version = MBPI_INDEX_VERSION;
+	hdr.db_mtime = st.st_mtime;
+	hdr.db_size = st.st_size;
+	hdr.strings_len = 64;
+
+	data = g_malloc0(size);
+	memcpy(data, &hdr, sizeof(hdr));
+	data[size - 1] = 'x';
+	g_assert(mbpi_index_new(data, size, FALSE, &st) == NULL);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/testmbpi/Index lookup", test_index_lookup);
+	g_test_add_func("/testmbpi/Public lookup", test_index_public);
+	g_test_add_func("/testmbpi/Corrupt index", test_index_corrupt);
+
+	return g_test_run();
+}
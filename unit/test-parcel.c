@@ -0,0 +1,229 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+
+#include "gril/parcel.h"
+
+struct string_test {
+	const char *str;
+	const uint16_t *units;
+	int32_t len16;
+};
+
+static const uint16_t units_ascii[] = { 'h', 'e', 'l', 'l', 'o' };
+
+static const struct string_test test_ascii = {
+	.str = "hello",
+	.units = units_ascii,
+	.len16 = G_N_ELEMENTS(units_ascii),
+};
+
+/* U+00E4 and U+20AC, two and three bytes in UTF-8 */
+static const uint16_t units_bmp[] = { 0x00e4, 'x', 0x20ac };
+
+static const struct string_test test_bmp = {
+	.str = "\xc3\xa4x\xe2\x82\xac",
+	.units = units_bmp,
+	.len16 = G_N_ELEMENTS(units_bmp),
+};
+
+/* U+1F600, four bytes in UTF-8 and a surrogate pair in UTF-16 */
+static const uint16_t units_astral[] = { 'a', 0xd83d, 0xde00, 'b' };
+
+static const struct string_test test_astral = {
+	.str = "a\xf0\x9f\x98\x80" "b",
+	.units = units_astral,
+	.len16 = G_N_ELEMENTS(units_astral),
+};
+
+static void test_write_string(gconstpointer data)
+{
+	const struct string_test *test = data;
+	struct parcel p;
+	uint16_t units[16];
+	char buf[32];
+	char *str;
+
+	parcel_init(&p);
+
+	g_assert(parcel_w_string(&p, test->str) == 0);
+	g_assert(p.size == parcel_string_size(test->str));
+	g_assert(p.size % 4 == 0);
+
+	/* Length in code units, the units, then a terminating zero */
+	p.offset = 0;
+	g_assert(parcel_r_int32(&p) == test->len16);
+
+	memcpy(units, p.data + p.offset, (test->len16 + 1) * sizeof(uint16_t));
+	g_assert(!memcmp(units, test->units, test->len16 * sizeof(uint16_t)));
+	g_assert(units[test->len16] == 0);
+
+	p.offset = 0;
+	g_assert_cmpstr(parcel_r_string_buf(&p, buf, sizeof(buf)), ==,
+								test->str);
+	g_assert(p.offset == p.size);
+
+	p.offset = 0;
+	str = parcel_r_string(&p);
+	g_assert_cmpstr(str, ==, test->str);
+	g_free(str);
+
+	parcel_free(&p);
+}
+
+/* Writes the units as they would arrive from rild, without validation */
+static void write_units(struct parcel *p, const uint16_t *units, int len16)
+{
+	uint16_t padded[16] = { 0 };
+	int32_t val;
+	int i;
+
+	memcpy(padded, units, len16 * sizeof(uint16_t));
+
+	parcel_w_int32(p, len16);
+
+	for (i = 0; i < (len16 + 2) / 2; i++) {
+		memcpy(&val, padded + i * 2, sizeof(val));
+		parcel_w_int32(p, val);
+	}
+}
+
+static void test_bad_surrogates(void)
+{
+	static const uint16_t lone_high[] = { 'a', 0xd83d };
+	static const uint16_t lone_high_mid[] = { 0xd83d, 'a' };
+	static const uint16_t lone_low[] = { 0xde00, 'a' };
+	static const uint16_t reversed[] = { 0xde00, 0xd83d };
+	static const struct {
+		const uint16_t *units;
+		int len16;
+	} tests[] = {
+		{ lone_high, G_N_ELEMENTS(lone_high) },
+		{ lone_high_mid, G_N_ELEMENTS(lone_high_mid) },
+		{ lone_low, G_N_ELEMENTS(lone_low) },
+		{ reversed, G_N_ELEMENTS(reversed) },
+	};
+	struct parcel p;
+	char buf[32];
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(tests); i++) {
+		parcel_init(&p);
+		write_units(&p, tests[i].units, tests[i].len16);
+
+		p.offset = 0;
+		g_assert(!parcel_r_string_buf(&p, buf, sizeof(buf)));
+		g_assert(p.malformed);
+
+		parcel_free(&p);
+	}
+}
+
+static void test_invalid_utf8(void)
+{
+	struct parcel p;
+
+	parcel_init(&p);
+
+	/* Rejected strings are sent as null strings */
+	g_assert(parcel_w_string(&p, "a\xff") == -1);
+	g_assert(p.size == sizeof(int32_t));
+
+	p.offset = 0;
+	g_assert(parcel_r_int32(&p) == -1);
+
+	parcel_free(&p);
+}
+
+static void test_small_buffer(void)
+{
+	struct parcel p;
+	char buf[8];
+
+	parcel_init(&p);
+	parcel_w_string(&p, test_ascii.str);
+	parcel_w_string(&p, test_bmp.str);
+
+	/* "hello" and its terminator need six bytes */
+	p.offset = 0;
+	g_assert(!parcel_r_string_buf(&p, buf, 5));
+	g_assert(!p.malformed);
+
+	p.offset = 0;
+	g_assert_cmpstr(parcel_r_string_buf(&p, buf, 6), ==, "hello");
+
+	/* The euro sign does not fit after the first two characters */
+	g_assert(!parcel_r_string_buf(&p, buf, 6));
+	g_assert(!p.malformed);
+
+	/* Either way the string was consumed */
+	g_assert(p.offset == p.size);
+
+	parcel_free(&p);
+}
+
+static void test_string_size(void)
+{
+	struct parcel p;
+
+	parcel_init(&p);
+
+	parcel_w_string(&p, NULL);
+	g_assert(p.size == parcel_string_size(NULL));
+
+	parcel_w_string(&p, "");
+	g_assert(p.size == parcel_string_size(NULL) + parcel_string_size(""));
+
+	parcel_free(&p);
+
+	/* One, two and four code units plus the terminator, padded */
+	g_assert(parcel_string_size("a") == 4 + 4);
+	g_assert(parcel_string_size("ab") == 4 + 8);
+	g_assert(parcel_string_size(test_astral.str) == 4 + 12);
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_data_func("/testparcel/ASCII string", &test_ascii,
+							test_write_string);
+	g_test_add_data_func("/testparcel/BMP string", &test_bmp,
+							test_write_string);
+	g_test_add_data_func("/testparcel/Surrogate pair", &test_astral,
+							test_write_string);
+	g_test_add_func("/testparcel/Bad surrogates", test_bad_surrogates);
+	g_test_add_func("/testparcel/Invalid UTF-8", test_invalid_utf8);
+	g_test_add_func("/testparcel/Small buffer", test_small_buffer);
+	g_test_add_func("/testparcel/String size", test_string_size);
+
+	ret = g_test_run();
+
+	parcel_pool_flush();
+
+	return ret;
+}
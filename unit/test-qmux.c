@@ -0,0 +1,222 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+
+#include "drivers/qmimodem/qmux.h"
+
+/* CTL Get Version Info response, 19 bytes on the wire */
+static const uint8_t frame_ctl[] = {
+	0x01, 0x12, 0x00, 0x80, 0x00, 0x00, 0x01, 0x01, 0x21, 0x00,
+	0x07, 0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+/* DMS indication for client 0x02, 11 bytes on the wire */
+static const uint8_t frame_dms[] = {
+	0x01, 0x0a, 0x00, 0x80, 0x02, 0x02, 0x04, 0x00, 0x00, 0x01,
+	0x00,
+};
+
+/* A mux header with nothing behind it */
+static const uint8_t frame_empty[] = {
+	0x01, 0x05, 0x00, 0x80, 0x03, 0x01,
+};
+
+static void feed(struct qmux_reader *reader, const uint8_t *data, size_t len)
+{
+	uint8_t *buf = qmux_reader_reserve(reader, len);
+
+	g_assert(buf);
+	memcpy(buf, data, len);
+	qmux_reader_commit(reader, len);
+}
+
+static void expect_frame(struct qmux_reader *reader, const uint8_t *frame,
+								size_t size)
+{
+	const struct qmi_mux_hdr *hdr;
+	size_t len = 0;
+
+	hdr = qmux_reader_next(reader, &len);
+	g_assert(hdr);
+	g_assert(len == size);
+	g_assert(!memcmp(hdr, frame, size));
+}
+
+static void test_split_header(void)
+{
+	struct qmux_reader reader;
+	size_t i;
+
+	qmux_reader_init(&reader);
+
+	/* Deliver one byte at a time, across the header and the payload */
+	for (i = 0; i < sizeof(frame_ctl) - 1; i++) {
+		feed(&reader, frame_ctl + i, 1);
+		g_assert(!qmux_reader_next(&reader, NULL));
+	}
+
+	feed(&reader, frame_ctl + i, 1);
+	expect_frame(&reader, frame_ctl, sizeof(frame_ctl));
+	g_assert(!qmux_reader_next(&reader, NULL));
+	g_assert(reader.len == 0);
+
+	/* Header split in the middle of the length field */
+	feed(&reader, frame_dms, 2);
+	g_assert(!qmux_reader_next(&reader, NULL));
+	feed(&reader, frame_dms + 2, sizeof(frame_dms) - 2);
+	expect_frame(&reader, frame_dms, sizeof(frame_dms));
+	g_assert(!qmux_reader_next(&reader, NULL));
+
+	qmux_reader_clear(&reader);
+}
+
+static void test_multiple_frames(void)
+{
+	struct qmux_reader reader;
+	uint8_t buf[sizeof(frame_ctl) + sizeof(frame_dms) + 4];
+
+	qmux_reader_init(&reader);
+
+	/* Two complete frames followed by the start of a third one */
+	memcpy(buf, frame_ctl, sizeof(frame_ctl));
+	memcpy(buf + sizeof(frame_ctl), frame_dms, sizeof(frame_dms));
+	memcpy(buf + sizeof(frame_ctl) + sizeof(frame_dms), frame_ctl, 4);
+	feed(&reader, buf, sizeof(buf));
+
+	expect_frame(&reader, frame_ctl, sizeof(frame_ctl));
+	expect_frame(&reader, frame_dms, sizeof(frame_dms));
+	g_assert(!qmux_reader_next(&reader, NULL));
+
+	/* The partial frame is kept at the start of the buffer */
+	g_assert(reader.offset == 0);
+	g_assert(reader.len == 4);
+
+	feed(&reader, frame_ctl + 4, sizeof(frame_ctl) - 4);
+	expect_frame(&reader, frame_ctl, sizeof(frame_ctl));
+	g_assert(!qmux_reader_next(&reader, NULL));
+
+	qmux_reader_clear(&reader);
+}
+
+static void test_short_length(void)
+{
+	static const uint8_t bad[] = { 0x01, 0x02, 0x00, 0x80, 0x00, 0x00 };
+	struct qmux_reader reader;
+
+	qmux_reader_init(&reader);
+
+	/* A length not covering the mux header drops the buffered data */
+	feed(&reader, bad, sizeof(bad));
+	feed(&reader, frame_dms, sizeof(frame_dms));
+	g_assert(!qmux_reader_next(&reader, NULL));
+	g_assert(reader.len == 0);
+
+	/* And the reader picks up again with the next read */
+	feed(&reader, frame_dms, sizeof(frame_dms));
+	expect_frame(&reader, frame_dms, sizeof(frame_dms));
+	g_assert(!qmux_reader_next(&reader, NULL));
+
+	qmux_reader_clear(&reader);
+}
+
+static void test_bad_frame(void)
+{
+	static const uint8_t bad[] = { 0x02, 0x05, 0x00, 0x80, 0x00, 0x00 };
+	struct qmux_reader reader;
+
+	qmux_reader_init(&reader);
+
+	feed(&reader, frame_ctl, sizeof(frame_ctl));
+	feed(&reader, bad, sizeof(bad));
+	feed(&reader, frame_dms, sizeof(frame_dms));
+
+	expect_frame(&reader, frame_ctl, sizeof(frame_ctl));
+	g_assert(!qmux_reader_next(&reader, NULL));
+	g_assert(reader.len == 0);
+
+	qmux_reader_clear(&reader);
+}
+
+static void test_zero_payload(void)
+{
+	struct qmux_reader reader;
+
+	qmux_reader_init(&reader);
+
+	feed(&reader, frame_empty, sizeof(frame_empty));
+	feed(&reader, frame_dms, sizeof(frame_dms));
+
+	expect_frame(&reader, frame_empty, QMI_MUX_HDR_SIZE);
+	expect_frame(&reader, frame_dms, sizeof(frame_dms));
+	g_assert(!qmux_reader_next(&reader, NULL));
+
+	qmux_reader_clear(&reader);
+}
+
+static void test_large_frame(void)
+{
+	struct qmux_reader reader;
+	uint8_t *frame;
+	size_t size = 10000;
+	size_t i;
+
+	qmux_reader_init(&reader);
+
+	frame = g_malloc0(size);
+	frame[0] = 0x01;
+	frame[1] = (size - 1) & 0xff;
+	frame[2] = (size - 1) >> 8;
+	frame[3] = 0x80;
+
+	for (i = QMI_MUX_HDR_SIZE; i < size; i++)
+		frame[i] = i;
+
+	/* Frame larger than a single read, delivered in read sized chunks */
+	for (i = 0; i + 4096 < size; i += 4096) {
+		feed(&reader, frame + i, 4096);
+		g_assert(!qmux_reader_next(&reader, NULL));
+	}
+
+	feed(&reader, frame + i, size - i);
+	expect_frame(&reader, frame, size);
+	g_assert(!qmux_reader_next(&reader, NULL));
+
+	g_free(frame);
+	qmux_reader_clear(&reader);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/testqmux/Split header", test_split_header);
+	g_test_add_func("/testqmux/Multiple frames", test_multiple_frames);
+	g_test_add_func("/testqmux/Short length", test_short_length);
+	g_test_add_func("/testqmux/Bad frame", test_bad_frame);
+	g_test_add_func("/testqmux/Zero payload", test_zero_payload);
+	g_test_add_func("/testqmux/Large frame", test_large_frame);
+
+	return g_test_run();
+}
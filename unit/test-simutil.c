@@ -481,10 +481,18 @@ static void test_get_3g_path(void)
 	unsigned char path[6];
 	unsigned int len;
 	unsigned char path1[] = { 0x3F, 0x00, 0x7F, 0xFF };
+	unsigned char path2[] = { 0x3F, 0x00, 0x7F, 0x10, 0x5F, 0x50 };
 
 	len = sim_ef_db_get_path_3g(SIM_EFPNN_FILEID, path);
 	g_assert(len == 4);
 	g_assert(!memcmp(path, path1, len));
+
+	len = sim_ef_db_get_path_3g(SIM_EFIMG_FILEID, path);
+	g_assert(len == 6);
+	g_assert(!memcmp(path, path2, len));
+
+	len = sim_ef_db_get_path_3g(0x6FB1, path);
+	g_assert(len == 0);
 }
 
 static void test_get_2g_path(void)
@@ -22276,6 +22276,51 @@ static void test_img_to_xpm(gconstpointer data)
 	g_free(xpm);
 }
 
+static struct stk_file *refresh_file(const uint8_t *path, unsigned int len)
+{
+	struct stk_file *file = l_new(struct stk_file, 1);
+
+	memcpy(file->file, path, len);
+	file->len = len;
+
+	return file;
+}
+
+static void test_refresh_match_files(void)
+{
+	static const uint32_t paths[] = {
+		0x7f206fad,	/* EFad */
+		0x7f206f38,	/* EFust */
+		0x7f106f3a,	/* EFadn */
+	};
+	static const uint8_t efad[] = { 0x3f, 0x00, 0x7f, 0xff, 0x6f, 0xad };
+	static const uint8_t efadn[] = { 0x3f, 0x00, 0x7f, 0x10, 0x6f, 0x3a };
+	static const uint8_t efsmsp[] = { 0x3f, 0x00, 0x7f, 0x10, 0x6f, 0x42 };
+	static const uint8_t efad_df[] = { 0x3f, 0x00, 0x6f, 0xad };
+	struct l_queue *files = l_queue_new();
+	unsigned int i;
+
+	g_assert(stk_refresh_match_files(files, paths,
+					L_ARRAY_SIZE(paths)) == 0);
+
+	/* Far more entries than there are paths to match */
+	for (i = 0; i < 40; i++)
+		l_queue_push_tail(files, refresh_file(efad, sizeof(efad)));
+
+	g_assert(stk_refresh_match_files(files, paths,
+					L_ARRAY_SIZE(paths)) == 0x1);
+
+	l_queue_push_tail(files, refresh_file(efsmsp, sizeof(efsmsp)));
+	l_queue_push_tail(files, refresh_file(efad_df, sizeof(efad_df)));
+	l_queue_push_tail(files, refresh_file(efadn, sizeof(efadn)));
+	l_queue_push_tail(files, refresh_file(efadn, sizeof(efadn)));
+
+	g_assert(stk_refresh_match_files(files, paths,
+					L_ARRAY_SIZE(paths)) == 0x5);
+
+	l_queue_destroy(files, l_free);
+}
+
 int main(int argc, char **argv)
 {
 	g_test_init(&argc, &argv, NULL);
@@ -24388,5 +24433,8 @@ int main(int argc, char **argv)
 	g_test_add_data_func("/teststk/IMG to XPM Test 6",
 				&xpm_test_6, test_img_to_xpm);
 
+	g_test_add_func("/teststk/Refresh file list matching",
+				test_refresh_match_files);
+
 	return g_test_run();
 }
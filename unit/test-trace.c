@@ -0,0 +1,187 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+#include <ofono/log.h>
+
+#include "trace.h"
+
+static struct ofono_debug_desc desc = {
+	.file = "unit/test-trace.c",
+};
+
+static void encode(struct trace_record *rec, const char *format, ...)
+{
+	va_list ap;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->desc = &desc;
+	rec->func = "encode";
+	rec->format = format;
+
+	va_start(ap, format);
+	trace_encode(rec, format, &ap);
+	va_end(ap);
+}
+
+/* Formats the record and returns the message after the location prefix */
+static const char *format(const struct trace_record *rec, char *buf,
+								size_t size)
+{
+	const char *msg;
+
+	trace_format(rec, false, buf, size);
+	g_assert(g_utf8_validate(buf, -1, NULL));
+
+	msg = strstr(buf, "encode() ");
+	g_assert(msg);
+
+	return msg + strlen("encode() ");
+}
+
+static void test_conversions(void)
+{
+	struct trace_record rec;
+	char buf[512], expected[128];
+	const char *msg;
+	void *ptr = &rec;
+	size_t size = 123456;
+	unsigned char byte = 0xab;
+
+	encode(&rec, "%s %.*s|%5.2s|%-4s|", "hello", 3, "abcdef", "xyz", "ab");
+	msg = format(&rec, buf, sizeof(buf));
+	g_assert_cmpstr(msg, ==, "hello abc|   xy|ab  |");
+	g_assert(!rec.truncated);
+
+	encode(&rec, "%hhx %zu %p %c%c", byte, size, ptr, 'o', 'k');
+	msg = format(&rec, buf, sizeof(buf));
+	snprintf(expected, sizeof(expected), "%hhx %zu %p %c%c",
+						byte, size, ptr, 'o', 'k');
+	g_assert_cmpstr(msg, ==, expected);
+
+	encode(&rec, "%d %hd %ld %lld %u %08x %*d%%",
+			-1, (short) -2, -3L, -4LL, 5U, 0xbeef, 4, 7);
+	msg = format(&rec, buf, sizeof(buf));
+	g_assert_cmpstr(msg, ==, "-1 -2 -3 -4 5 0000beef    7%");
+
+	encode(&rec, "%s", NULL);
+	msg = format(&rec, buf, sizeof(buf));
+	g_assert_cmpstr(msg, ==, "(null)");
+}
+
+static void test_raw_time(void)
+{
+	struct trace_record rec;
+	char buf[512];
+
+	encode(&rec, "raw");
+	rec.timestamp = 1234567890123456ULL;
+
+	trace_format(&rec, true, buf, sizeof(buf));
+	g_assert_cmpstr(buf, ==,
+			"1234567890.123456 unit/test-trace.c:encode() raw");
+}
+
+static void test_truncated(void)
+{
+	struct trace_record rec;
+	char buf[512];
+	char str[TRACE_DATA_SIZE * 2];
+	const char *msg;
+	size_t len;
+
+	memset(str, 'a', sizeof(str) - 1);
+	str[sizeof(str) - 1] = '\0';
+
+	/* The string only partially fits, the second one not at all */
+	encode(&rec, "%s %s", str, "lost");
+	g_assert(rec.truncated);
+
+	msg = format(&rec, buf, sizeof(buf));
+	len = strlen(msg);
+	g_assert(len == TRACE_DATA_SIZE - 1 + strlen(" ..."));
+	g_assert(!strcmp(msg + len - 4, " ..."));
+
+	/* Numbers that do not fit are dropped as a whole */
+	encode(&rec, "%s %d %d", str + sizeof(str) - 71, 1, 2);
+	g_assert(rec.truncated);
+
+	msg = format(&rec, buf, sizeof(buf));
+	g_assert(!strcmp(msg + strlen(msg) - 6, " 1 ..."));
+}
+
+static void test_utf8(void)
+{
+	struct trace_record rec;
+	char buf[512];
+	GString *str;
+	const char *msg;
+	size_t i;
+
+	/* Two byte characters, cut when the record runs out of space */
+	str = g_string_new(NULL);
+	for (i = 0; i < TRACE_DATA_SIZE; i++)
+		g_string_append(str, "\xc3\xa4");
+
+	encode(&rec, "%s", str->str);
+	g_assert(rec.truncated);
+
+	msg = format(&rec, buf, sizeof(buf));
+	g_assert(strchr(msg, '?') == NULL);
+	g_assert(!strncmp(msg, str->str, strlen(msg) - 3));
+
+	/* Three byte characters, cut after the precision took its space */
+	for (i = 0; i < TRACE_STRING_MAX; i++)
+		g_string_append(str, "\xe2\x82\xac");
+
+	encode(&rec, "%.*s", TRACE_DATA_SIZE, str->str + TRACE_DATA_SIZE * 2);
+	msg = format(&rec, buf, sizeof(buf));
+	g_assert(strchr(msg, '?') == NULL);
+
+	/* Invalid bytes in an argument are replaced */
+	encode(&rec, "<%s>", "a\xff\xfe" "b\xc3");
+	msg = format(&rec, buf, sizeof(buf));
+	g_assert_cmpstr(msg, ==, "<a??b?>");
+
+	/* A line that is cut in the middle of a character */
+	encode(&rec, "%s", str->str);
+	trace_format(&rec, false, buf, msg - buf + 4);
+	g_assert(g_utf8_validate(buf, -1, NULL));
+
+	g_string_free(str, TRUE);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/testtrace/Conversions", test_conversions);
+	g_test_add_func("/testtrace/Raw time", test_raw_time);
+	g_test_add_func("/testtrace/Truncated records", test_truncated);
+	g_test_add_func("/testtrace/UTF-8", test_utf8);
+
+	return g_test_run();
+}